@@ -0,0 +1,332 @@
+////////////////////////////////////////////////////////////////////////////////
+/// ustar (POSIX tar) archives, so large sets of programs are one file that
+/// standard tools can list and unpack
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "archive.h"
+
+/************************** Private Types *************************************/
+
+/* The ustar header, one block long */
+struct tar_header_s {
+    char name[ 100 ];
+    char mode[ 8 ];
+    char uid[ 8 ];
+    char gid[ 8 ];
+    char size[ 12 ];
+    char mtime[ 12 ];
+    char checksum[ 8 ];
+    char type;
+    char link_name[ 100 ];
+    char magic[ 6 ];
+    char version[ 2 ];
+    char user_name[ 32 ];
+    char group_name[ 32 ];
+    char dev_major[ 8 ];
+    char dev_minor[ 8 ];
+    char prefix[ 155 ];
+    char padding[ 12 ];
+} typedef tar_header_t;
+
+/*******************************************************************************
+ *              Archive Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Creates (or truncates) an archive file to write members into
+/// @param out_archive_pp a pointer to a pointer of the archive
+/// @param archive_file_name_p the archive file
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_archive_writer(archive_t ** out_archive_pp,
+    const char * archive_file_name_p)
+{
+    *out_archive_pp = (archive_t *) calloc( 1, sizeof( archive_t ) );
+    if (*out_archive_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for "
+            "*out_archive_pp] #\n" );
+        return ERROR;
+    }
+    (*out_archive_pp)->file_p = fopen( archive_file_name_p, "wb" );
+    if ((*out_archive_pp)->file_p == NULL)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            archive_file_name_p );
+        free( *out_archive_pp );
+        *out_archive_pp = NULL;
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Ends the archive with the two zero blocks tar expects and frees it
+/// @param archive_pp a pointer to a pointer of the archive
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_archive(archive_t ** archive_pp)
+{
+    char zero[ 2 * TAR_BLOCK_SIZE ] = { 0 };
+    int result = SUCCESS;
+
+    if (*archive_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *archive_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    if (fwrite( zero, 1, sizeof( zero ), (*archive_pp)->file_p )
+        != sizeof( zero ) || ferror( (*archive_pp)->file_p ))
+    {
+        result = ERROR;
+    }
+    if (fclose( (*archive_pp)->file_p ) != 0 || result != SUCCESS)
+    {
+        printf( "\t# [ERROR: Can not write the archive!] #\n" );
+        result = ERROR;
+    }
+    free( *archive_pp );
+    *archive_pp = NULL;
+    return result;
+}
+
+/// @brief Value of a NUL or space terminated octal header field
+/// @param field_p the field
+/// @param len the field's length
+/// @return the value
+static uint64_t parse_octal_field(const char * field_p, size_t len)
+{
+    uint64_t value = 0;
+    size_t i = 0;
+
+    while (i < len && field_p[ i ] == ' ')
+    {
+        i++;
+    }
+    for (; i < len && field_p[ i ] >= '0' && field_p[ i ] <= '7'; i++)
+    {
+        value = value * 8 + (uint64_t) (field_p[ i ] - '0');
+    }
+    return value;
+}
+
+/// @brief Walks the headers of a mapped archive and indexes the regular
+/// files; other members (directories, links, pax headers) are skipped
+/// @param reader_p the reader, mapped
+/// @return 1 if SUCCESS, otherwise ERROR
+static int index_archive(archive_reader_t * reader_p)
+{
+    const tar_header_t * header_p;
+    const byte_t * byte_p;
+    archive_member_t * member_p;
+    uint64_t capacity = 0;
+    unsigned int checksum;
+    size_t size;
+    size_t offset = 0;
+
+    while (offset + TAR_BLOCK_SIZE <= reader_p->map_len)
+    {
+        header_p = (const tar_header_t *) (reader_p->map_p + offset);
+        byte_p = (const byte_t *) header_p;
+        /* The archive ends at its first zero block */
+        if (header_p->name[ 0 ] == '\0')
+        {
+            return SUCCESS;
+        }
+        checksum = 8 * ' ';
+        for (size_t i = 0; i < sizeof( *header_p ); i++)
+        {
+            if (i < offsetof( tar_header_t, checksum ) 
+                || i >= offsetof( tar_header_t, checksum ) 
+                    + sizeof( header_p->checksum ))
+            {
+                checksum += byte_p[ i ];
+            }
+        }
+        size = (size_t) parse_octal_field( header_p->size,
+            sizeof( header_p->size ) );
+        if (checksum != parse_octal_field( header_p->checksum,
+            sizeof( header_p->checksum ) )
+            || size > reader_p->map_len - offset - TAR_BLOCK_SIZE)
+        {
+            return ERROR;
+        }
+
+        if (header_p->type == '0' || header_p->type == '\0')
+        {
+            if (reader_p->num_members == capacity)
+            {
+                capacity = capacity ? 2 * capacity : 64;
+                member_p = (archive_member_t *) realloc( reader_p->members_p,
+                    capacity * sizeof( archive_member_t ) );
+                if (member_p == NULL)
+                {
+                    printf( "\t# [ERROR: realloc failed to grow the archive "
+                        "index] #\n" );
+                    return ERROR;
+                }
+                reader_p->members_p = member_p;
+            }
+            member_p = &reader_p->members_p[ reader_p->num_members++ ];
+            memcpy( member_p->name, header_p->name, sizeof( header_p->name ) );
+            member_p->name[ MAX_MEMBER_NAME_LEN ] = '\0';
+            member_p->data_p = reader_p->map_p + offset + TAR_BLOCK_SIZE;
+            member_p->size = size;
+        }
+        offset += TAR_BLOCK_SIZE 
+            + (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+    }
+    /* A missing end of archive is tolerated, as tar does */
+    return SUCCESS;
+}
+
+/// @brief Maps an archive and indexes its regular file members; the
+/// mapping is populated up front, as indexing reads every header anyway
+/// @param out_reader_pp a pointer to a pointer of the reader
+/// @param archive_file_name_p the archive file
+/// @return 1 if SUCCESS, otherwise ERROR (if it is not a valid archive)
+int open_archive_reader(archive_reader_t ** out_reader_pp,
+    const char * archive_file_name_p)
+{
+    archive_reader_t * reader_p = NULL;
+    struct stat info;
+    int fd = open( archive_file_name_p, O_RDONLY );
+
+    if (fd < 0 || fstat( fd, &info ) != 0 || info.st_size == 0)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            archive_file_name_p );
+        if (fd >= 0)
+        {
+            close( fd );
+        }
+        return ERROR;
+    }
+    reader_p = (archive_reader_t *) calloc( 1, sizeof( archive_reader_t ) );
+    if (reader_p == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for "
+            "*out_reader_pp] #\n" );
+        close( fd );
+        return ERROR;
+    }
+    reader_p->map_len = (size_t) info.st_size;
+    reader_p->map_p = (byte_t *) mmap( NULL, reader_p->map_len, PROT_READ,
+        MAP_PRIVATE | MAP_POPULATE, fd, 0 );
+    close( fd );
+    if (reader_p->map_p == MAP_FAILED)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be mapped!] #\n",
+            archive_file_name_p );
+        free( reader_p );
+        return ERROR;
+    }
+    *out_reader_pp = reader_p;
+    if (index_archive( reader_p ) != SUCCESS)
+    {
+        printf( "\t# [ERROR: '%s' is not a valid tar archive] #\n",
+            archive_file_name_p );
+        delete_archive_reader( out_reader_pp );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Unmaps an archive being read and frees its index
+/// @param reader_pp a pointer to a pointer of the reader
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_archive_reader(archive_reader_t ** reader_pp)
+{
+    if (*reader_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *reader_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    munmap( (*reader_pp)->map_p, (*reader_pp)->map_len );
+    free( (*reader_pp)->members_p );
+    free( *reader_pp );
+    *reader_pp = NULL;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Archive Functions
+ ******************************************************************************/
+
+/// @brief Finds a regular file member by name
+/// @param reader_p the reader
+/// @param name_p the member's name
+/// @return the member, or NULL
+const archive_member_t * find_archive_member(const archive_reader_t * reader_p,
+    const char * name_p)
+{
+    for (uint64_t i = 0; i < reader_p->num_members; i++)
+    {
+        if (strcmp( reader_p->members_p[ i ].name, name_p ) == 0)
+        {
+            return &reader_p->members_p[ i ];
+        }
+    }
+    return NULL;
+}
+
+/// @brief Appends a regular file member
+/// @param archive_p the archive
+/// @param name_p the member's name (under MAX_MEMBER_NAME_LEN characters)
+/// @param data_p the member's contents
+/// @param size the size of the contents
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_archive_member(archive_t * archive_p, const char * name_p,
+    const void * data_p, size_t size)
+{
+    tar_header_t header;
+    char zero[ TAR_BLOCK_SIZE ] = { 0 };
+    const unsigned char * byte_p = (const unsigned char *) &header;
+    unsigned int checksum = 0;
+    size_t padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+    if (strlen( name_p ) >= MAX_MEMBER_NAME_LEN)
+    {
+        printf( "\t# [ERROR: member name '%s' is too long] #\n", name_p );
+        return ERROR;
+    }
+
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.name, name_p, strlen( name_p ) );
+    snprintf( header.mode, sizeof( header.mode ), "%07o", 0644 );
+    snprintf( header.uid, sizeof( header.uid ), "%07o", 0 );
+    snprintf( header.gid, sizeof( header.gid ), "%07o", 0 );
+    snprintf( header.size, sizeof( header.size ), "%011llo",
+        (unsigned long long) size );
+    snprintf( header.mtime, sizeof( header.mtime ), "%011o", 0 );
+    header.type = '0';
+    memcpy( header.magic, "ustar", 6 );
+    memcpy( header.version, "00", 2 );
+
+    /* The checksum is summed with its own field taken as spaces */
+    memset( header.checksum, ' ', sizeof( header.checksum ) );
+    for (size_t i = 0; i < sizeof( header ); i++)
+    {
+        checksum += byte_p[ i ];
+    }
+    snprintf( header.checksum, sizeof( header.checksum ), "%06o", checksum );
+    header.checksum[ 7 ] = ' ';
+
+    if (fwrite( &header, 1, sizeof( header ), archive_p->file_p )
+        != sizeof( header )
+        || fwrite( data_p, 1, size, archive_p->file_p ) != size
+        || fwrite( zero, 1, padding, archive_p->file_p ) != padding)
+    {
+        printf( "\t# [ERROR: Can not write member '%s'!] #\n", name_p );
+        return ERROR;
+    }
+    archive_p->num_members++;
+    return SUCCESS;
+}
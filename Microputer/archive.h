@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for ustar (tar) archives of machine code programs
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* tar stores everything in 512 byte blocks */
+#define TAR_BLOCK_SIZE 512
+/* Longest member name a ustar header holds without a prefix */
+#define MAX_MEMBER_NAME_LEN 100
+
+/*********************** Archive Structs & Types ******************************/
+
+/* An archive being written */
+struct archive_s {
+    FILE * file_p;
+    uint64_t num_members;
+} typedef archive_t;
+
+/* A regular file member of an archive being read; data_p points into the
+   mapped archive */
+struct archive_member_s {
+    char name[ MAX_MEMBER_NAME_LEN + 1 ];
+    const byte_t * data_p;
+    size_t size;
+} typedef archive_member_t;
+
+/* An archive being read: mapped whole, with its regular file members
+   indexed in order */
+struct archive_reader_s {
+    byte_t * map_p;
+    size_t map_len;
+    archive_member_t * members_p;
+    uint64_t num_members;
+} typedef archive_reader_t;
+
+/*********************** Public Archive Functions *****************************/
+
+int create_archive_writer(archive_t ** out_archive_pp,
+    const char * archive_file_name_p);
+int write_archive_member(archive_t * archive_p, const char * name_p,
+    const void * data_p, size_t size);
+int delete_archive(archive_t ** archive_pp);
+int open_archive_reader(archive_reader_t ** out_reader_pp,
+    const char * archive_file_name_p);
+int delete_archive_reader(archive_reader_t ** reader_pp);
+const archive_member_t * find_archive_member(const archive_reader_t * reader_p,
+    const char * name_p);
+
+#endif
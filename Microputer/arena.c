@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Memory arenas for instance pools and program images. With huge pages
+/// asked for, an arena is one MAP_HUGETLB mapping, or failing that a 2 MiB
+/// aligned mapping madvise()d for transparent huge pages, so thousands of
+/// small objects sit under a handful of TLB entries
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+/*******************************************************************************
+ *              Arena Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Maps size bytes (rounded up to whole huge pages) starting on a
+/// huge page boundary, for transparent huge pages to back
+/// @param size the size, a multiple of HUGE_PAGE_SIZE
+/// @return the mapping, or NULL
+static byte_t * map_huge_aligned(size_t size)
+{
+    byte_t * map_p = (byte_t *) mmap( NULL, size + HUGE_PAGE_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    byte_t * base_p;
+    size_t head;
+
+    if (map_p == MAP_FAILED)
+    {
+        return NULL;
+    }
+    /* Trim the slack on both sides of the aligned part */
+    base_p = (byte_t *) (((uintptr_t) map_p + HUGE_PAGE_SIZE - 1)
+        & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+    head = (size_t) (base_p - map_p);
+    if (head > 0)
+    {
+        munmap( map_p, head );
+    }
+    munmap( base_p + size, HUGE_PAGE_SIZE - head );
+    return base_p;
+}
+
+/// @brief Creates an arena; its memory is touched up front, so huge pages
+/// are in place (and page faults are over) before anything runs
+/// @param out_arena_pp a pointer to a pointer of the arena
+/// @param size bytes it holds
+/// @param huge_pages 1 = back it with huge pages if the host allows
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_arena(arena_t ** out_arena_pp, size_t size, byte_t huge_pages)
+{
+    size_t page_size = huge_pages ? HUGE_PAGE_SIZE
+        : (size_t) sysconf( _SC_PAGESIZE );
+    arena_t * arena_p = (arena_t *) calloc( 1, sizeof( arena_t ) );
+
+    if (arena_p == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for "
+            "*out_arena_pp] #\n" );
+        return ERROR;
+    }
+    arena_p->size = (size + page_size - 1) / page_size * page_size;
+    if (arena_p->size == 0)
+    {
+        arena_p->size = page_size;
+    }
+
+    if (huge_pages)
+    {
+        arena_p->base_p = (byte_t *) mmap( NULL, arena_p->size,
+            PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0 );
+        arena_p->backing = ARENA_HUGETLB;
+        if (arena_p->base_p == MAP_FAILED)
+        {
+            arena_p->base_p = map_huge_aligned( arena_p->size );
+            arena_p->backing = arena_p->base_p != NULL && madvise( 
+                arena_p->base_p, arena_p->size, MADV_HUGEPAGE ) == 0
+                ? ARENA_THP : ARENA_NORMAL;
+        }
+    } else
+    {
+        arena_p->base_p = (byte_t *) mmap( NULL, arena_p->size,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        arena_p->backing = ARENA_NORMAL;
+        /* Kept off huge pages even where THP is always on, to compare */
+        if (arena_p->base_p != MAP_FAILED)
+        {
+            madvise( arena_p->base_p, arena_p->size, MADV_NOHUGEPAGE );
+        }
+    }
+    if (arena_p->base_p == MAP_FAILED || arena_p->base_p == NULL)
+    {
+        printf( "\t# [ERROR: could not map a %zu byte arena] #\n", 
+            arena_p->size );
+        free( arena_p );
+        return ERROR;
+    }
+    memset( arena_p->base_p, 0, arena_p->size );
+    *out_arena_pp = arena_p;
+    return SUCCESS;
+}
+
+/// @brief Unmaps an arena and everything allocated from it
+/// @param arena_pp a pointer to a pointer of the arena
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_arena(arena_t ** arena_pp)
+{
+    if (*arena_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *arena_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    munmap( (*arena_pp)->base_p, (*arena_pp)->size );
+    free( *arena_pp );
+    *arena_pp = NULL;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Arena Functions
+ ******************************************************************************/
+
+/// @brief Allocates from an arena, ARENA_ALIGN aligned and zeroed
+/// @param arena_p the arena
+/// @param size bytes wanted
+/// @return the memory, or NULL if the arena is full
+void * arena_alloc(arena_t * arena_p, size_t size)
+{
+    size_t start = (arena_p->used + ARENA_ALIGN - 1) & ~(size_t) 
+        (ARENA_ALIGN - 1);
+
+    if (start + size > arena_p->size)
+    {
+        printf( "\t# [ERROR: arena of %zu bytes is full] #\n", 
+            arena_p->size );
+        return NULL;
+    }
+    arena_p->used = start + size;
+    return arena_p->base_p + start;
+}
+
+/// @brief Frees everything allocated from an arena, keeping its pages
+/// @param arena_p the arena
+void reset_arena(arena_t * arena_p)
+{
+    memset( arena_p->base_p, 0, arena_p->used );
+    arena_p->used = 0;
+}
+
+/// @brief Names what an arena is backed by
+/// @param arena_p the arena
+/// @return the name
+const char * arena_backing_name(const arena_t * arena_p)
+{
+    switch (arena_p->backing)
+    {
+        case ARENA_HUGETLB: return "hugetlb";
+        case ARENA_THP: return "transparent huge";
+        default: return "4 KiB";
+    }
+}
+
+/// @brief Bytes of an arena the kernel actually backs with huge pages,
+/// from its entry in /proc/self/smaps
+/// @param arena_p the arena
+/// @return the bytes, 0 if none (or smaps can not be read)
+uint64_t arena_huge_bytes(const arena_t * arena_p)
+{
+    FILE * file_p = fopen( "/proc/self/smaps", "r" );
+    char line[ 256 ];
+    unsigned long start;
+    unsigned long end;
+    unsigned long kb;
+    int in_arena = 0;
+    uint64_t bytes = 0;
+
+    if (file_p == NULL)
+    {
+        return 0;
+    }
+    while (fgets( line, sizeof( line ), file_p ) != NULL)
+    {
+        /* Mapping headers are the lines that start with a range */
+        if (sscanf( line, "%lx-%lx ", &start, &end ) == 2)
+        {
+            in_arena = start <= (uintptr_t) arena_p->base_p 
+                && (uintptr_t) arena_p->base_p < end;
+        } else if (in_arena 
+            && (sscanf( line, "AnonHugePages: %lu kB", &kb ) == 1
+                || sscanf( line, "Private_Hugetlb: %lu kB", &kb ) == 1))
+        {
+            bytes += (uint64_t) kb * 1024;
+        }
+    }
+    fclose( file_p );
+    return bytes;
+}
+
+/// @brief Prints how much of an arena is used and what backs it
+/// @param arena_p the arena
+/// @param name_p what the arena holds
+void print_arena_report(const arena_t * arena_p, const char * name_p)
+{
+    printf( "Arena (%s): %zu bytes of %zu KiB used, %s pages, %llu KiB on "
+        "huge pages\n", name_p, arena_p->used, arena_p->size / 1024,
+        arena_backing_name( arena_p ),
+        (unsigned long long) (arena_huge_bytes( arena_p ) / 1024) );
+}
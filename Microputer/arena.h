@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for memory arenas backed by 2 MiB huge pages
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARENA_H
+#define ARENA_H
+
+/***************************** Imports ****************************************/
+
+#include <stddef.h>
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+/* Allocations are cache line aligned, so threads' objects never share one */
+#define ARENA_ALIGN 64
+
+/* What an arena's memory is backed by */
+#define ARENA_NORMAL 0      // 4 KiB pages (transparent huge pages refused)
+#define ARENA_THP 1         // transparent huge pages, asked for by madvise
+#define ARENA_HUGETLB 2     // reserved huge pages (MAP_HUGETLB)
+
+/************************* Arena Structs & Types ******************************/
+
+/* A bump allocator over one mapping; everything in it is freed at once */
+struct arena_s {
+    byte_t * base_p;
+    size_t size;
+    size_t used;
+    byte_t backing;
+} typedef arena_t;
+
+/************************ Public Arena Functions ******************************/
+
+int create_arena(arena_t ** out_arena_pp, size_t size, byte_t huge_pages);
+int delete_arena(arena_t ** arena_pp);
+void * arena_alloc(arena_t * arena_p, size_t size);
+void reset_arena(arena_t * arena_p);
+const char * arena_backing_name(const arena_t * arena_p);
+uint64_t arena_huge_bytes(const arena_t * arena_p);
+void print_arena_report(const arena_t * arena_p, const char * name_p);
+
+#endif
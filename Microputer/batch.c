@@ -0,0 +1,324 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Batch runs of archives of programs (such as -G writes). Jobs run back to
+/// back on a ring of instance slots, and while one job runs the image,
+/// input and slot of the job prefetch_depth ahead are pulled into the
+/// cache, so tiny programs do not each start on cold cache lines
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "arena.h"
+#include "metrics.h"
+
+/***************************** Macros *****************************************/
+
+#define CACHE_LINE_SIZE 64
+/* Input lines prefetched per job; longer inputs stream in as they are read */
+#define MAX_INPUT_PREFETCH_LINES 4
+
+/*******************************************************************************
+ *                          Job Functions
+ ******************************************************************************/
+
+/// @brief Whether a member's name ends in a suffix
+/// @param member_p the member
+/// @param suffix_p the suffix
+/// @return 1 if it does, otherwise 0
+static int has_suffix(const archive_member_t * member_p, const char * suffix_p)
+{
+    size_t len = strlen( member_p->name );
+    size_t suffix_len = strlen( suffix_p );
+
+    return len > suffix_len
+        && strcmp( member_p->name + len - suffix_len, suffix_p ) == 0;
+}
+
+/// @brief Whether a member is the input of a program ("x.in" for "x.dat")
+/// @param input_p the member that may be the input
+/// @param program_p the program
+/// @return 1 if it is, otherwise 0
+static int is_input_of(const archive_member_t * input_p,
+    const archive_member_t * program_p)
+{
+    size_t base_len = strlen( program_p->name ) - strlen( ".dat" );
+
+    return has_suffix( input_p, ".in" )
+        && strlen( input_p->name ) == base_len + strlen( ".in" )
+        && strncmp( input_p->name, program_p->name, base_len ) == 0;
+}
+
+/// @brief Fills in the jobs' expected instruction counts from the archive's
+/// manifest.txt ("name instructions" per line), if it has one. The manifest
+/// lists programs in archive order, so each line is looked for at the job
+/// after the last one found first
+/// @param reader_p the archive
+/// @param jobs_p the jobs
+/// @param num_jobs how many there are
+static void read_manifest(const archive_reader_t * reader_p,
+    batch_job_t * jobs_p, uint64_t num_jobs)
+{
+    const archive_member_t * manifest_p = find_archive_member( reader_p,
+        "manifest.txt" );
+    char line[ MAX_MEMBER_NAME_LEN + 32 ];
+    char name[ MAX_MEMBER_NAME_LEN + 1 ];
+    unsigned long long count;
+    size_t offset = 0;
+    size_t len;
+    uint64_t next = 0;
+    uint64_t j;
+
+    while (manifest_p != NULL && offset < manifest_p->size)
+    {
+        len = 0;
+        while (offset < manifest_p->size && manifest_p->data_p[ offset ] 
+            != '\n')
+        {
+            if (len < sizeof( line ) - 1)
+            {
+                line[ len++ ] = (char) manifest_p->data_p[ offset ];
+            }
+            offset++;
+        }
+        offset++;
+        line[ len ] = '\0';
+        if (sscanf( line, "%100s %llu", name, &count ) != 2)
+        {
+            continue;
+        }
+        for (j = 0; j < num_jobs; j++)
+        {
+            if (strcmp( jobs_p[ (next + j) % num_jobs ].name_p, name ) == 0)
+            {
+                break;
+            }
+        }
+        if (j < num_jobs)
+        {
+            jobs_p[ (next + j) % num_jobs ].expected = count;
+            next = (next + j + 1) % num_jobs;
+        }
+    }
+}
+
+/// @brief Makes a job of every .dat member of an archive, in archive
+/// order, each with the .in member next to it (if any) as its input
+/// @param reader_p the archive
+/// @param out_num_jobs_p how many jobs there are
+/// @return the jobs, the caller's to free, or NULL
+static batch_job_t * make_jobs(const archive_reader_t * reader_p,
+    uint64_t * out_num_jobs_p)
+{
+    batch_job_t * jobs_p = (batch_job_t *) calloc( reader_p->num_members
+        ? reader_p->num_members : 1, sizeof( batch_job_t ) );
+    const archive_member_t * members_p = reader_p->members_p;
+    const archive_member_t * input_p;
+    uint64_t num_jobs = 0;
+
+    if (jobs_p == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate the batch jobs] #\n" );
+        return NULL;
+    }
+    for (uint64_t i = 0; i < reader_p->num_members; i++)
+    {
+        if (!has_suffix( &members_p[ i ], ".dat" ))
+        {
+            continue;
+        }
+        input_p = NULL;
+        if (i + 1 < reader_p->num_members 
+            && is_input_of( &members_p[ i + 1 ], &members_p[ i ] ))
+        {
+            input_p = &members_p[ i + 1 ];
+        } else if (i > 0 && is_input_of( &members_p[ i - 1 ], &members_p[ i ] ))
+        {
+            input_p = &members_p[ i - 1 ];
+        }
+        jobs_p[ num_jobs ].image_p = members_p[ i ].data_p;
+        jobs_p[ num_jobs ].image_size = members_p[ i ].size;
+        jobs_p[ num_jobs ].input_p = input_p != NULL ? input_p->data_p : NULL;
+        jobs_p[ num_jobs ].input_size = input_p != NULL ? input_p->size : 0;
+        jobs_p[ num_jobs ].name_p = members_p[ i ].name;
+        jobs_p[ num_jobs ].expected = NO_EXPECTED_COUNT;
+        num_jobs++;
+    }
+    read_manifest( reader_p, jobs_p, num_jobs );
+    *out_num_jobs_p = num_jobs;
+    return jobs_p;
+}
+
+/// @brief Pulls what a job will touch into the cache: its image, the start
+/// of its input and (for writing) its slot
+/// @param job_p the job
+/// @param slot_p the instance it will run on
+static inline void prefetch_job(const batch_job_t * job_p,
+    const microputer_t * slot_p)
+{
+    size_t input_lines = (job_p->input_size + CACHE_LINE_SIZE - 1) 
+        / CACHE_LINE_SIZE;
+
+    __builtin_prefetch( job_p->image_p, 0, 3 );
+    for (size_t i = 0; i < input_lines && i < MAX_INPUT_PREFETCH_LINES; i++)
+    {
+        __builtin_prefetch( job_p->input_p + i * CACHE_LINE_SIZE, 0, 3 );
+    }
+    for (size_t i = 0; i < sizeof( microputer_t ); i += CACHE_LINE_SIZE)
+    {
+        __builtin_prefetch( (const byte_t *) slot_p + i, 1, 3 );
+    }
+}
+
+/*******************************************************************************
+ *                          Batch Functions
+ ******************************************************************************/
+
+/// @brief Runs one job on its slot
+/// @param job_p the job
+/// @param mp_p the slot
+/// @param params_p how the batch is run
+/// @param cursors_p where the bus's devices were before the batch, which
+/// is where they are put back for the job
+/// @return 1 if SUCCESS, otherwise ERROR
+static int run_batch_job(const batch_job_t * job_p, microputer_t * mp_p,
+    const batch_params_t * params_p, const device_cursors_t * cursors_p)
+{
+    size_t size = job_p->image_size < MEM_BYTE_SIZE 
+        ? job_p->image_size : MEM_BYTE_SIZE;
+    byte_t engine = params_p->engine;
+
+    /* As load_micro_program loads it; anything past memory is ignored */
+    reset_microputer( mp_p );
+    memcpy( mp_p->mem, job_p->image_p, size );
+    mp_p->loaded_mem_slots = (byte_t) size;
+    restore_device_cursors( params_p->bus_p, cursors_p );
+    if (set_stream_console_values( params_p->bus_p->port_map[ CONSOLE_PORT ],
+        job_p->input_p, job_p->input_size ) != SUCCESS)
+    {
+        return ERROR;
+    }
+
+    if (engine == ENGINE_AUTO)
+    {
+        engine = select_engine( params_p->selector_p, mp_p );
+    }
+    if (run_engine( mp_p, engine, RUN_UNBOUNDED ) != SUCCESS)
+    {
+        printf( "\t# [ERROR: job '%s' failed] #\n", job_p->name_p );
+        return ERROR;
+    }
+    if (job_p->expected != NO_EXPECTED_COUNT 
+        && mp_p->cycles != job_p->expected)
+    {
+        printf( "\t# [ERROR: job '%s' ran %llu instructions, the manifest "
+            "says %llu] #\n", job_p->name_p, 
+            (unsigned long long) mp_p->cycles,
+            (unsigned long long) job_p->expected );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Runs every .dat member of an archive as a job, in archive order,
+/// on params_p->prefetch_depth + 1 instance slots taken in turn. Jobs are
+/// checked against the archive's manifest, if it has one
+/// @param archive_file_name_p the archive
+/// @param params_p how the batch is run
+/// @return 1 if SUCCESS, otherwise ERROR (some job failed)
+int run_archive_batch(const char * archive_file_name_p,
+    const batch_params_t * params_p)
+{
+    archive_reader_t * reader_p = NULL;
+    arena_t * arena_p = NULL;
+    batch_job_t * jobs_p = NULL;
+    microputer_t * slots_p[ BATCH_MAX_PREFETCH_DEPTH + 1 ];
+    device_cursors_t cursors;
+    int depth = params_p->prefetch_depth;
+    int num_slots;
+    uint64_t num_jobs = 0;
+    uint64_t num_failed = 0;
+    uint64_t instructions = 0;
+    uint64_t start_ns;
+    double seconds;
+    int result = SUCCESS;
+
+    if (depth < 0 || depth > BATCH_MAX_PREFETCH_DEPTH)
+    {
+        depth = depth < 0 ? 0 : BATCH_MAX_PREFETCH_DEPTH;
+    }
+    num_slots = depth + 1;
+    if (open_archive_reader( &reader_p, archive_file_name_p ) != SUCCESS
+        || (jobs_p = make_jobs( reader_p, &num_jobs )) == NULL
+        || create_arena( &arena_p, (size_t) num_slots 
+            * (sizeof( microputer_t ) + ARENA_ALIGN), params_p->huge_pages )
+            != SUCCESS)
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    for (int i = 0; i < num_slots; i++)
+    {
+        slots_p[ i ] = (microputer_t *) arena_alloc( arena_p, 
+            sizeof( microputer_t ) );
+        if (slots_p[ i ] == NULL || init_microputer( slots_p[ i ] ) 
+            != SUCCESS)
+        {
+            result = ERROR;
+            goto FUNC_EXIT;
+        }
+        create_instruction_set( slots_p[ i ] );
+        slots_p[ i ]->bus_p = params_p->bus_p;
+    }
+
+    save_device_cursors( params_p->bus_p, &cursors );
+    start_ns = metrics_now_ns();
+    /* The first jobs have nothing running to hide their fetches behind */
+    for (uint64_t i = 0; i < (uint64_t) depth && i < num_jobs; i++)
+    {
+        prefetch_job( &jobs_p[ i ], slots_p[ i % num_slots ] );
+    }
+    for (uint64_t i = 0; i < num_jobs; i++)
+    {
+        if (depth > 0 && i + depth < num_jobs)
+        {
+            prefetch_job( &jobs_p[ i + depth ], 
+                slots_p[ (i + depth) % num_slots ] );
+        }
+        if (run_batch_job( &jobs_p[ i ], slots_p[ i % num_slots ], params_p,
+            &cursors ) != SUCCESS)
+        {
+            num_failed++;
+        }
+        instructions += slots_p[ i % num_slots ]->cycles;
+    }
+    seconds = (metrics_now_ns() - start_ns) / 1e9;
+    /* What the programs printed comes before the report about them */
+    if (params_p->sink_p != NULL && params_p->sink_p->file_p == stdout
+        && flush_output_sink( params_p->sink_p ) != SUCCESS)
+    {
+        num_failed++;
+    }
+
+    printf( "\nBatch: %llu jobs, %llu failed, %llu instructions in %.3f s "
+        "(%.0f jobs/s, prefetch depth %d)\n", (unsigned long long) num_jobs,
+        (unsigned long long) num_failed, (unsigned long long) instructions,
+        seconds, seconds > 0 ? num_jobs / seconds : 0.0, depth );
+    result = num_failed == 0 ? SUCCESS : ERROR;
+
+    FUNC_EXIT:
+    if (arena_p != NULL)
+    {
+        delete_arena( &arena_p );
+    }
+    free( jobs_p );
+    if (reader_p != NULL)
+    {
+        delete_archive_reader( &reader_p );
+    }
+    return result;
+}
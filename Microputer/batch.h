@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for running archives of programs as one pipelined batch
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+#include "devices.h"
+#include "archive.h"
+#include "selector.h"
+
+/**************************** Constants ***************************************/
+
+/* Jobs ahead of the running one whose cache lines are fetched early */
+#define BATCH_PREFETCH_DEPTH 4
+#define BATCH_MAX_PREFETCH_DEPTH 16
+/* A job's manifest count when the archive has none for it */
+#define NO_EXPECTED_COUNT UINT64_MAX
+
+/************************ Batch Structs & Types *******************************/
+
+/* One program of the archive and what it runs with; the pointers are
+   copied out of the members, so prefetching a job reads only this */
+struct batch_job_s {
+    const byte_t * image_p;
+    size_t image_size;
+    /* The member "<program>.in" the job's RDDs read, or NULL */
+    const byte_t * input_p;
+    size_t input_size;
+    const char * name_p;
+    /* Instructions manifest.txt says the program runs, or NO_EXPECTED_COUNT */
+    uint64_t expected;
+} typedef batch_job_t;
+
+/* How a batch is run */
+struct batch_params_s {
+    /* ENGINE_REFERENCE, ENGINE_RUN_LOOP, ENGINE_PREDECODED or ENGINE_AUTO */
+    byte_t engine;
+    /* Picks the engine per job when engine is ENGINE_AUTO */
+    selector_t * selector_p;
+    /* The bus every job runs on; its console must be a stream console */
+    io_bus_t * bus_p;
+    /* The sink the console prints into, flushed before the report if it is
+       stdout, or NULL */
+    output_sink_t * sink_p;
+    /* 0 to BATCH_MAX_PREFETCH_DEPTH; 0 turns prefetching off */
+    int prefetch_depth;
+    /* 1 = keep the instance slots on huge pages */
+    byte_t huge_pages;
+} typedef batch_params_t;
+
+/************************ Public Batch Functions ******************************/
+
+int run_archive_batch(const char * archive_file_name_p,
+    const batch_params_t * params_p);
+
+#endif
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Instruction and branch coverage of microputer programs, reported in the
+/// lcov tracefile format against the .asm listing
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coverage.h"
+
+/***************************** Macros *****************************************/
+
+/* 1 if bit i of the bitmap is set */
+#define TEST_BIT(bitmap, i) (((bitmap)[ (i) / 32 ] >> ((i) % 32)) & 1u)
+
+/*******************************************************************************
+ *              Coverage Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates empty coverage
+/// @param out_cov_pp a pointer to a pointer of the coverage
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_coverage(coverage_t ** out_cov_pp)
+{
+    *out_cov_pp = (coverage_t *) calloc( 1, sizeof( coverage_t ) );
+    if (*out_cov_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_cov_pp] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Frees the coverage
+/// @param cov_pp a pointer to a pointer of the coverage
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_coverage(coverage_t ** cov_pp)
+{
+    if (*cov_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *cov_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    free( *cov_pp );
+    *cov_pp = NULL;
+    return SUCCESS;
+}
+
+/// @brief ORs one worker's coverage into shared coverage; atomic, so any 
+/// number of workers can merge into the same coverage at once
+/// @param into_p the shared coverage
+/// @param from_p the worker's coverage
+void merge_coverage(coverage_t * into_p, const coverage_t * from_p)
+{
+    for (int i = 0; i < NUM_COVERAGE_WORDS; i++)
+    {
+        __atomic_fetch_or( &into_p->executed[ i ], from_p->executed[ i ],
+            __ATOMIC_RELAXED );
+        __atomic_fetch_or( &into_p->taken[ i ], from_p->taken[ i ],
+            __ATOMIC_RELAXED );
+        __atomic_fetch_or( &into_p->not_taken[ i ], from_p->not_taken[ i ],
+            __ATOMIC_RELAXED );
+    }
+}
+
+/*******************************************************************************
+ *                          Report Functions
+ ******************************************************************************/
+
+/// @brief Works out the .asm line each word was written to; the annotated
+/// listing has a label line in front of every BLT target
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @param num_words the number of words in the listing
+/// @param annotated 1 if the listing was written annotated
+/// @param out_lines_p the 1-based line of each word
+static void listing_lines(microputer_t * mp_p, byte_t num_words, 
+    byte_t annotated, int * out_lines_p)
+{
+    byte_t is_target[ MEM_WORD_COUNT ] = { 0 };
+    int line = 0;
+
+    for (byte_t i = 0; i < num_words && annotated; i++)
+    {
+        byte_t addr = mp_p->mem_p[ i * WORD_SIZE + 1 ] & 0b11111;
+        if ((mp_p->mem_p[ i * WORD_SIZE ] >> 5) == 0b111 
+            && addr % WORD_SIZE == 0 && addr / WORD_SIZE < num_words)
+        {
+            is_target[ addr / WORD_SIZE ] = 1;
+        }
+    }
+    for (byte_t i = 0; i < num_words; i++)
+    {
+        line += 1 + is_target[ i ];
+        out_lines_p[ i ] = line;
+    }
+}
+
+/// @brief Writes a program's record of an lcov tracefile: a DA record per
+/// instruction line and a BRDA pair (taken, not taken) per BLT, and prints
+/// a summary. A tracefile may hold a record per program; lcov adds up
+/// records of the same listing
+/// @param cov_p the coverage
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @param asm_file_name_p the .asm listing the lines refer to
+/// @param annotated 1 if the listing was written annotated
+/// @param info_file_name_p the tracefile to write
+/// @param append 1 to add the record to the tracefile, 0 to replace it
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_lcov_report(const coverage_t * cov_p, microputer_t * mp_p,
+    const char * asm_file_name_p, byte_t annotated, 
+    const char * info_file_name_p, byte_t append)
+{
+    FILE * file_p = fopen( info_file_name_p, append ? "a" : "w" );
+    byte_t num_words = mp_p->loaded_mem_slots / WORD_SIZE;
+    int lines[ MEM_WORD_COUNT ];
+    int lines_hit = 0;
+    int branches = 0;
+    int branches_hit = 0;
+
+    if (!file_p)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            info_file_name_p );
+        return ERROR;
+    }
+    listing_lines( mp_p, num_words, annotated, lines );
+
+    fprintf( file_p, "TN:\nSF:%s\n", asm_file_name_p );
+    for (byte_t i = 0; i < num_words; i++)
+    {
+        int hit = TEST_BIT( cov_p->executed, i );
+        if ((mp_p->mem_p[ i * WORD_SIZE ] >> 5) != 0b111)
+        {
+            continue;
+        }
+        branches += 2;
+        if (!hit)
+        {
+            fprintf( file_p, "BRDA:%d,0,0,-\nBRDA:%d,0,1,-\n", 
+                lines[ i ], lines[ i ] );
+            continue;
+        }
+        fprintf( file_p, "BRDA:%d,0,0,%u\nBRDA:%d,0,1,%u\n", 
+            lines[ i ], TEST_BIT( cov_p->taken, i ),
+            lines[ i ], TEST_BIT( cov_p->not_taken, i ) );
+        branches_hit += TEST_BIT( cov_p->taken, i ) 
+            + TEST_BIT( cov_p->not_taken, i );
+    }
+    fprintf( file_p, "BRF:%d\nBRH:%d\n", branches, branches_hit );
+    for (byte_t i = 0; i < num_words; i++)
+    {
+        fprintf( file_p, "DA:%d,%u\n", lines[ i ], 
+            TEST_BIT( cov_p->executed, i ) );
+        lines_hit += TEST_BIT( cov_p->executed, i );
+    }
+    fprintf( file_p, "LF:%d\nLH:%d\nend_of_record\n", num_words, lines_hit );
+
+    if (fclose( file_p ) != 0)
+    {
+        printf( "\t# [ERROR: Can not write '%s'!] #\n", info_file_name_p );
+        return ERROR;
+    }
+    printf( "Coverage: %d/%d instructions, %d/%d branches -> '%s'\n", 
+        lines_hit, (int) num_words, branches_hit, branches, info_file_name_p );
+    return SUCCESS;
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for instruction and branch coverage of microputer programs
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* One bit per word of memory */
+#define NUM_COVERAGE_WORDS ((MEM_WORD_COUNT + 31) / 32)
+
+/********************** Coverage Structs & Types ******************************/
+
+/* Which instructions ran and which way each BLT went; while one is attached
+   to a microputer, run_micro_program uses the coverage instantiation */
+struct coverage_s {
+    uint32_t executed[ NUM_COVERAGE_WORDS ];
+    uint32_t taken[ NUM_COVERAGE_WORDS ];
+    uint32_t not_taken[ NUM_COVERAGE_WORDS ];
+} typedef coverage_t;
+
+/*********************** Public Coverage Functions ****************************/
+
+int create_coverage(coverage_t ** out_cov_pp);
+int delete_coverage(coverage_t ** cov_pp);
+void merge_coverage(coverage_t * into_p, const coverage_t * from_p);
+int write_lcov_report(const coverage_t * cov_p, microputer_t * mp_p,
+    const char * asm_file_name_p, byte_t annotated, 
+    const char * info_file_name_p, byte_t append);
+
+#endif
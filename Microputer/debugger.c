@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Breakpoints and watchpoints on a microputer
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debugger.h"
+
+/*******************************************************************************
+ *              Debugger Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates a debugger with nothing set
+/// @param out_dbg_pp a pointer to a pointer of the debugger
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_debugger(debugger_t ** out_dbg_pp)
+{
+    *out_dbg_pp = (debugger_t *) calloc( 1, sizeof( debugger_t ) );
+    if (*out_dbg_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_dbg_pp] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Frees the debugger
+/// @param dbg_pp a pointer to a pointer of the debugger
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_debugger(debugger_t ** dbg_pp)
+{
+    if (*dbg_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *dbg_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    free( *dbg_pp );
+    *dbg_pp = NULL;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                   Breakpoint & Watchpoint Functions
+ ******************************************************************************/
+
+/// @brief Stops execution before the instruction at addr
+/// @param dbg_p debugger pointer
+/// @param addr a word aligned address in memory
+/// @return 1 if SUCCESS, otherwise ERROR
+int set_breakpoint(debugger_t * dbg_p, uint16_t addr)
+{
+    if (addr % WORD_SIZE != 0 || addr >= MEM_BYTE_SIZE)
+    {
+        printf( "\t# [ERROR: no instruction at address %hu] #\n", addr );
+        return ERROR;
+    }
+    dbg_p->breakpoints[ addr / WORD_SIZE / 32 ] |= 
+        1u << (addr / WORD_SIZE % 32);
+    return SUCCESS;
+}
+
+/// @brief Removes the breakpoint at addr
+/// @param dbg_p debugger pointer
+/// @param addr a word aligned address in memory
+/// @return 1 if SUCCESS, otherwise ERROR
+int clear_breakpoint(debugger_t * dbg_p, uint16_t addr)
+{
+    if (addr % WORD_SIZE != 0 || addr >= MEM_BYTE_SIZE)
+    {
+        printf( "\t# [ERROR: no instruction at address %hu] #\n", addr );
+        return ERROR;
+    }
+    dbg_p->breakpoints[ addr / WORD_SIZE / 32 ] &= 
+        ~(1u << (addr / WORD_SIZE % 32));
+    return SUCCESS;
+}
+
+/// @brief Stops execution after any instruction that changes the register
+/// @param dbg_p debugger pointer
+/// @param reg_index the register
+/// @return 1 if SUCCESS, otherwise ERROR
+int set_watchpoint(debugger_t * dbg_p, byte_t reg_index)
+{
+    if (reg_index >= NUM_REGISTERS)
+    {
+        printf( "\t# [ERROR: there is no register R%hu] #\n", 
+            (uint16_t) reg_index );
+        return ERROR;
+    }
+    dbg_p->watch_mask |= 1u << reg_index;
+    return SUCCESS;
+}
+
+/// @brief Removes the watchpoint on the register
+/// @param dbg_p debugger pointer
+/// @param reg_index the register
+/// @return 1 if SUCCESS, otherwise ERROR
+int clear_watchpoint(debugger_t * dbg_p, byte_t reg_index)
+{
+    if (reg_index >= NUM_REGISTERS)
+    {
+        printf( "\t# [ERROR: there is no register R%hu] #\n", 
+            (uint16_t) reg_index );
+        return ERROR;
+    }
+    dbg_p->watch_mask &= ~(1u << reg_index);
+    return SUCCESS;
+}
+
+/// @brief Prints why the debug engine stopped
+/// @param mp_p microputer pointer (with a debugger attached)
+void print_debugger_stop(microputer_t * mp_p)
+{
+    debugger_t * dbg_p = mp_p->debugger_p;
+
+    switch (dbg_p->stop_reason)
+    {
+        case STOP_BREAKPOINT:
+            printf( "\t# [BREAK: pc %hu, cycle %llu] #\n", dbg_p->stop_pc,
+                (unsigned long long) mp_p->cycles );
+            break;
+        case STOP_WATCHPOINT:
+            for (byte_t i = 0; i < NUM_REGISTERS; i++)
+            {
+                if (dbg_p->changed_mask & (1u << i))
+                {
+                    printf( "\t# [WATCH: R%hu %hu -> %hu at pc %hu] #\n", 
+                        (uint16_t) i, (uint16_t) dbg_p->old_reg[ i ], 
+                        (uint16_t) mp_p->reg[ i ], dbg_p->stop_pc );
+                }
+            }
+            break;
+    }
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file to model breakpoints and watchpoints on a microputer
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* One breakpoint bit per word of memory */
+#define NUM_BREAKPOINT_WORDS ((MEM_WORD_COUNT + 31) / 32)
+
+/* Why the debug engine last returned */
+#define STOP_NONE 0         // budget used up or program halted
+#define STOP_BREAKPOINT 1   // pc reached a breakpoint (not yet executed)
+#define STOP_WATCHPOINT 2   // a watched register changed (already executed)
+
+/********************** Debugger Structs & Types ******************************/
+
+/* Represents the breakpoints and watchpoints set on a microputer; while one
+   is attached, run_micro_program uses the debug instantiation of the loop */
+struct debugger_s {
+    uint32_t breakpoints[ NUM_BREAKPOINT_WORDS ];
+    /* Bit i set = stop when Ri changes */
+    uint16_t watch_mask;
+    byte_t stop_reason;
+    /* Address of the instruction the engine stopped at/after */
+    uint16_t stop_pc;
+    /* Watched registers that changed, and their values before the change */
+    uint16_t changed_mask;
+    byte_t old_reg[ NUM_REGISTERS ];
+    /* 1 = don't stop at the breakpoint the last run stopped at */
+    byte_t resume_over;
+} typedef debugger_t;
+
+/*********************** Public Debugger Functions ****************************/
+
+int create_debugger(debugger_t ** out_dbg_pp);
+int delete_debugger(debugger_t ** dbg_pp);
+int set_breakpoint(debugger_t * dbg_p, uint16_t addr);
+int clear_breakpoint(debugger_t * dbg_p, uint16_t addr);
+int set_watchpoint(debugger_t * dbg_p, byte_t reg_index);
+int clear_watchpoint(debugger_t * dbg_p, byte_t reg_index);
+void print_debugger_stop(microputer_t * mp_p);
+
+#endif
@@ -0,0 +1,815 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Simulates the I/O devices PRT and RDD talk to
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "devices.h"
+#include "shmring.h"
+
+/************************** Private Types *************************************/
+
+/* State of a stream console */
+struct stream_console_s {
+    input_t input;
+    byte_t has_input;
+    output_sink_t * sink_p;
+} typedef stream_console_t;
+
+/* State of a block device */
+struct block_state_s {
+    int fd;
+    uint16_t addr;
+} typedef block_state_t;
+
+/**************************** Globals *****************************************/
+
+/* Every port nothing is attached to maps to one of these: the unmapped
+   device stops the program with an error, the null device reads 0 and
+   ignores writes (for buses that run programs only to time or count them) */
+static device_t unmapped_device;
+static device_t null_device;
+
+static io_bus_t * default_bus_p = NULL;
+static pthread_once_t default_bus_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+ *                        Random Sequence Functions
+ ******************************************************************************/
+
+/// @brief Turns a seed into the first state of a xorshift32 sequence
+/// @param seed the seed
+/// @return the state (never 0)
+uint32_t xorshift_seed(uint32_t seed)
+{
+    return seed ? seed : XORSHIFT_ZERO_SEED;
+}
+
+/// @brief Next value of a xorshift32 sequence; the random and capture
+/// devices, the generator and the differential tester all draw from it
+/// @param state_p the sequence state (never 0)
+/// @return the value
+uint32_t next_xorshift(uint32_t * state_p)
+{
+    uint32_t x = *state_p;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state_p = x;
+    return x;
+}
+
+/*******************************************************************************
+ *                          Device Callbacks
+ ******************************************************************************/
+
+/// @brief Unmapped port read; nothing answers, so the program stops
+/// @return ERROR
+static int unmapped_read(device_t * dev_p, microputer_t * mp_p, 
+    byte_t offset, byte_t reg_index, byte_t * out_value_p)
+{
+    printf( "\t# [ERROR: RDD from port %hu, which has no device] #\n",
+        (uint16_t) offset );
+    return ERROR;
+}
+
+/// @brief Unmapped port write; nothing answers, so the program stops
+/// @return ERROR
+static int unmapped_write(device_t * dev_p, microputer_t * mp_p, 
+    byte_t offset, byte_t reg_index, byte_t value)
+{
+    printf( "\t# [ERROR: PRT to port %hu, which has no device] #\n",
+        (uint16_t) offset );
+    return ERROR;
+}
+
+/// @brief Null device read
+/// @return SUCCESS
+static int null_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    *out_value_p = 0;
+    return SUCCESS;
+}
+
+/// @brief Null device write
+/// @return SUCCESS
+static int null_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    return SUCCESS;
+}
+
+/// @brief Console read; prompts for the register and reads a decimal value
+/// @return SUCCESS
+static int console_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    unsigned int input = 0;
+
+    printf( "Enter a value for R%d: ", (uint16_t) reg_index ); 
+    scanf( "%d", &input );                      // read in an integer
+    *out_value_p = (byte_t) (input & 0x00FF);   // take lower 8 bits
+    return SUCCESS;
+}
+
+/// @brief Console write; prints the register (in decimal)
+/// @return SUCCESS
+static int console_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    printf( "R%hu = %hu\n", (uint16_t) reg_index, (uint16_t) value );
+    return SUCCESS;
+}
+
+/// @brief Stream console read; the next value of the input file, or 0 once
+/// it has run out (as the console reads at the end of stdin). Without an
+/// input file it prompts like the console, after the output so far
+/// @return 1 if SUCCESS, otherwise ERROR
+static int stream_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    stream_console_t * stream_p = (stream_console_t *) dev_p->state_p;
+    input_t * input_p = &stream_p->input;
+
+    if (!stream_p->has_input)
+    {
+        if (stream_p->sink_p != NULL && stream_p->sink_p->file_p == stdout
+            && flush_output_sink( stream_p->sink_p ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        return console_read( dev_p, mp_p, offset, reg_index, out_value_p );
+    }
+    *out_value_p = input_p->next < input_p->num_values ? 
+        input_p->values_p[ input_p->next++ ] : 0;
+    return SUCCESS;
+}
+
+/// @brief Stream console write; into the output sink, or printed like the
+/// console without one
+/// @return 1 if SUCCESS, otherwise ERROR
+static int stream_write(device_t * dev_p, microputer_t * mp_p, 
+    byte_t offset, byte_t reg_index, byte_t value)
+{
+    stream_console_t * stream_p = (stream_console_t *) dev_p->state_p;
+
+    if (stream_p->sink_p == NULL)
+    {
+        return console_write( dev_p, mp_p, offset, reg_index, value );
+    }
+    return write_prt_output( stream_p->sink_p, reg_index, value );
+}
+
+/// @brief Ring console read; the next value another process sent over the
+/// channel, waiting for it if need be, or 0 once that process is done
+/// @return SUCCESS
+static int ring_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    shm_receive( (shm_link_t *) dev_p->state_p, out_value_p );
+    return SUCCESS;
+}
+
+/// @brief Ring console write; sends the value back over the channel,
+/// waiting for room if the other process has fallen behind
+/// @return 1 if SUCCESS, otherwise ERROR (that process died, and nothing
+/// will ever make room)
+static int ring_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    if (shm_send( (shm_link_t *) dev_p->state_p, value ) != SUCCESS)
+    {
+        printf( "\t# [ERROR: the other end of the ring channel is gone] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Timer read; byte offset of the core's cycle counter
+/// @return SUCCESS
+static int timer_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    *out_value_p = (byte_t) (mp_p->cycles >> (8 * offset));
+    return SUCCESS;
+}
+
+/// @brief Timer write; programs the core's timer interrupt
+/// @return 1 if SUCCESS, otherwise ERROR (a vector that is odd or past the
+/// loaded program, which the interrupt could not run)
+static int timer_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    switch (offset)
+    {
+        case TIMER_PERIOD:
+            mp_p->timer_period = (uint64_t) value * TIMER_TICK_CYCLES;
+            mp_p->next_event = value ? 
+                mp_p->cycles + mp_p->timer_period : NO_EVENT;
+            break;
+        case TIMER_VECTOR:
+            if (value % WORD_SIZE != 0 || value >= mp_p->loaded_mem_slots)
+            {
+                printf( "\t# [ERROR: timer vector %hu is not an instruction "
+                    "of the program] #\n", (uint16_t) value );
+                return ERROR;
+            }
+            mp_p->irq_vector = value;
+            break;
+        case TIMER_RETURN:
+            if (mp_p->in_interrupt)
+            {
+                mp_p->pc = mp_p->saved_pc;
+                mp_p->in_interrupt = 0;
+            }
+            break;
+    }
+    return SUCCESS;
+}
+
+/// @brief Random read; next byte of a xorshift32 sequence
+/// @return SUCCESS
+static int random_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    *out_value_p = (byte_t) (next_xorshift( (uint32_t *) dev_p->state_p ) 
+        >> 24);
+    return SUCCESS;
+}
+
+/// @brief Random write; reseeds the sequence
+/// @return SUCCESS
+static int random_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    /* Never 0, as XORSHIFT_ZERO_SEED has high bits set */
+    *(uint32_t *) dev_p->state_p = XORSHIFT_ZERO_SEED ^ value;
+    return SUCCESS;
+}
+
+/// @brief Block read; address bytes, or the data byte at the address (which
+/// then advances); bytes past the end of the file read as 0
+/// @return 1 if SUCCESS, otherwise ERROR
+static int block_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    block_state_t * block_p = (block_state_t *) dev_p->state_p;
+
+    switch (offset)
+    {
+        case 0: *out_value_p = (byte_t) block_p->addr; break;
+        case 1: *out_value_p = (byte_t) (block_p->addr >> 8); break;
+        default:
+            *out_value_p = 0;
+            if (pread( block_p->fd, out_value_p, 1, block_p->addr ) < 0)
+            {
+                printf( "\t# [ERROR: block device read failed!] #\n" );
+                return ERROR;
+            }
+            block_p->addr++;
+    }
+    return SUCCESS;
+}
+
+/// @brief Block write; sets an address byte, or writes the data byte at the
+/// address (which then advances)
+/// @return 1 if SUCCESS, otherwise ERROR
+static int block_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    block_state_t * block_p = (block_state_t *) dev_p->state_p;
+
+    switch (offset)
+    {
+        case 0: block_p->addr = (block_p->addr & 0xFF00) | value; break;
+        case 1: block_p->addr = (block_p->addr & 0x00FF) | (value << 8); break;
+        default:
+            if (pwrite( block_p->fd, &value, 1, block_p->addr ) != 1)
+            {
+                printf( "\t# [ERROR: block device write failed!] #\n" );
+                return ERROR;
+            }
+            block_p->addr++;
+    }
+    return SUCCESS;
+}
+
+/// @brief Capture read; next value of a xorshift32 sequence, so every run
+/// from the same seed reads the same input
+/// @return SUCCESS
+static int capture_read(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t * out_value_p)
+{
+    capture_t * capture_p = (capture_t *) dev_p->state_p;
+
+    *out_value_p = (byte_t) (next_xorshift( &capture_p->input_state ) >> 24);
+    return SUCCESS;
+}
+
+/// @brief Capture write; appends what the console would have printed
+/// @return 1 if SUCCESS, otherwise ERROR
+static int capture_write(device_t * dev_p, microputer_t * mp_p, byte_t offset,
+    byte_t reg_index, byte_t value)
+{
+    capture_t * capture_p = (capture_t *) dev_p->state_p;
+    char line[ PRT_LINE_STRIDE ];
+    size_t len = format_prt_line( reg_index, value, line );
+    size_t capacity = capture_p->output_capacity;
+    char * output_p;
+
+    if (capture_p->output_len + len > capacity 
+        && capacity < CAPTURE_MAX_OUTPUT)
+    {
+        capacity = capacity ? capacity * 2 : 256;
+        output_p = (char *) realloc( capture_p->output_p, capacity );
+        if (output_p == NULL)
+        {
+            printf( "\t# [ERROR: realloc failed to grow captured output] #\n" );
+            return ERROR;
+        }
+        capture_p->output_p = output_p;
+        capture_p->output_capacity = capacity;
+    }
+    if (capture_p->output_len + len <= capture_p->output_capacity)
+    {
+        memcpy( capture_p->output_p + capture_p->output_len, line, len );
+    }
+    capture_p->output_len += len;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                     Device Creation & Termination
+ ******************************************************************************/
+
+/// @brief Allocates a device with the given callbacks
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @return 1 if SUCCESS, otherwise ERROR
+static int create_device(device_t ** out_dev_pp, const char * name_p,
+    int (*read)(device_t *, microputer_t *, byte_t, byte_t, byte_t *),
+    int (*write)(device_t *, microputer_t *, byte_t, byte_t, byte_t),
+    byte_t num_ports, byte_t deferrable)
+{
+    *out_dev_pp = (device_t *) calloc( 1, sizeof( device_t ) );
+    if (*out_dev_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate device '%s'] #\n",
+            name_p );
+        return ERROR;
+    }
+    (*out_dev_pp)->name_p = name_p;
+    (*out_dev_pp)->read = read;
+    (*out_dev_pp)->write = write;
+    (*out_dev_pp)->num_ports = num_ports;
+    (*out_dev_pp)->deferrable = deferrable;
+    return SUCCESS;
+}
+
+/// @brief Creates the console (stdin/stdout) device
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_console_device(device_t ** out_dev_pp)
+{
+    return create_device( out_dev_pp, "console", console_read, console_write,
+        1, 1 );
+}
+
+/// @brief Creates a console for batch runs: RDD reads an input file instead
+/// of prompting on stdin, and PRT goes to a buffered output sink
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @param file_name_p the input file, or NULL to prompt on stdin
+/// @param format INPUT_TEXT or INPUT_BINARY
+/// @param sink_p the output sink (not freed with the device), or NULL to
+/// print like the console
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_stream_console_device(device_t ** out_dev_pp, 
+    const char * file_name_p, int format, output_sink_t * sink_p)
+{
+    stream_console_t * stream_p = NULL;
+
+    if (create_device( out_dev_pp, "console", stream_read, stream_write,
+        1, 1 ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    stream_p = (stream_console_t *) calloc( 1, sizeof( stream_console_t ) );
+    (*out_dev_pp)->state_p = stream_p;
+    if (stream_p == NULL)
+    {
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    stream_p->sink_p = sink_p;
+    if (file_name_p != NULL)
+    {
+        if (load_input_file( &stream_p->input, file_name_p, format ) 
+            != SUCCESS)
+        {
+            delete_device( out_dev_pp );
+            return ERROR;
+        }
+        stream_p->has_input = 1;
+    }
+    return SUCCESS;
+}
+
+/// @brief Swaps the input file of a stream console, so a bus can be reused
+/// for the next job
+/// @param dev_p the stream console
+/// @param file_name_p the new input file, or NULL for no input (RDD reads 0)
+/// @param format INPUT_TEXT or INPUT_BINARY
+/// @return 1 if SUCCESS, otherwise ERROR
+int load_stream_console_input(device_t * dev_p, const char * file_name_p,
+    int format)
+{
+    stream_console_t * stream_p = (stream_console_t *) dev_p->state_p;
+
+    if (dev_p->read != stream_read)
+    {
+        printf( "\t# [ERROR: '%s' is not a stream console] #\n", 
+            dev_p->name_p );
+        return ERROR;
+    }
+    unload_input_file( &stream_p->input );
+    stream_p->has_input = 1;
+    return file_name_p != NULL 
+        ? load_input_file( &stream_p->input, file_name_p, format ) : SUCCESS;
+}
+
+/// @brief Points a stream console's input at values held elsewhere (e.g.
+/// in an archive being read), which must outlive the job
+/// @param dev_p the stream console
+/// @param values_p the values RDD reads, in order, or NULL for none
+/// @param num_values how many there are
+/// @return 1 if SUCCESS, otherwise ERROR
+int set_stream_console_values(device_t * dev_p, const byte_t * values_p,
+    uint64_t num_values)
+{
+    stream_console_t * stream_p = (stream_console_t *) dev_p->state_p;
+
+    if (load_stream_console_input( dev_p, NULL, INPUT_BINARY ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    stream_p->input.values_p = (byte_t *) values_p;
+    stream_p->input.num_values = values_p != NULL ? num_values : 0;
+    stream_p->input.borrowed = 1;
+    return SUCCESS;
+}
+
+/// @brief Creates a console whose RDD and PRT go over a shared memory ring
+/// channel (see shmring.h), so other local processes can feed the program
+/// and read what it prints without pipes or sockets
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @param channel_name_p the channel, created if no process has yet
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_ring_console_device(device_t ** out_dev_pp, 
+    const char * channel_name_p)
+{
+    shm_link_t * link_p = NULL;
+
+    if (create_device( out_dev_pp, "ring console", ring_read, ring_write,
+        1, 1 ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    if (open_shm_link( &link_p, channel_name_p, SHM_END_MICROPUTER ) 
+        != SUCCESS)
+    {
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    (*out_dev_pp)->state_p = link_p;
+    return SUCCESS;
+}
+
+/// @brief Creates the timer device; it reads and programs the timer of 
+/// whichever core talks to it, so its writes can never be deferred
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_timer_device(device_t ** out_dev_pp)
+{
+    return create_device( out_dev_pp, "timer", timer_read, timer_write,
+        TIMER_NUM_PORTS, 0 );
+}
+
+/// @brief Creates the random source device
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @param seed the initial seed
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_random_device(device_t ** out_dev_pp, uint32_t seed)
+{
+    if (create_device( out_dev_pp, "random", random_read, random_write, 
+        1, 1 ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    (*out_dev_pp)->state_p = malloc( sizeof( uint32_t ) );
+    if ((*out_dev_pp)->state_p == NULL)
+    {
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    *(uint32_t *) (*out_dev_pp)->state_p = xorshift_seed( seed );
+    return SUCCESS;
+}
+
+/// @brief Creates a block device backed by a local file (created if missing)
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @param file_name_p the backing file
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_block_device(device_t ** out_dev_pp, const char * file_name_p)
+{
+    block_state_t * block_p = NULL;
+
+    if (create_device( out_dev_pp, "block", block_read, block_write, 
+        BLOCK_NUM_PORTS, 1 ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    block_p = (block_state_t *) calloc( 1, sizeof( block_state_t ) );
+    (*out_dev_pp)->state_p = block_p;
+    if (block_p == NULL)
+    {
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    block_p->fd = open( file_name_p, O_RDWR | O_CREAT, 0644 );
+    if (block_p->fd < 0)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n", 
+            file_name_p );
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Creates a capture device, a stand-in for the console that keeps
+/// what is printed (see capture_t) and reads a seeded sequence
+/// @param out_dev_pp a pointer to a pointer of the device
+/// @param input_seed the seed of what RDD reads
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_capture_device(device_t ** out_dev_pp, uint32_t input_seed)
+{
+    capture_t * capture_p = NULL;
+
+    if (create_device( out_dev_pp, "capture", capture_read, capture_write, 
+        1, 1 ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    capture_p = (capture_t *) calloc( 1, sizeof( capture_t ) );
+    (*out_dev_pp)->state_p = capture_p;
+    if (capture_p == NULL)
+    {
+        delete_device( out_dev_pp );
+        return ERROR;
+    }
+    capture_p->input_state = xorshift_seed( input_seed );
+    return SUCCESS;
+}
+
+/// @brief Frees a device and its state
+/// @param dev_pp a pointer to a pointer of the device
+void delete_device(device_t ** dev_pp)
+{
+    if (*dev_pp == NULL)
+    {
+        return;
+    }
+    if ((*dev_pp)->read == block_read && (*dev_pp)->state_p != NULL)
+    {
+        block_state_t * block_p = (block_state_t *) (*dev_pp)->state_p;
+        if (block_p->fd >= 0)
+        {
+            close( block_p->fd );
+        }
+    }
+    if ((*dev_pp)->read == capture_read && (*dev_pp)->state_p != NULL)
+    {
+        free( ((capture_t *) (*dev_pp)->state_p)->output_p );
+    }
+    if ((*dev_pp)->read == stream_read && (*dev_pp)->state_p != NULL)
+    {
+        unload_input_file( &((stream_console_t *) (*dev_pp)->state_p)->input );
+    }
+    /* The link is freed with the channel; the client sees it close */
+    if ((*dev_pp)->read == ring_read && (*dev_pp)->state_p != NULL)
+    {
+        close_shm_link( (shm_link_t **) &(*dev_pp)->state_p );
+    }
+    free( (*dev_pp)->state_p );
+    free( *dev_pp );
+    *dev_pp = NULL;
+}
+
+/*******************************************************************************
+ *                           I/O Bus Functions
+ ******************************************************************************/
+
+/// @brief Allocates a bus whose every port maps to one stateless device
+/// @param out_bus_pp a pointer to a pointer of the bus
+/// @param dev_p the device
+/// @return 1 if SUCCESS, otherwise ERROR
+static int create_bus_of(io_bus_t ** out_bus_pp, device_t * dev_p)
+{
+    /* Both are stateless, so one of each serves every bus */
+    unmapped_device.name_p = "unmapped";
+    unmapped_device.read = unmapped_read;
+    unmapped_device.write = unmapped_write;
+    /* So a parallel machine stops at the PRT, not at a later flush */
+    unmapped_device.deferrable = 0;
+    null_device.name_p = "null";
+    null_device.read = null_read;
+    null_device.write = null_write;
+    null_device.deferrable = 1;
+
+    *out_bus_pp = (io_bus_t *) calloc( 1, sizeof( io_bus_t ) );
+    if (*out_bus_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_bus_pp] #\n" );
+        return ERROR;
+    }
+    for (int i = 0; i < NUM_IO_PORTS; i++)
+    {
+        (*out_bus_pp)->port_map[ i ] = dev_p;
+    }
+    return SUCCESS;
+}
+
+/// @brief Allocates an I/O bus with nothing attached; PRT or RDD on a port
+/// without a device stops the program with an error
+/// @param out_bus_pp a pointer to a pointer of the bus
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_io_bus(io_bus_t ** out_bus_pp)
+{
+    return create_bus_of( out_bus_pp, &unmapped_device );
+}
+
+/// @brief Allocates an I/O bus whose every port reads 0 and ignores writes,
+/// for running programs only to time or count them
+/// @param out_bus_pp a pointer to a pointer of the bus
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_null_io_bus(io_bus_t ** out_bus_pp)
+{
+    return create_bus_of( out_bus_pp, &null_device );
+}
+
+/// @brief Allocates an I/O bus with the console, timer and random source
+/// attached at their default ports
+/// @param out_bus_pp a pointer to a pointer of the bus
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_default_io_bus(io_bus_t ** out_bus_pp)
+{
+    device_t * dev_p = NULL;
+
+    if (create_io_bus( out_bus_pp ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    if (create_console_device( &dev_p ) != SUCCESS 
+        || attach_device( *out_bus_pp, dev_p, CONSOLE_PORT ) != SUCCESS
+        || create_timer_device( &dev_p ) != SUCCESS 
+        || attach_device( *out_bus_pp, dev_p, TIMER_PORT ) != SUCCESS
+        || create_random_device( &dev_p, 0 ) != SUCCESS 
+        || attach_device( *out_bus_pp, dev_p, RANDOM_PORT ) != SUCCESS)
+    {
+        delete_device( &dev_p );
+        delete_io_bus( out_bus_pp );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Frees a bus and every device attached to it
+/// @param bus_pp a pointer to a pointer of the bus
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_io_bus(io_bus_t ** bus_pp)
+{
+    if (*bus_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *bus_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    for (byte_t i = 0; i < (*bus_pp)->num_devices; i++)
+    {
+        delete_device( &(*bus_pp)->devices_p[ i ] );
+    }
+    free( *bus_pp );
+    *bus_pp = NULL;
+    return SUCCESS;
+}
+
+/// @brief Creates the process-wide default bus
+static void create_process_bus(void)
+{
+    create_default_io_bus( &default_bus_p );
+}
+
+/// @brief The bus new microputers start out with: console, timer and random
+/// source at their default ports, shared by the whole process
+/// @return the bus, or NULL if it could not be created
+io_bus_t * default_io_bus(void)
+{
+    pthread_once( &default_bus_once, create_process_bus );
+    return default_bus_p;
+}
+
+/// @brief Maps a device onto num_ports ports starting at base_port; the bus
+/// takes ownership of the device
+/// @param bus_p bus pointer
+/// @param dev_p the device
+/// @param base_port the first port
+/// @return 1 if SUCCESS, otherwise ERROR
+int attach_device(io_bus_t * bus_p, device_t * dev_p, byte_t base_port)
+{
+    if (bus_p->num_devices == MAX_DEVICES 
+        || base_port + dev_p->num_ports > NUM_IO_PORTS)
+    {
+        printf( "\t# [ERROR: can not attach '%s' at port %hu] #\n",
+            dev_p->name_p, (uint16_t) base_port );
+        return ERROR;
+    }
+    dev_p->base_port = base_port;
+    for (int i = 0; i < dev_p->num_ports; i++)
+    {
+        bus_p->port_map[ base_port + i ] = dev_p;
+    }
+    bus_p->devices_p[ bus_p->num_devices++ ] = dev_p;
+    return SUCCESS;
+}
+
+/// @brief Records where the bus's devices are in their streams: the next
+/// input value of a stream console, the random and capture sequences, and
+/// the block device's address. Devices the bus lacks are left at 0
+/// @param bus_p bus pointer
+/// @param out_cursors_p where to record them
+void save_device_cursors(const io_bus_t * bus_p, 
+    device_cursors_t * out_cursors_p)
+{
+    device_t * dev_p;
+
+    memset( out_cursors_p, 0, sizeof( device_cursors_t ) );
+    for (byte_t i = 0; i < bus_p->num_devices; i++)
+    {
+        dev_p = bus_p->devices_p[ i ];
+        if (dev_p->read == stream_read)
+        {
+            out_cursors_p->console_next = 
+                ((stream_console_t *) dev_p->state_p)->input.next;
+        } else if (dev_p->read == random_read)
+        {
+            out_cursors_p->random_state = *(uint32_t *) dev_p->state_p;
+        } else if (dev_p->read == capture_read)
+        {
+            out_cursors_p->capture_state = 
+                ((capture_t *) dev_p->state_p)->input_state;
+        } else if (dev_p->read == block_read)
+        {
+            out_cursors_p->block_addr = 
+                ((block_state_t *) dev_p->state_p)->addr;
+        }
+    }
+}
+
+/// @brief Moves the bus's devices to where save_device_cursors found 
+/// another bus's; a console past the end of its input reads 0 as usual, 
+/// and a sequence recorded as 0 (no such device) keeps its own state
+/// @param bus_p bus pointer
+/// @param cursors_p the recorded cursors
+void restore_device_cursors(io_bus_t * bus_p, 
+    const device_cursors_t * cursors_p)
+{
+    device_t * dev_p;
+
+    for (byte_t i = 0; i < bus_p->num_devices; i++)
+    {
+        dev_p = bus_p->devices_p[ i ];
+        if (dev_p->read == stream_read)
+        {
+            ((stream_console_t *) dev_p->state_p)->input.next = 
+                cursors_p->console_next;
+        } else if (dev_p->read == random_read && cursors_p->random_state)
+        {
+            *(uint32_t *) dev_p->state_p = cursors_p->random_state;
+        } else if (dev_p->read == capture_read && cursors_p->capture_state)
+        {
+            ((capture_t *) dev_p->state_p)->input_state = 
+                cursors_p->capture_state;
+        } else if (dev_p->read == block_read)
+        {
+            ((block_state_t *) dev_p->state_p)->addr = cursors_p->block_addr;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file to model the I/O devices PRT and RDD talk to
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DEVICES_H
+#define DEVICES_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+#include "input.h"
+#include "output.h"
+
+/**************************** Constants ***************************************/
+
+/* PRT/RDD carry an 8-bit port number in bits 8..1 (LDI's immediate field) */
+#define NUM_IO_PORTS 256
+#define MAX_DEVICES 16
+
+/* Default port layout; port 0 is what every existing program talks to */
+#define CONSOLE_PORT 0
+#define TIMER_PORT 4        // 4 ports: see the timer offsets below
+#define RANDOM_PORT 8       // 1 port: read = random byte, write = seed
+#define BLOCK_PORT 16       // 3 ports: address low, address high, data
+
+#define TIMER_NUM_PORTS 4
+/* Timer offsets. Reads return the core's cycle counter, low byte first.
+   PRT Ri to TIMER_PERIOD arms a periodic interrupt every Ri ticks (0 stops
+   it), TIMER_VECTOR sets the address it jumps to (an even one inside the
+   program), and any PRT to TIMER_RETURN resumes the interrupted program */
+#define TIMER_PERIOD 0
+#define TIMER_VECTOR 1
+#define TIMER_RETURN 2
+#define TIMER_TICK_CYCLES 1024
+#define BLOCK_NUM_PORTS 3
+/* xorshift never leaves 0, so a 0 seed is nudged to this */
+#define XORSHIFT_ZERO_SEED 0x9E3779B9u
+/* Most console output a capture device keeps; the rest is only counted */
+#define CAPTURE_MAX_OUTPUT (1 << 20)
+
+/*********************** Device Structs & Types *******************************/
+
+/* Represents a device mapped onto a range of I/O ports */
+struct device_s {
+    const char * name_p;
+    /* Handles RDD Ri from the device; offset is relative to base_port */
+    int (*read)(struct device_s * dev_p, microputer_t * mp_p, byte_t offset,
+        byte_t reg_index, byte_t * out_value_p);
+    /* Handles PRT Ri to the device */
+    int (*write)(struct device_s * dev_p, microputer_t * mp_p, byte_t offset,
+        byte_t reg_index, byte_t value);
+    /* 1 = writes have no effect on the core, so they may be buffered */
+    byte_t deferrable;
+    byte_t base_port;
+    byte_t num_ports;
+    /* Device specific state, freed with the device */
+    void * state_p;
+} typedef device_t;
+
+/* State of a capture device: a console that prints into memory and reads
+   a seeded sequence, so runs can be repeated and compared */
+struct capture_s {
+    char * output_p;
+    /* Bytes printed, including any past CAPTURE_MAX_OUTPUT */
+    uint64_t output_len;
+    size_t output_capacity;
+    uint32_t input_state;
+} typedef capture_t;
+
+/* Represents the I/O port space; a page table with one entry per port */
+struct io_bus_s {
+    /* Unmapped ports point at a device that stops the program (or on a
+       null bus, reads 0), so dispatch never checks */
+    device_t * port_map[ NUM_IO_PORTS ];
+    device_t * devices_p[ MAX_DEVICES ];
+    byte_t num_devices;
+} typedef io_bus_t;
+
+/* Where a bus's devices are in their streams, so a job suspended on one
+   bus can carry on from another */
+struct device_cursors_s {
+    /* Index of the value a stream console's next RDD reads */
+    uint64_t console_next;
+    /* xorshift states; never 0 when the bus has the device */
+    uint32_t random_state;
+    uint32_t capture_state;
+    uint16_t block_addr;
+} typedef device_cursors_t;
+
+/************************ Public Device Functions *****************************/
+
+int create_io_bus(io_bus_t ** out_bus_pp);
+int create_null_io_bus(io_bus_t ** out_bus_pp);
+int create_default_io_bus(io_bus_t ** out_bus_pp);
+int delete_io_bus(io_bus_t ** bus_pp);
+io_bus_t * default_io_bus(void);
+int attach_device(io_bus_t * bus_p, device_t * dev_p, byte_t base_port);
+
+int create_console_device(device_t ** out_dev_pp);
+int create_stream_console_device(device_t ** out_dev_pp, 
+    const char * file_name_p, int format, output_sink_t * sink_p);
+int load_stream_console_input(device_t * dev_p, const char * file_name_p,
+    int format);
+int set_stream_console_values(device_t * dev_p, const byte_t * values_p,
+    uint64_t num_values);
+int create_ring_console_device(device_t ** out_dev_pp, 
+    const char * channel_name_p);
+int create_timer_device(device_t ** out_dev_pp);
+int create_random_device(device_t ** out_dev_pp, uint32_t seed);
+int create_block_device(device_t ** out_dev_pp, const char * file_name_p);
+int create_capture_device(device_t ** out_dev_pp, uint32_t input_seed);
+void delete_device(device_t ** dev_pp);
+void save_device_cursors(const io_bus_t * bus_p, 
+    device_cursors_t * out_cursors_p);
+void restore_device_cursors(io_bus_t * bus_p, 
+    const device_cursors_t * cursors_p);
+uint32_t xorshift_seed(uint32_t seed);
+uint32_t next_xorshift(uint32_t * state_p);
+
+#endif
@@ -0,0 +1,478 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Differential testing: runs corpus and random programs on every engine
+/// with identical input and compares registers, PC, cycles and console
+/// output byte for byte against the reference interpreter
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "difftest.h"
+#include "devices.h"
+#include "debugger.h"
+#include "coverage.h"
+#include "metrics.h"
+#include "perfcounters.h"
+
+/***************************** Globals ****************************************/
+
+/* Every way a program can be run; the first is what the rest must match */
+static const struct {
+    const char * name_p;
+    byte_t engine;
+    byte_t debug;
+    byte_t coverage;
+} variants[] = {
+    { "reference", ENGINE_REFERENCE, 0, 0 },
+    { "run_loop", ENGINE_RUN_LOOP, 0, 0 },
+    { "run_loop_debug", ENGINE_RUN_LOOP, 1, 0 },
+    { "run_loop_coverage", ENGINE_RUN_LOOP, 0, 1 },
+    { "predecoded", ENGINE_PREDECODED, 0, 0 }
+};
+#define NUM_VARIANTS ((int) (sizeof( variants ) / sizeof( *variants )))
+
+/************************** Private Types *************************************/
+
+/* Shared by the worker threads of one run_differential_tests() */
+struct diff_run_s {
+    const diff_program_t * corpus_p;
+    uint64_t num_corpus;
+    uint64_t num_programs;
+    uint32_t seed;
+    /* Next program to test, claimed atomically */
+    uint64_t next;
+    uint64_t mismatches;
+    uint64_t failures;
+    /* Simulated instructions over every run, for the host counters */
+    uint64_t instructions;
+    /* Holds the corpus and each worker's instance; workers allocate from it
+       under report_lock */
+    arena_t * arena_p;
+    /* Keeps reports from interleaving */
+    pthread_mutex_t report_lock;
+} typedef diff_run_t;
+
+/*******************************************************************************
+ *                          Program Functions
+ ******************************************************************************/
+
+/// @brief Makes a random program; any word is a valid instruction, but BLT
+/// targets are kept even and PRT/RDD ports mapped, since an odd target or
+/// an unmapped port only stops every engine with the same error message.
+/// Lengths include odd byte counts, as a truncated file would load
+/// @param seed the seed; the same seed gives the same program and input
+/// @param out_program_p the program
+void generate_diff_program(uint32_t seed, diff_program_t * out_program_p)
+{
+    uint32_t state = xorshift_seed( seed );
+    uint16_t instr;
+    byte_t port;
+
+    memset( out_program_p, 0, sizeof( *out_program_p ) );
+    out_program_p->seed = seed;
+    out_program_p->loaded_mem_slots =
+        (byte_t) (1 + next_xorshift( &state ) % MEM_BYTE_SIZE);
+    for (byte_t i = 0; i < out_program_p->loaded_mem_slots; i += WORD_SIZE)
+    {
+        instr = (uint16_t) next_xorshift( &state );
+        if ((instr >> 13) == 0b111)
+        {
+            instr &= (uint16_t) ~1u;
+        }
+        /* PRT/RDD on an unmapped port go to the console instead */
+        port = (instr >> 1) & 0xFF;
+        if (((instr >> 13) == 0b101 || (instr >> 13) == 0b110)
+            && port != CONSOLE_PORT 
+            && (port < TIMER_PORT || port > RANDOM_PORT))
+        {
+            instr &= (uint16_t) ~(0xFF << 1);
+        }
+        out_program_p->mem[ i ] = (byte_t) (instr >> 8);
+        if (i + 1 < out_program_p->loaded_mem_slots)
+        {
+            out_program_p->mem[ i + 1 ] = (byte_t) instr;
+        }
+    }
+    snprintf( out_program_p->name, MAX_DIFF_NAME_LEN, "random:%u", seed );
+}
+
+/// @brief Sets up an instance: a microputer in the arena, and a bus with a
+/// capture device for the console and the timer and a random source at
+/// their default ports
+/// @param out_instance_p the instance
+/// @param arena_p the arena the microputer goes in
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_diff_instance(diff_instance_t * out_instance_p, arena_t * arena_p)
+{
+    device_t * dev_p = NULL;
+
+    memset( out_instance_p, 0, sizeof( *out_instance_p ) );
+    out_instance_p->mp_p = (microputer_t *) arena_alloc( arena_p,
+        sizeof( microputer_t ) );
+    if (out_instance_p->mp_p == NULL
+        || init_microputer( out_instance_p->mp_p ) != SUCCESS
+        || create_io_bus( &out_instance_p->bus_p ) != SUCCESS
+        || create_capture_device( &dev_p, 0 ) != SUCCESS)
+    {
+        goto FUNC_ERROR;
+    }
+    out_instance_p->capture_p = (capture_t *) dev_p->state_p;
+    if (attach_device( out_instance_p->bus_p, dev_p, CONSOLE_PORT ) != SUCCESS
+        || create_timer_device( &dev_p ) != SUCCESS
+        || attach_device( out_instance_p->bus_p, dev_p, TIMER_PORT ) != SUCCESS
+        || create_random_device( &dev_p, 0 ) != SUCCESS)
+    {
+        delete_device( &dev_p );
+        goto FUNC_ERROR;
+    }
+    out_instance_p->random_state_p = (uint32_t *) dev_p->state_p;
+    if (attach_device( out_instance_p->bus_p, dev_p, RANDOM_PORT ) != SUCCESS)
+    {
+        delete_device( &dev_p );
+        goto FUNC_ERROR;
+    }
+    create_instruction_set( out_instance_p->mp_p );
+    out_instance_p->mp_p->bus_p = out_instance_p->bus_p;
+    return SUCCESS;
+
+    FUNC_ERROR:
+    delete_diff_instance( out_instance_p );
+    return ERROR;
+}
+
+/// @brief Frees an instance's bus and devices; its microputer goes with the
+/// arena
+/// @param instance_p the instance
+void delete_diff_instance(diff_instance_t * instance_p)
+{
+    if (instance_p->bus_p != NULL)
+    {
+        delete_io_bus( &instance_p->bus_p );
+    }
+    memset( instance_p, 0, sizeof( *instance_p ) );
+}
+
+/// @brief Runs a program for DIFF_BUDGET instructions on one variant, on an
+/// instance reset to how create_diff_instance left it, with the console
+/// input and random source seeded by the program
+/// @param instance_p the instance
+/// @param program_p the program
+/// @param variant index of the variant
+/// @param out_outcome_p how it ended; output_p is the caller's to free
+/// @return 1 if SUCCESS, otherwise ERROR (if the run could not be set up)
+int run_diff_program(diff_instance_t * instance_p,
+    const diff_program_t * program_p, int variant,
+    diff_outcome_t * out_outcome_p)
+{
+    microputer_t * mp_p = instance_p->mp_p;
+    capture_t * capture_p = instance_p->capture_p;
+    debugger_t * dbg_p = NULL;
+    coverage_t * cov_p = NULL;
+    int result = SUCCESS;
+
+    memset( out_outcome_p, 0, sizeof( *out_outcome_p ) );
+    if ((variants[ variant ].debug && create_debugger( &dbg_p ) != SUCCESS)
+        || (variants[ variant ].coverage
+            && create_coverage( &cov_p ) != SUCCESS))
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+
+    /* The same seeds create_capture_device and create_random_device use */
+    capture_p->output_len = 0;
+    capture_p->input_state = xorshift_seed( program_p->seed );
+    *instance_p->random_state_p = capture_p->input_state;
+    reset_microputer( mp_p );
+    memcpy( mp_p->mem, program_p->mem, MEM_BYTE_SIZE );
+    mp_p->loaded_mem_slots = program_p->loaded_mem_slots;
+    mp_p->debugger_p = dbg_p;
+    mp_p->coverage_p = cov_p;
+
+    out_outcome_p->result = run_engine( mp_p, variants[ variant ].engine,
+        DIFF_BUDGET );
+    memcpy( out_outcome_p->reg, mp_p->reg, NUM_REGISTERS );
+    out_outcome_p->pc = mp_p->pc;
+    out_outcome_p->cycles = mp_p->cycles;
+    out_outcome_p->halted = mp_p->halted;
+    out_outcome_p->output_len = capture_p->output_len;
+    /* The outcome takes the buffer; the next run starts a new one */
+    out_outcome_p->output_p = capture_p->output_p;
+    capture_p->output_p = NULL;
+    capture_p->output_capacity = 0;
+    mp_p->debugger_p = NULL;
+    mp_p->coverage_p = NULL;
+
+    FUNC_EXIT:
+    if (cov_p != NULL)
+    {
+        delete_coverage( &cov_p );
+    }
+    if (dbg_p != NULL)
+    {
+        delete_debugger( &dbg_p );
+    }
+    return result;
+}
+
+/// @brief Names the first thing two outcomes differ in
+/// @param a_p the reference outcome
+/// @param b_p the other outcome
+/// @return the name, or NULL if they match
+static const char * diff_outcomes(const diff_outcome_t * a_p,
+    const diff_outcome_t * b_p)
+{
+    uint64_t kept = a_p->output_len < CAPTURE_MAX_OUTPUT ?
+        a_p->output_len : CAPTURE_MAX_OUTPUT;
+
+    if (a_p->result != b_p->result) return "result";
+    if (memcmp( a_p->reg, b_p->reg, NUM_REGISTERS ) != 0) return "registers";
+    if (a_p->pc != b_p->pc) return "pc";
+    if (a_p->cycles != b_p->cycles) return "cycles";
+    if (a_p->halted != b_p->halted) return "halted";
+    if (a_p->output_len != b_p->output_len) return "output length";
+    if (kept > 0 && memcmp( a_p->output_p, b_p->output_p, kept ) != 0)
+    {
+        return "output";
+    }
+    return NULL;
+}
+
+/// @brief Prints a mismatch and the program that caused it
+/// @param run_p the run
+/// @param program_p the program
+/// @param variant the variant that disagreed with the reference
+/// @param what_p what differed
+/// @param a_p the reference outcome
+/// @param b_p the variant's outcome
+static void report_mismatch(diff_run_t * run_p,
+    const diff_program_t * program_p, int variant, const char * what_p,
+    const diff_outcome_t * a_p, const diff_outcome_t * b_p)
+{
+    pthread_mutex_lock( &run_p->report_lock );
+    if (++run_p->mismatches <= DIFF_MAX_REPORTS)
+    {
+        printf( "\t# [MISMATCH: %s on %s differs in %s] #\n",
+            variants[ variant ].name_p, program_p->name, what_p );
+        printf( "\t  %s: pc %hu, cycles %llu, R0-R3 %hu %hu %hu %hu\n",
+            variants[ 0 ].name_p, a_p->pc, (unsigned long long) a_p->cycles,
+            (uint16_t) a_p->reg[ 0 ], (uint16_t) a_p->reg[ 1 ],
+            (uint16_t) a_p->reg[ 2 ], (uint16_t) a_p->reg[ 3 ] );
+        printf( "\t  %s: pc %hu, cycles %llu, R0-R3 %hu %hu %hu %hu\n",
+            variants[ variant ].name_p, b_p->pc,
+            (unsigned long long) b_p->cycles,
+            (uint16_t) b_p->reg[ 0 ], (uint16_t) b_p->reg[ 1 ],
+            (uint16_t) b_p->reg[ 2 ], (uint16_t) b_p->reg[ 3 ] );
+        printf( "\t  program (%hu bytes):",
+            (uint16_t) program_p->loaded_mem_slots );
+        for (byte_t i = 0; i < program_p->loaded_mem_slots; i++)
+        {
+            printf( "%s%02X", i % WORD_SIZE ? "" : " ", program_p->mem[ i ] );
+        }
+        printf( "\n" );
+    }
+    pthread_mutex_unlock( &run_p->report_lock );
+}
+
+/*******************************************************************************
+ *                          Runner Functions
+ ******************************************************************************/
+
+/// @brief Worker thread; tests programs until none are left, on one
+/// instance it takes from the run's arena
+/// @param arg_p the run
+/// @return NULL
+static void * diff_worker(void * arg_p)
+{
+    diff_run_t * run_p = (diff_run_t *) arg_p;
+    diff_instance_t instance;
+    diff_program_t program;
+    diff_outcome_t outcomes[ NUM_VARIANTS ];
+    const char * what_p;
+    uint64_t instructions = 0;
+    uint64_t i;
+    int created;
+
+    pthread_mutex_lock( &run_p->report_lock );
+    created = create_diff_instance( &instance, run_p->arena_p );
+    pthread_mutex_unlock( &run_p->report_lock );
+    if (created != SUCCESS)
+    {
+        __atomic_fetch_add( &run_p->failures, 1, __ATOMIC_RELAXED );
+        return NULL;
+    }
+
+    while ((i = __atomic_fetch_add( &run_p->next, 1, __ATOMIC_RELAXED ))
+        < run_p->num_programs)
+    {
+        if (i < run_p->num_corpus)
+        {
+            program = run_p->corpus_p[ i ];
+        } else
+        {
+            generate_diff_program( run_p->seed + (uint32_t) i, &program );
+        }
+
+        for (int v = 0; v < NUM_VARIANTS; v++)
+        {
+            if (run_diff_program( &instance, &program, v, &outcomes[ v ] )
+                != SUCCESS)
+            {
+                __atomic_fetch_add( &run_p->failures, 1, __ATOMIC_RELAXED );
+            }
+            instructions += outcomes[ v ].cycles;
+        }
+        for (int v = 1; v < NUM_VARIANTS; v++)
+        {
+            what_p = diff_outcomes( &outcomes[ 0 ], &outcomes[ v ] );
+            if (what_p != NULL)
+            {
+                report_mismatch( run_p, &program, v, what_p, &outcomes[ 0 ],
+                    &outcomes[ v ] );
+            }
+        }
+        for (int v = 0; v < NUM_VARIANTS; v++)
+        {
+            free( outcomes[ v ].output_p );
+        }
+    }
+    __atomic_fetch_add( &run_p->instructions, instructions,
+        __ATOMIC_RELAXED );
+    delete_diff_instance( &instance );
+    return NULL;
+}
+
+/// @brief Runs every corpus file and num_random random programs on every
+/// engine, on num_threads threads, and reports any disagreement with the
+/// reference interpreter. The corpus and the workers' instances share one
+/// arena, on huge pages if asked
+/// @param bin_files_pp the corpus machine code files
+/// @param num_files the number of corpus files
+/// @param num_random the number of random programs
+/// @param seed the seed of the first random program (the rest follow it)
+/// @param num_threads worker threads (1 to DIFF_MAX_THREADS)
+/// @param huge_pages 1 = back the arena with huge pages
+/// @param host_counters 1 = report host counters over the whole test
+/// @return 1 if SUCCESS (every engine agreed), otherwise ERROR
+int run_differential_tests(char ** bin_files_pp, int num_files,
+    uint64_t num_random, uint32_t seed, int num_threads, byte_t huge_pages,
+    byte_t host_counters)
+{
+    diff_run_t run;
+    diff_program_t * corpus_p = NULL;
+    microputer_t * mp_p = NULL;
+    perf_counters_t counters;
+    pthread_t threads[ DIFF_MAX_THREADS ];
+    int num_started = 0;
+    uint64_t start_ns;
+    double seconds;
+    int result = SUCCESS;
+
+    memset( &run, 0, sizeof( run ) );
+    pthread_mutex_init( &run.report_lock, NULL );
+    if (num_threads < 1 || num_threads > DIFF_MAX_THREADS)
+    {
+        num_threads = num_threads < 1 ? 1 : DIFF_MAX_THREADS;
+    }
+    if (create_arena( &run.arena_p, (size_t) (num_files ? num_files : 1)
+        * sizeof( diff_program_t ) + (size_t) num_threads
+        * (sizeof( microputer_t ) + ARENA_ALIGN), huge_pages ) != SUCCESS)
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+
+    /* The corpus is loaded up front, so workers never touch files */
+    corpus_p = (diff_program_t *) arena_alloc( run.arena_p,
+        (size_t) (num_files ? num_files : 1) * sizeof( diff_program_t ) );
+    if (corpus_p == NULL || create_microputer( &mp_p ) != SUCCESS)
+    {
+        printf( "\t# [ERROR: allocating the differential test corpus] #\n" );
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    for (int i = 0; i < num_files; i++)
+    {
+        if (load_micro_program( mp_p, bin_files_pp[ i ] ) != SUCCESS)
+        {
+            result = ERROR;
+            goto FUNC_EXIT;
+        }
+        memcpy( corpus_p[ i ].mem, mp_p->mem, MEM_BYTE_SIZE );
+        corpus_p[ i ].loaded_mem_slots = mp_p->loaded_mem_slots;
+        corpus_p[ i ].seed = seed + (uint32_t) i;
+        snprintf( corpus_p[ i ].name, MAX_DIFF_NAME_LEN, "%s",
+            bin_files_pp[ i ] );
+    }
+    run.corpus_p = corpus_p;
+    run.num_corpus = (uint64_t) num_files;
+    run.num_programs = (uint64_t) num_files + num_random;
+    run.seed = seed;
+
+    if (host_counters)
+    {
+        host_counters = open_perf_counters( &counters ) == SUCCESS;
+    }
+    if (host_counters)
+    {
+        start_perf_counters( &counters );
+    }
+    start_ns = metrics_now_ns();
+    for (; num_started < num_threads; num_started++)
+    {
+        if (pthread_create( &threads[ num_started ], NULL, diff_worker,
+            &run ) != 0)
+        {
+            break;
+        }
+    }
+    /* With no threads at all the caller's thread does the work */
+    if (num_started == 0)
+    {
+        diff_worker( &run );
+    }
+    for (int i = 0; i < num_started; i++)
+    {
+        pthread_join( threads[ i ], NULL );
+    }
+    seconds = (metrics_now_ns() - start_ns) / 1e9;
+    if (host_counters)
+    {
+        stop_perf_counters( &counters );
+    }
+
+    printf( "\nDifferential test: %llu programs x %d engines, %llu "
+        "mismatches, %llu failed runs (%.0f programs/s)\n",
+        (unsigned long long) run.num_programs, NUM_VARIANTS,
+        (unsigned long long) run.mismatches,
+        (unsigned long long) run.failures,
+        seconds > 0 ? run.num_programs / seconds : 0.0 );
+    print_arena_report( run.arena_p, "corpus and instances" );
+    if (host_counters)
+    {
+        print_perf_counters( &counters, "differential test",
+            run.instructions );
+        close_perf_counters( &counters );
+    }
+    if (run.mismatches > 0 || run.failures > 0)
+    {
+        result = ERROR;
+    }
+
+    FUNC_EXIT:
+    if (mp_p != NULL)
+    {
+        delete_microputer( &mp_p );
+    }
+    if (run.arena_p != NULL)
+    {
+        delete_arena( &run.arena_p );
+    }
+    pthread_mutex_destroy( &run.report_lock );
+    return result;
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for differential testing of the execution engines
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef DIFFTEST_H
+#define DIFFTEST_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+#include "devices.h"
+#include "arena.h"
+
+/**************************** Constants ***************************************/
+
+/* Instructions each engine runs a program for (random programs need not
+   halt, so every engine is stopped at the same point) */
+#define DIFF_BUDGET 65536
+#define DIFF_MAX_THREADS 16
+/* Mismatches printed in full; the rest are only counted */
+#define DIFF_MAX_REPORTS 10
+#define MAX_DIFF_NAME_LEN 64
+
+/********************* Differential Structs & Types ***************************/
+
+/* A program every engine runs, and the seed of its input */
+struct diff_program_s {
+    byte_t mem[ MEM_BYTE_SIZE ];
+    byte_t loaded_mem_slots;
+    uint32_t seed;
+    char name[ MAX_DIFF_NAME_LEN ];
+} typedef diff_program_t;
+
+/* Everything an engine's run is compared on */
+struct diff_outcome_s {
+    int result;
+    byte_t reg[ NUM_REGISTERS ];
+    uint16_t pc;
+    uint64_t cycles;
+    byte_t halted;
+    /* Console output; output_len counts bytes past what was kept too */
+    char * output_p;
+    uint64_t output_len;
+} typedef diff_outcome_t;
+
+/* A microputer and its bus, set up once and reset before each run */
+struct diff_instance_s {
+    microputer_t * mp_p;
+    io_bus_t * bus_p;
+    capture_t * capture_p;
+    uint32_t * random_state_p;
+} typedef diff_instance_t;
+
+/********************** Public Differential Functions *************************/
+
+int create_diff_instance(diff_instance_t * out_instance_p, arena_t * arena_p);
+void delete_diff_instance(diff_instance_t * instance_p);
+void generate_diff_program(uint32_t seed, diff_program_t * out_program_p);
+int run_diff_program(diff_instance_t * instance_p,
+    const diff_program_t * program_p, int variant,
+    diff_outcome_t * out_outcome_p);
+int run_differential_tests(char ** bin_files_pp, int num_files,
+    uint64_t num_random, uint32_t seed, int num_threads, byte_t huge_pages,
+    byte_t host_counters);
+
+#endif
@@ -0,0 +1,587 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Lets gdb attach to a simulation over the GDB remote serial protocol
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "gdbstub.h"
+#include "debugger.h"
+
+/**************************** Constants ***************************************/
+
+/* Read by gdb through qXfer:features:read; r0-r15 then pc, as in 'g' */
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.microputer.core\">"
+    "<reg name=\"r0\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>"
+    "<reg name=\"r1\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r2\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r3\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r4\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r5\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r6\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r7\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r8\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r9\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r10\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r11\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r12\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r13\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r14\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"r15\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "</feature>"
+    "</target>";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/*******************************************************************************
+ *                          Packet Functions
+ ******************************************************************************/
+
+/// @brief Value of a hex digit
+/// @param c the character
+/// @return 0-15, or -1 if c is not a hex digit
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/// @brief Parses a hex number, advancing the string pointer past it
+/// @param str_pp a pointer to the string pointer
+/// @return the number, or ULONG_MAX if it does not fit
+static unsigned long parse_hex(const char ** str_pp)
+{
+    unsigned long value = 0;
+    while (hex_value( **str_pp ) >= 0)
+    {
+        /* Saturates, so too many digits can not wrap into a small number */
+        value = value > (ULONG_MAX >> 4) ? ULONG_MAX 
+            : (value << 4) | (unsigned long) hex_value( **str_pp );
+        (*str_pp)++;
+    }
+    return value;
+}
+
+/// @brief Whether an address can be the pc: word aligned and in memory
+/// @param addr the address
+/// @return 1 if it can, otherwise 0
+static int is_pc_address(unsigned long addr)
+{
+    return addr % WORD_SIZE == 0 && addr < MEM_BYTE_SIZE;
+}
+
+/// @brief Writes a byte as two hex digits
+/// @param value the byte
+/// @param out_p where to write them
+static void put_hex_byte(byte_t value, char * out_p)
+{
+    out_p[ 0 ] = hex_digits[ value >> 4 ];
+    out_p[ 1 ] = hex_digits[ value & 0xF ];
+}
+
+/// @brief Sends a packet and waits for gdb to acknowledge it
+/// @param fd the connection
+/// @param data_p the packet contents
+/// @return 1 if SUCCESS, otherwise ERROR
+static int put_packet(int fd, const char * data_p)
+{
+    char frame[ GDB_MAX_PACKET + 4 ];
+    size_t len = strlen( data_p );
+    byte_t sum = 0;
+    char ack = 0;
+
+    frame[ 0 ] = '$';
+    for (size_t i = 0; i < len; i++)
+    {
+        frame[ 1 + i ] = data_p[ i ];
+        sum += (byte_t) data_p[ i ];
+    }
+    frame[ 1 + len ] = '#';
+    put_hex_byte( sum, &frame[ 2 + len ] );
+
+    do
+    {
+        if (write( fd, frame, len + 4 ) != (ssize_t) (len + 4) 
+            || read( fd, &ack, 1 ) != 1)
+        {
+            return ERROR;
+        }
+    } while (ack == '-');
+    return SUCCESS;
+}
+
+/// @brief Receives a packet (acknowledging it), or a lone ^C
+/// @param fd the connection
+/// @param out_data_p buffer of GDB_MAX_PACKET chars for the contents
+/// @return 1 if SUCCESS, otherwise ERROR (connection closed)
+static int get_packet(int fd, char * out_data_p)
+{
+    char c = 0;
+    char check[ 2 ];
+    size_t len = 0;
+    byte_t sum = 0;
+
+    for (;;)
+    {
+        /* Skip to the start of a packet; a ^C outside one is a break */
+        do
+        {
+            if (read( fd, &c, 1 ) != 1)
+            {
+                return ERROR;
+            }
+            if (c == 0x03)
+            {
+                strcpy( out_data_p, "\x03" );
+                return SUCCESS;
+            }
+        } while (c != '$');
+
+        len = 0;
+        sum = 0;
+        while (read( fd, &c, 1 ) == 1 && c != '#')
+        {
+            if (len < GDB_MAX_PACKET - 1)
+            {
+                out_data_p[ len++ ] = c;
+            }
+            sum += (byte_t) c;
+        }
+        out_data_p[ len ] = '\0';
+        if (c != '#' || read( fd, check, 2 ) != 2)
+        {
+            return ERROR;
+        }
+        if (hex_value( check[ 0 ] ) * 16 + hex_value( check[ 1 ] ) == sum)
+        {
+            return write( fd, "+", 1 ) == 1 ? SUCCESS : ERROR;
+        }
+        if (write( fd, "-", 1 ) != 1)
+        {
+            return ERROR;
+        }
+    }
+}
+
+/*******************************************************************************
+ *                          Command Functions
+ ******************************************************************************/
+
+/// @brief Formats the stop reply for the microputer's state
+/// @param mp_p microputer pointer
+/// @param result the result of the last run
+/// @param out_reply_p the reply
+static void stop_reply(microputer_t * mp_p, int result, char * out_reply_p)
+{
+    if (result != SUCCESS)
+    {
+        strcpy( out_reply_p, "S04" );          // SIGILL: a handler failed
+    } else if (mp_p->halted)
+    {
+        strcpy( out_reply_p, "W00" );          // the program ran off its end
+    } else 
+    {
+        strcpy( out_reply_p, "S05" );          // SIGTRAP
+    }
+}
+
+/// @brief Continues until a breakpoint/watchpoint, the end of the program,
+/// or a ^C from gdb; the fast debug engine runs between checks
+/// @param fd the connection
+/// @param mp_p microputer pointer
+/// @param out_reply_p the stop reply
+static void continue_program(int fd, microputer_t * mp_p, char * out_reply_p)
+{
+    debugger_t * dbg_p = mp_p->debugger_p;
+    struct pollfd poll_fd = { fd, POLLIN, 0 };
+    int result = SUCCESS;
+    char c = 0;
+
+    /* gdb resumes from a breakpoint by continuing from it */
+    dbg_p->resume_over = 1;
+    for (;;)
+    {
+        result = run_micro_program( mp_p, GDB_CONTINUE_CHUNK );
+        if (result != SUCCESS || mp_p->halted 
+            || dbg_p->stop_reason != STOP_NONE)
+        {
+            break;
+        }
+        if (poll( &poll_fd, 1, 0 ) > 0 && read( fd, &c, 1 ) == 1 && c == 0x03)
+        {
+            strcpy( out_reply_p, "S02" );      // SIGINT
+            return;
+        }
+    }
+    stop_reply( mp_p, result, out_reply_p );
+}
+
+/// @brief Handles one packet from gdb
+/// @param fd the connection
+/// @param mp_p microputer pointer (with a debugger attached)
+/// @param packet_p the packet contents
+/// @param out_reply_p the reply; an empty reply means "not supported"
+/// @return 1 if the session should end, otherwise 0
+static int handle_packet(int fd, microputer_t * mp_p, const char * packet_p,
+    char * out_reply_p)
+{
+    debugger_t * dbg_p = mp_p->debugger_p;
+    const char * args_p = packet_p + 1;
+    unsigned long addr = 0;
+    unsigned long len = 0;
+    int result = SUCCESS;
+
+    out_reply_p[ 0 ] = '\0';
+    switch (packet_p[ 0 ])
+    {
+        case '\x03':
+        case '?':
+            stop_reply( mp_p, SUCCESS, out_reply_p );
+            break;
+
+        case 'g':
+            for (byte_t i = 0; i < NUM_REGISTERS; i++)
+            {
+                put_hex_byte( mp_p->reg[ i ], &out_reply_p[ i * 2 ] );
+            }
+            /* gdb expects target byte order; the pc is sent little endian */
+            put_hex_byte( (byte_t) mp_p->pc, &out_reply_p[ 32 ] );
+            put_hex_byte( (byte_t) (mp_p->pc >> 8), &out_reply_p[ 34 ] );
+            out_reply_p[ 36 ] = '\0';
+            break;
+
+        case 'G':
+            if (strlen( args_p ) < 36)
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            addr = (unsigned long) (hex_value( args_p[ 32 ] ) * 16 
+                + hex_value( args_p[ 33 ] ) + (hex_value( args_p[ 34 ] ) * 16
+                + hex_value( args_p[ 35 ] )) * 256);
+            /* Nothing is written unless all of it is valid */
+            if (!is_pc_address( addr ))
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            for (byte_t i = 0; i < NUM_REGISTERS; i++)
+            {
+                mp_p->reg[ i ] = (byte_t) (hex_value( args_p[ i * 2 ] ) * 16
+                    + hex_value( args_p[ i * 2 + 1 ] ));
+            }
+            mp_p->pc = (uint16_t) addr;
+            strcpy( out_reply_p, "OK" );
+            break;
+
+        case 'p':
+            addr = parse_hex( &args_p );
+            if (addr < NUM_REGISTERS)
+            {
+                put_hex_byte( mp_p->reg[ addr ], out_reply_p );
+                out_reply_p[ 2 ] = '\0';
+            } else if (addr == NUM_REGISTERS)
+            {
+                put_hex_byte( (byte_t) mp_p->pc, out_reply_p );
+                put_hex_byte( (byte_t) (mp_p->pc >> 8), &out_reply_p[ 2 ] );
+                out_reply_p[ 4 ] = '\0';
+            } else 
+            {
+                strcpy( out_reply_p, "E01" );
+            }
+            break;
+
+        case 'P':
+            addr = parse_hex( &args_p );
+            if (*args_p++ != '=' || addr > NUM_REGISTERS)
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            len = parse_hex( &args_p );
+            if (addr < NUM_REGISTERS)
+            {
+                mp_p->reg[ addr ] = (byte_t) len;
+            } else 
+            {
+                /* Little endian, like 'g' */
+                len = len > UINT16_MAX ? ULONG_MAX 
+                    : ((len >> 8) & 0xFF) | ((len & 0xFF) << 8);
+                if (!is_pc_address( len ))
+                {
+                    strcpy( out_reply_p, "E01" );
+                    break;
+                }
+                mp_p->pc = (uint16_t) len;
+            }
+            strcpy( out_reply_p, "OK" );
+            break;
+
+        case 'm':
+            addr = parse_hex( &args_p );
+            args_p++;
+            len = parse_hex( &args_p );
+            /* Written so that no sum can wrap around */
+            if (addr >= MEM_BYTE_SIZE || len > MEM_BYTE_SIZE - addr 
+                || len * 2 >= GDB_MAX_PACKET)
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            for (unsigned long i = 0; i < len; i++)
+            {
+                put_hex_byte( mp_p->mem_p[ addr + i ], &out_reply_p[ i * 2 ] );
+            }
+            out_reply_p[ len * 2 ] = '\0';
+            break;
+
+        case 'M':
+            addr = parse_hex( &args_p );
+            args_p++;
+            len = parse_hex( &args_p );
+            if (*args_p++ != ':' || addr >= MEM_BYTE_SIZE 
+                || len > MEM_BYTE_SIZE - addr || strlen( args_p ) < len * 2)
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            for (unsigned long i = 0; i < len; i++)
+            {
+                mp_p->mem_p[ addr + i ] = (byte_t) (hex_value( args_p[ i * 2 ] )
+                    * 16 + hex_value( args_p[ i * 2 + 1 ] ));
+            }
+            strcpy( out_reply_p, "OK" );
+            break;
+
+        case 'c':
+            if (*args_p)
+            {
+                addr = parse_hex( &args_p );
+                if (!is_pc_address( addr ))
+                {
+                    strcpy( out_reply_p, "E01" );
+                    break;
+                }
+                mp_p->pc = (uint16_t) addr;
+            }
+            continue_program( fd, mp_p, out_reply_p );
+            break;
+
+        case 's':
+            if (*args_p)
+            {
+                addr = parse_hex( &args_p );
+                if (!is_pc_address( addr ))
+                {
+                    strcpy( out_reply_p, "E01" );
+                    break;
+                }
+                mp_p->pc = (uint16_t) addr;
+            }
+            dbg_p->resume_over = 1;
+            result = run_micro_program( mp_p, 1 );
+            stop_reply( mp_p, result, out_reply_p );
+            break;
+
+        case 'Z':
+        case 'z':
+            /* Only software breakpoints (type 0) and hardware ones (type 1) */
+            if (args_p[ 0 ] != '0' && args_p[ 0 ] != '1')
+            {
+                break;
+            }
+            args_p += 2;
+            addr = parse_hex( &args_p );
+            /* set_breakpoint takes 16 bits, so larger ones would wrap */
+            if (addr > UINT16_MAX)
+            {
+                strcpy( out_reply_p, "E01" );
+                break;
+            }
+            result = packet_p[ 0 ] == 'Z' 
+                ? set_breakpoint( dbg_p, (uint16_t) addr ) 
+                : clear_breakpoint( dbg_p, (uint16_t) addr );
+            strcpy( out_reply_p, result == SUCCESS ? "OK" : "E01" );
+            break;
+
+        case 'H':
+            strcpy( out_reply_p, "OK" );
+            break;
+
+        case 'k':
+            /* Killed: nothing more of the program runs */
+            mp_p->halted = 1;
+            return 1;
+
+        case 'D':
+            strcpy( out_reply_p, "OK" );
+            return 1;
+
+        case 'q':
+            if (strncmp( packet_p, "qSupported", 10 ) == 0)
+            {
+                snprintf( out_reply_p, GDB_MAX_PACKET, 
+                    "PacketSize=%x;qXfer:features:read+", GDB_MAX_PACKET );
+            } else if (strncmp( packet_p, "qXfer:features:read:target.xml:", 
+                31 ) == 0)
+            {
+                args_p = packet_p + 31;
+                addr = parse_hex( &args_p );
+                args_p++;
+                len = parse_hex( &args_p );
+                if (len > GDB_MAX_PACKET - 2)
+                {
+                    len = GDB_MAX_PACKET - 2;
+                }
+                if (addr >= sizeof( target_xml ) - 1)
+                {
+                    strcpy( out_reply_p, "l" );
+                    break;
+                }
+                if (addr + len > sizeof( target_xml ) - 1)
+                {
+                    len = sizeof( target_xml ) - 1 - addr;
+                }
+                out_reply_p[ 0 ] = 
+                    addr + len >= sizeof( target_xml ) - 1 ? 'l' : 'm';
+                memcpy( out_reply_p + 1, target_xml + addr, len );
+                out_reply_p[ len + 1 ] = '\0';
+            } else if (strcmp( packet_p, "qAttached" ) == 0)
+            {
+                strcpy( out_reply_p, "1" );
+            } else if (strcmp( packet_p, "qC" ) == 0)
+            {
+                strcpy( out_reply_p, "QC1" );
+            } else if (strcmp( packet_p, "qfThreadInfo" ) == 0)
+            {
+                strcpy( out_reply_p, "m1" );
+            } else if (strcmp( packet_p, "qsThreadInfo" ) == 0)
+            {
+                strcpy( out_reply_p, "l" );
+            }
+            break;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ *                          Connection Functions
+ ******************************************************************************/
+
+/// @brief Listens on a localhost TCP port (address is a number) or a Unix
+/// socket (anything else) and accepts one connection
+/// @param address_p the port number or socket path
+/// @return the connection, or -1
+static int accept_gdb(const char * address_p)
+{
+    int listen_fd = -1;
+    int fd = -1;
+    int one = 1;
+    char * end_p = NULL;
+    long port = strtol( address_p, &end_p, 10 );
+
+    if (*end_p == '\0')
+    {
+        struct sockaddr_in addr;
+        memset( &addr, 0, sizeof( addr ) );
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons( (uint16_t) port );
+        addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        listen_fd = socket( AF_INET, SOCK_STREAM, 0 );
+        setsockopt( listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+        if (listen_fd < 0 
+            || bind( listen_fd, (struct sockaddr *) &addr, sizeof( addr ) ) != 0)
+        {
+            goto FUNC_EXIT;
+        }
+    } else 
+    {
+        struct sockaddr_un addr;
+        memset( &addr, 0, sizeof( addr ) );
+        addr.sun_family = AF_UNIX;
+        strncpy( addr.sun_path, address_p, sizeof( addr.sun_path ) - 1 );
+        unlink( address_p );
+        listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+        if (listen_fd < 0 
+            || bind( listen_fd, (struct sockaddr *) &addr, sizeof( addr ) ) != 0)
+        {
+            goto FUNC_EXIT;
+        }
+    }
+
+    if (listen( listen_fd, 1 ) == 0)
+    {
+        printf( "Waiting for gdb on '%s'...\n", address_p );
+        fflush( stdout );
+        fd = accept( listen_fd, NULL, NULL );
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+    }
+
+    FUNC_EXIT:
+    if (listen_fd >= 0)
+    {
+        close( listen_fd );
+    }
+    return fd;
+}
+
+/// @brief Waits for gdb to attach and serves it until it detaches, kills 
+/// the program (which marks it halted) or the program ends
+/// @param mp_p microputer pointer, with the program loaded
+/// @param address_p localhost TCP port number, or Unix socket path
+/// @return 1 if SUCCESS, otherwise ERROR
+int serve_gdb(microputer_t * mp_p, const char * address_p)
+{
+    char packet[ GDB_MAX_PACKET ];
+    char reply[ GDB_MAX_PACKET ];
+    debugger_t * dbg_p = NULL;
+    int fd = accept_gdb( address_p );
+    int done = 0;
+
+    if (fd < 0)
+    {
+        printf( "\t# [ERROR: could not accept gdb on '%s'] #\n", address_p );
+        return ERROR;
+    }
+    if (create_debugger( &dbg_p ) != SUCCESS)
+    {
+        close( fd );
+        return ERROR;
+    }
+    mp_p->debugger_p = dbg_p;
+
+    while (!done && get_packet( fd, packet ) == SUCCESS)
+    {
+        done = handle_packet( fd, mp_p, packet, reply );
+        if ((reply[ 0 ] != '\0' || !done) && put_packet( fd, reply ) != SUCCESS)
+        {
+            break;
+        }
+        /* Nothing more to debug once the program has exited */
+        done |= reply[ 0 ] == 'W';
+    }
+
+    mp_p->debugger_p = NULL;
+    delete_debugger( &dbg_p );
+    close( fd );
+    return SUCCESS;
+}
@@ -0,0 +1,24 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for the GDB remote serial protocol stub
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Instructions run between checks for a ^C from gdb while continuing */
+#define GDB_CONTINUE_CHUNK 65536
+#define GDB_MAX_PACKET 1024
+
+/*********************** Public GDB Stub Functions ****************************/
+
+int serve_gdb(microputer_t * mp_p, const char * address_p);
+
+#endif
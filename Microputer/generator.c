@@ -0,0 +1,393 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Generates random programs with a controllable instruction mix and loop
+/// nesting that are guaranteed to halt within a target instruction count,
+/// and writes them straight into a tar archive
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include "generator.h"
+#include "archive.h"
+#include "devices.h"
+
+/***************************** Macros *****************************************/
+
+/* Instruction encodings; PRT/RDD always use port 0 */
+#define ENC_LDI(r, imm) ((uint16_t) (((r) << 9) | (((imm) & 0xFF) << 1)))
+#define ENC_ALU(op, i, j, k) \
+    ((uint16_t) (((op) << 13) | ((i) << 9) | ((j) << 5) | ((k) << 1)))
+#define ENC_IO(op, r) ((uint16_t) (((op) << 13) | ((r) << 9)))
+#define ENC_BLT(i, j, addr) \
+    ((uint16_t) ((0b111 << 13) | ((i) << 9) | ((j) << 5) | (addr)))
+
+/**************************** Constants ***************************************/
+
+/* Longest manifest line: "prog_N.dat instructions\n" */
+#define GEN_MANIFEST_LINE_LEN 40
+
+/* The largest value of each parameter; a count is capped so its manifest
+   fits in a size_t */
+static const struct {
+    const char * key_p;
+    unsigned long long max;
+} gen_param_limits[] = {
+    { "count", (SIZE_MAX - 1) / GEN_MANIFEST_LINE_LEN },
+    { "len", MEM_WORD_COUNT },
+    { "alu", 100 },
+    { "prt", 100 },
+    { "rdd", 100 },
+    { "depth", MAX_LOOP_DEPTH },
+    { "max", UINT64_MAX },
+    { "seed", UINT32_MAX },
+};
+
+/*******************************************************************************
+ *                          Parameter Functions
+ ******************************************************************************/
+
+/// @brief Fills in the default mix: 100 full length programs, mostly ALU,
+/// loops two deep, each halting within 100000 instructions
+/// @param out_params_p the parameters
+void default_gen_params(gen_params_t * out_params_p)
+{
+    out_params_p->count = 100;
+    out_params_p->num_words = MEM_WORD_COUNT;
+    out_params_p->alu_percent = 60;
+    out_params_p->prt_percent = 10;
+    out_params_p->rdd_percent = 5;
+    out_params_p->loop_depth = 2;
+    out_params_p->max_instructions = 100000;
+    out_params_p->seed = 1;
+}
+
+/// @brief Overrides parameters from "key=value,..." (count, len, alu, prt,
+/// rdd, depth, max, seed)
+/// @param params_p the parameters
+/// @param spec_p the overrides
+/// @return 1 if SUCCESS, otherwise ERROR
+int parse_gen_params(gen_params_t * params_p, const char * spec_p)
+{
+    char key[ 16 ];
+    char digits[ 24 ];
+    unsigned long long value;
+    int used = 0;
+    size_t i;
+
+    while (*spec_p != '\0')
+    {
+        if (sscanf( spec_p, "%15[a-z]=%23[0-9]%n", key, digits, &used ) != 2)
+        {
+            printf( "\t# [ERROR: can not parse '%s'] #\n", spec_p );
+            return ERROR;
+        }
+        for (i = 0; i < sizeof( gen_param_limits ) 
+            / sizeof( gen_param_limits[ 0 ] ); i++)
+        {
+            if (strcmp( key, gen_param_limits[ i ].key_p ) == 0)
+            {
+                break;
+            }
+        }
+        if (i == sizeof( gen_param_limits ) / sizeof( gen_param_limits[ 0 ] ))
+        {
+            printf( "\t# [ERROR: unknown generator parameter '%s'] #\n", key );
+            return ERROR;
+        }
+        errno = 0;
+        value = strtoull( digits, NULL, 10 );
+        if (errno != 0 || value > gen_param_limits[ i ].max)
+        {
+            printf( "\t# [ERROR: %s needs a number from 0 to %llu] #\n", key,
+                gen_param_limits[ i ].max );
+            return ERROR;
+        }
+        if (strcmp( key, "count" ) == 0) params_p->count = value;
+        else if (strcmp( key, "len" ) == 0) params_p->num_words = 
+            (byte_t) value;
+        else if (strcmp( key, "alu" ) == 0) params_p->alu_percent =
+            (byte_t) value;
+        else if (strcmp( key, "prt" ) == 0) params_p->prt_percent =
+            (byte_t) value;
+        else if (strcmp( key, "rdd" ) == 0) params_p->rdd_percent =
+            (byte_t) value;
+        else if (strcmp( key, "depth" ) == 0) params_p->loop_depth =
+            (byte_t) value;
+        else if (strcmp( key, "max" ) == 0) params_p->max_instructions = value;
+        else params_p->seed = (uint32_t) value;
+        spec_p += used;
+        if (*spec_p == ',')
+        {
+            spec_p++;
+        }
+    }
+    if (params_p->num_words == 0 || params_p->max_instructions == 0)
+    {
+        printf( "\t# [ERROR: programs need at least one instruction] #\n" );
+        return ERROR;
+    }
+    if (params_p->alu_percent + params_p->prt_percent 
+        + params_p->rdd_percent > 100)
+    {
+        printf( "\t# [ERROR: alu, prt and rdd add up to more than 100] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Generator Functions
+ ******************************************************************************/
+
+/// @brief Makes one body instruction; bodies only write R0..R9, so they can
+/// never disturb the loop counters
+/// @param params_p the mix
+/// @param state_p the random state
+/// @return the instruction
+static uint16_t body_instruction(const gen_params_t * params_p,
+    uint32_t * state_p)
+{
+    uint32_t roll = next_xorshift( state_p ) % 100;
+    byte_t dest = (byte_t) (next_xorshift( state_p ) % GEN_BODY_REGS);
+    byte_t src_i = (byte_t) (next_xorshift( state_p ) % NUM_REGISTERS);
+    byte_t src_j = (byte_t) (next_xorshift( state_p ) % NUM_REGISTERS);
+
+    if (roll < params_p->alu_percent)
+    {
+        return ENC_ALU( 1 + next_xorshift( state_p ) % 4, src_i, src_j, dest );
+    }
+    roll -= params_p->alu_percent;
+    if (roll < params_p->prt_percent)
+    {
+        return ENC_IO( 0b101, src_i );
+    }
+    roll -= params_p->prt_percent;
+    if (roll < params_p->rdd_percent)
+    {
+        return ENC_IO( 0b110, dest );
+    }
+    return ENC_LDI( dest, next_xorshift( state_p ) );
+}
+
+/// @brief Generates a program. Loops are counted: loop L loads its counter
+/// with 256 - trips, and closes with ADD counter += 1 and BLT 0 < counter,
+/// so it runs exactly trips times. Trip counts are halved until the exact
+/// instruction count fits params_p->max_instructions
+/// @param params_p the mix
+/// @param seed the program's seed
+/// @param out_program_p the program
+void generate_program(const gen_params_t * params_p, uint32_t seed,
+    gen_program_t * out_program_p)
+{
+    uint32_t state = xorshift_seed( seed );
+    uint64_t max = params_p->max_instructions;
+    byte_t num_words = params_p->num_words;
+    byte_t depth = params_p->loop_depth;
+    /* Body segments: before loop 1, ..., inside loop depth, ..., after */
+    byte_t seg_len[ 2 * MAX_LOOP_DEPTH + 1 ] = { 0 };
+    byte_t trips[ MAX_LOOP_DEPTH + 1 ] = { 0 };
+    uint64_t mult[ MAX_LOOP_DEPTH + 1 ];
+    uint16_t words[ MEM_WORD_COUNT ];
+    byte_t top[ MAX_LOOP_DEPTH + 1 ];
+    byte_t num_segs;
+    byte_t body;
+    byte_t n = 0;
+    byte_t level;
+    uint64_t total;
+    int largest;
+
+    if (num_words > max)
+    {
+        num_words = (byte_t) max;
+    }
+    /* Each loop needs 3 words, plus 1 for the constant 1 */
+    while (depth > 0 && num_words < 1 + 3 * depth)
+    {
+        depth--;
+    }
+    body = num_words - (depth > 0 ? 1 + 3 * depth : 0);
+    num_segs = 2 * depth + 1;
+    if (depth > 0 && body > 0)
+    {
+        seg_len[ depth ] = 1;
+        body--;
+    }
+    while (body-- > 0)
+    {
+        seg_len[ next_xorshift( &state ) % num_segs ]++;
+    }
+
+    /* Trips that fit the budget; with every loop at 1 the program runs
+       num_words <= max instructions, so this always ends */
+    for (byte_t l = 1; l <= depth; l++)
+    {
+        trips[ l ] = (byte_t) (1 + next_xorshift( &state ) % 255);
+    }
+    do
+    {
+        mult[ 0 ] = 1;
+        total = depth > 0 ? 1 : 0;
+        for (byte_t l = 1; l <= depth; l++)
+        {
+            mult[ l ] = mult[ l - 1 ] * trips[ l ];
+            total += mult[ l - 1 ] + 2 * mult[ l ];
+        }
+        for (byte_t s = 0; s < num_segs; s++)
+        {
+            level = s <= depth ? s : num_segs - 1 - s;
+            total += seg_len[ s ] * mult[ level ];
+        }
+        largest = 0;
+        for (byte_t l = 1; l <= depth; l++)
+        {
+            if (trips[ l ] > 1 && (largest == 0
+                || trips[ l ] > trips[ largest ]))
+            {
+                largest = l;
+            }
+        }
+        if (total > max && largest > 0)
+        {
+            trips[ largest ] /= 2;
+        }
+    } while (total > max && largest > 0);
+
+    /* Lay the program out */
+    if (depth > 0)
+    {
+        words[ n++ ] = ENC_LDI( GEN_ONE_REG, 1 );
+    }
+    for (byte_t s = 0; s < num_segs; s++)
+    {
+        if (s > depth)
+        {
+            /* Closes loop num_segs - s before the segment after it */
+            level = num_segs - s;
+            words[ n++ ] = ENC_ALU( 0b001, GEN_ONE_REG,
+                GEN_COUNTER_REG + level - 1, GEN_COUNTER_REG + level - 1 );
+            words[ n++ ] = ENC_BLT( GEN_ZERO_REG, GEN_COUNTER_REG + level - 1,
+                top[ level ] );
+        } else if (s > 0)
+        {
+            words[ n++ ] = ENC_LDI( GEN_COUNTER_REG + s - 1, 256 - trips[ s ] );
+            top[ s ] = n * WORD_SIZE;
+        }
+        for (byte_t i = 0; i < seg_len[ s ]; i++)
+        {
+            words[ n++ ] = body_instruction( params_p, &state );
+        }
+    }
+
+    memset( out_program_p, 0, sizeof( *out_program_p ) );
+    for (byte_t i = 0; i < n; i++)
+    {
+        out_program_p->mem[ i * WORD_SIZE ] = (byte_t) (words[ i ] >> 8);
+        out_program_p->mem[ i * WORD_SIZE + 1 ] = (byte_t) words[ i ];
+    }
+    out_program_p->loaded_mem_slots = n * WORD_SIZE;
+    out_program_p->instructions = total;
+}
+
+/// @brief Generates params_p->count programs into a tar archive, as
+/// prog_NNNNNN.dat members followed by manifest.txt ("name instructions"
+/// per line). Each program is run once with no devices, to hold the
+/// generator to its promised instruction count
+/// @param params_p the mix
+/// @param archive_file_name_p the archive to write
+/// @return 1 if SUCCESS, otherwise ERROR
+int generate_program_archive(const gen_params_t * params_p,
+    const char * archive_file_name_p)
+{
+    archive_t * archive_p = NULL;
+    microputer_t * mp_p = NULL;
+    io_bus_t * null_bus_p = NULL;
+    gen_program_t program;
+    char name[ MAX_MEMBER_NAME_LEN ];
+    char * manifest_p = NULL;
+    size_t manifest_len = 0;
+    uint64_t total = 0;
+    int result = SUCCESS;
+
+    manifest_p = (char *) malloc( params_p->count * GEN_MANIFEST_LINE_LEN + 1 );
+    if (manifest_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate the manifest of %llu "
+            "programs] #\n", (unsigned long long) params_p->count );
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    if (create_microputer( &mp_p ) != SUCCESS
+        || create_null_io_bus( &null_bus_p ) != SUCCESS
+        || create_archive_writer( &archive_p, archive_file_name_p )
+            != SUCCESS)
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    create_instruction_set( mp_p );
+
+    for (uint64_t i = 0; i < params_p->count && result == SUCCESS; i++)
+    {
+        generate_program( params_p, params_p->seed + (uint32_t) i, &program );
+
+        memset( mp_p->reg, 0, NUM_REGISTERS );
+        memcpy( mp_p->mem, program.mem, MEM_BYTE_SIZE );
+        mp_p->loaded_mem_slots = program.loaded_mem_slots;
+        mp_p->pc = 0;
+        mp_p->cycles = 0;
+        mp_p->halted = 0;
+        mp_p->bus_p = null_bus_p;
+        if (run_engine( mp_p, ENGINE_PREDECODED, program.instructions + 1 )
+            != SUCCESS || !mp_p->halted
+            || mp_p->cycles != program.instructions)
+        {
+            printf( "\t# [ERROR: program %llu ran %llu instructions, not "
+                "%llu] #\n", (unsigned long long) i,
+                (unsigned long long) mp_p->cycles,
+                (unsigned long long) program.instructions );
+            result = ERROR;
+            break;
+        }
+
+        snprintf( name, sizeof( name ), "prog_%06llu.dat",
+            (unsigned long long) i );
+        result = write_archive_member( archive_p, name, program.mem,
+            program.loaded_mem_slots );
+        manifest_len += sprintf( manifest_p + manifest_len, "%s %llu\n",
+            name, (unsigned long long) program.instructions );
+        total += program.instructions;
+    }
+    if (result == SUCCESS)
+    {
+        result = write_archive_member( archive_p, "manifest.txt", manifest_p,
+            manifest_len );
+    }
+    if (result == SUCCESS)
+    {
+        printf( "Generated %llu programs (%llu instructions in all) into "
+            "'%s'\n", (unsigned long long) params_p->count,
+            (unsigned long long) total, archive_file_name_p );
+    }
+
+    FUNC_EXIT:
+    if (archive_p != NULL && delete_archive( &archive_p ) != SUCCESS)
+    {
+        result = ERROR;
+    }
+    if (null_bus_p != NULL)
+    {
+        delete_io_bus( &null_bus_p );
+    }
+    if (mp_p != NULL)
+    {
+        delete_microputer( &mp_p );
+    }
+    free( manifest_p );
+    return result;
+}
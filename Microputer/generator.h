@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for generating random programs that always terminate
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Loops nest at most this deep; each costs 3 words and a register */
+#define MAX_LOOP_DEPTH 3
+/* Registers the loop machinery owns; program bodies use the rest */
+#define GEN_ZERO_REG 13     // always 0
+#define GEN_ONE_REG 14      // always 1
+#define GEN_COUNTER_REG 10  // counters of loops 1..MAX_LOOP_DEPTH from here
+#define GEN_BODY_REGS 10    // R0..R9
+
+/********************** Generator Structs & Types *****************************/
+
+/* The mix of programs to generate */
+struct gen_params_s {
+    uint64_t count;
+    byte_t num_words;           // length, up to MEM_WORD_COUNT
+    byte_t alu_percent;         // ADD/AND/OR/XOR share of the body
+    byte_t prt_percent;         // PRT share of the body
+    byte_t rdd_percent;         // RDD share of the body (LDI fills the rest)
+    byte_t loop_depth;          // 0 to MAX_LOOP_DEPTH
+    uint64_t max_instructions;  // every program halts within this many
+    uint32_t seed;
+} typedef gen_params_t;
+
+/* A generated program */
+struct gen_program_s {
+    byte_t mem[ MEM_BYTE_SIZE ];
+    byte_t loaded_mem_slots;
+    /* Instructions it executes before halting, exactly */
+    uint64_t instructions;
+} typedef gen_program_t;
+
+/*********************** Public Generator Functions ***************************/
+
+void default_gen_params(gen_params_t * out_params_p);
+int parse_gen_params(gen_params_t * params_p, const char * spec_p);
+void generate_program(const gen_params_t * params_p, uint32_t seed,
+    gen_program_t * out_program_p);
+int generate_program_archive(const gen_params_t * params_p,
+    const char * archive_file_name_p);
+
+#endif
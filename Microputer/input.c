@@ -0,0 +1,330 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Bulk input files for RDD: large decimal text files are parsed 16 bytes at
+/// a time with SSE2, and binary files are mapped and read as they are
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "input.h"
+
+/***************************** Macros *****************************************/
+
+#define BLOCK_LEN 16
+/* Digit runs are read 8 bytes at a time, so up to this many bytes past the
+   start of a block are read */
+#define BLOCK_READ_LEN (BLOCK_LEN + 8)
+
+/************************** Private Types *************************************/
+
+/* Where parsing is between blocks */
+struct parse_state_s {
+    /* The number so far; only its low byte matters, so it may wrap */
+    uint32_t acc;
+    /* 1 = the last block ended inside a number, and its sign */
+    byte_t in_number;
+    byte_t negative;
+    /* 1 = the last block ended in a minus sign */
+    byte_t last_minus;
+    uint64_t count;
+} typedef parse_state_t;
+
+/**************************** Globals *****************************************/
+
+/* 10^n, wrapped to 32 bits like the numbers themselves */
+static const uint32_t powers_of_10[ BLOCK_LEN + 1 ] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u,
+    1000000000u, (uint32_t) 10000000000ull, (uint32_t) 100000000000ull,
+    (uint32_t) 1000000000000ull, (uint32_t) 10000000000000ull,
+    (uint32_t) 100000000000000ull, (uint32_t) 1000000000000000ull,
+    (uint32_t) 10000000000000000ull
+};
+
+/*******************************************************************************
+ *                          Parsing Functions
+ ******************************************************************************/
+
+#ifdef __SSE2__
+
+/// @brief Marks the digits and minus signs in a block, one bit per byte
+/// @param block_p the block
+/// @param out_minus_p the minus signs
+/// @return the digits
+static inline uint32_t classify_block(const char * block_p,
+    uint32_t * out_minus_p)
+{
+    __m128i bytes = _mm_loadu_si128( (const __m128i *) block_p );
+    /* Digits are the bytes that stay at most 9 after subtracting '0' */
+    __m128i values = _mm_sub_epi8( bytes, _mm_set1_epi8( '0' ) );
+    __m128i digits = _mm_cmpeq_epi8( _mm_min_epu8( values,
+        _mm_set1_epi8( 9 ) ), values );
+
+    *out_minus_p = (uint32_t) _mm_movemask_epi8( _mm_cmpeq_epi8( bytes,
+        _mm_set1_epi8( '-' ) ) );
+    return (uint32_t) _mm_movemask_epi8( digits );
+}
+
+/// @brief Value of 1 to 8 digits, all at once (SWAR); x86 is little endian,
+/// so the first digit is the low byte
+/// @param digits_p the digits
+/// @param len how many there are
+/// @return the value
+static inline uint32_t parse_digits(const char * digits_p, unsigned len)
+{
+    uint64_t chunk;
+
+    memcpy( &chunk, digits_p, sizeof( chunk ) );
+    /* Borrows only move up, into the bytes past len the shift drops */
+    chunk -= 0x3030303030303030ull;
+    chunk <<= 8 * (8 - len);
+    /* Pairs of digits, then pairs of pairs, then the two halves */
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+        + (((chunk >> 16) & 0x000000FF000000FFull)
+            * (1 + (10000ull << 32)))) >> 32;
+    return (uint32_t) chunk;
+}
+
+#else
+
+/// @brief Marks the digits and minus signs in a block, one bit per byte
+/// @param block_p the block
+/// @param out_minus_p the minus signs
+/// @return the digits
+static inline uint32_t classify_block(const char * block_p,
+    uint32_t * out_minus_p)
+{
+    uint32_t digits = 0;
+
+    *out_minus_p = 0;
+    for (int i = 0; i < BLOCK_LEN; i++)
+    {
+        digits |= (uint32_t) ((byte_t) (block_p[ i ] - '0') <= 9) << i;
+        *out_minus_p |= (uint32_t) (block_p[ i ] == '-') << i;
+    }
+    return digits;
+}
+
+/// @brief Value of 1 to 8 digits
+/// @param digits_p the digits
+/// @param len how many there are
+/// @return the value
+static inline uint32_t parse_digits(const char * digits_p, unsigned len)
+{
+    uint32_t value = 0;
+
+    for (unsigned i = 0; i < len; i++)
+    {
+        value = value * 10 + (uint32_t) (digits_p[ i ] - '0');
+    }
+    return value;
+}
+
+#endif
+
+/// @brief Value of a run of 1 to BLOCK_LEN digits, wrapped to 32 bits
+/// @param digits_p the digits
+/// @param len how many there are
+/// @return the value
+static inline uint32_t parse_run(const char * digits_p, unsigned len)
+{
+    if (len > 8)
+    {
+        return parse_digits( digits_p, 8 ) * powers_of_10[ len - 8 ]
+            + parse_digits( digits_p + 8, len - 8 );
+    }
+    return parse_digits( digits_p, len );
+}
+
+/// @brief Parses one block, picking up where the last one stopped; the
+/// block must have BLOCK_READ_LEN readable bytes. Numbers are found from
+/// the digit mask with a bit scan each, so separators cost nothing
+/// @param block_p the block
+/// @param state_p where parsing is
+/// @param out_values_p where the finished numbers go
+static inline void parse_block(const char * block_p, parse_state_t * state_p,
+    byte_t * out_values_p)
+{
+    uint32_t minus;
+    uint32_t digits = classify_block( block_p, &minus );
+    uint32_t starts = digits & ~(digits << 1);
+    /* Bit n = a minus sign right before byte n, which negates a number */
+    uint32_t signs = (minus << 1) | state_p->last_minus;
+    /* Digits the block ends in, which the next block may go on with */
+    unsigned tail_len = (unsigned) __builtin_clz( ~(digits << BLOCK_LEN) );
+    uint64_t count = state_p->count;
+    uint32_t value;
+    uint32_t negative;
+    unsigned start;
+    unsigned len;
+
+    /* A number the last block ended in goes on, or ends, here */
+    if (state_p->in_number)
+    {
+        len = (unsigned) __builtin_ctz( ~digits );
+        if (len == BLOCK_LEN)
+        {
+            state_p->acc = state_p->acc * powers_of_10[ BLOCK_LEN ]
+                + parse_run( block_p, BLOCK_LEN );
+            return;
+        }
+        value = len > 0 ? state_p->acc * powers_of_10[ len ]
+            + parse_run( block_p, len ) : state_p->acc;
+        negative = state_p->negative;
+        out_values_p[ count++ ] = (byte_t) ((value ^ (0u - negative))
+            + negative);
+        state_p->in_number = 0;
+        starts &= ~1u;
+    }
+    if (tail_len > 0 && (starts & (1u << (BLOCK_LEN - tail_len))))
+    {
+        starts &= ~(1u << (BLOCK_LEN - tail_len));
+        state_p->acc = parse_run( block_p + BLOCK_LEN - tail_len, tail_len );
+        state_p->negative = (byte_t) ((signs >> (BLOCK_LEN - tail_len)) & 1);
+        state_p->in_number = 1;
+    }
+
+    /* Every number left ends inside the block */
+    while (starts != 0)
+    {
+        start = (unsigned) __builtin_ctz( starts );
+        starts &= starts - 1;
+        len = (unsigned) __builtin_ctz( ~(digits >> start) );
+        value = len > 8 ? parse_run( block_p + start, len )
+            : parse_digits( block_p + start, len );
+        negative = (signs >> start) & 1;
+        out_values_p[ count++ ] = (byte_t) ((value ^ (0u - negative))
+            + negative);
+    }
+    state_p->last_minus = (byte_t) ((minus >> (BLOCK_LEN - 1)) & 1);
+    state_p->count = count;
+}
+
+/// @brief Parses decimal integers separated by anything that is not a digit
+/// into what RDD reads from them (their low 8 bits, as the console takes
+/// them); negative numbers wrap the same way
+/// @param text_p the text
+/// @param len the length of the text
+/// @param out_values_p the values, with room for (len + 1) / 2 of them
+/// @return how many values there were
+uint64_t parse_decimal_values(const char * text_p, size_t len,
+    byte_t * out_values_p)
+{
+    parse_state_t state = { 0 };
+    /* The last blocks, padded with separators so they can be read whole */
+    char tail[ 2 * BLOCK_LEN + BLOCK_READ_LEN ] = { 0 };
+    /* Blocks up to here have BLOCK_READ_LEN bytes of the text to read */
+    size_t tail_off = len >= 2 * BLOCK_LEN 
+        ? (len - BLOCK_LEN) / BLOCK_LEN * BLOCK_LEN : 0;
+
+    memcpy( tail, text_p + tail_off, len - tail_off );
+    /* One call site, so parse_block is inlined */
+    for (size_t off = 0; off < len; off += BLOCK_LEN)
+    {
+        parse_block( off < tail_off ? text_p + off : tail + off - tail_off,
+            &state, out_values_p );
+    }
+    if (state.in_number)
+    {
+        out_values_p[ state.count++ ] = (byte_t) (state.negative 
+            ? 0u - state.acc : state.acc);
+    }
+    return state.count;
+}
+
+/*******************************************************************************
+ *                          Input File Functions
+ ******************************************************************************/
+
+/// @brief Loads the values of an input file; binary files are mapped and
+/// used in place, text files are parsed
+/// @param input_p the input to fill in
+/// @param file_name_p the file
+/// @param format INPUT_TEXT or INPUT_BINARY
+/// @return 1 if SUCCESS, otherwise ERROR
+int load_input_file(input_t * input_p, const char * file_name_p,
+    int format)
+{
+    struct stat info;
+    char * map_p = NULL;
+    int fd;
+
+    memset( input_p, 0, sizeof( *input_p ) );
+    fd = open( file_name_p, O_RDONLY );
+    if (fd < 0 || fstat( fd, &info ) != 0)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            file_name_p );
+        if (fd >= 0)
+        {
+            close( fd );
+        }
+        return ERROR;
+    }
+    if (info.st_size > 0)
+    {
+        map_p = (char *) mmap( NULL, (size_t) info.st_size, PROT_READ,
+            MAP_PRIVATE, fd, 0 );
+    }
+    close( fd );
+    if (map_p == MAP_FAILED)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be mapped!] #\n",
+            file_name_p );
+        return ERROR;
+    }
+    if (map_p == NULL)
+    {
+        return SUCCESS;
+    }
+    madvise( map_p, (size_t) info.st_size, MADV_SEQUENTIAL );
+
+    if (format == INPUT_BINARY)
+    {
+        input_p->values_p = (byte_t *) map_p;
+        input_p->num_values = (uint64_t) info.st_size;
+        input_p->map_len = (size_t) info.st_size;
+        return SUCCESS;
+    }
+
+    input_p->values_p = (byte_t *) malloc( ((size_t) info.st_size + 1) / 2 );
+    if (input_p->values_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate the values of "
+            "'%s'] #\n", file_name_p );
+        munmap( map_p, (size_t) info.st_size );
+        return ERROR;
+    }
+    input_p->num_values = parse_decimal_values( map_p,
+        (size_t) info.st_size, input_p->values_p );
+    munmap( map_p, (size_t) info.st_size );
+    return SUCCESS;
+}
+
+/// @brief Frees the values of an input file
+/// @param input_p the input
+void unload_input_file(input_t * input_p)
+{
+    if (input_p->borrowed)
+    {
+        /* Nothing to free */
+    } else if (input_p->map_len > 0)
+    {
+        munmap( input_p->values_p, input_p->map_len );
+    } else
+    {
+        free( input_p->values_p );
+    }
+    memset( input_p, 0, sizeof( *input_p ) );
+}
@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for bulk input files that feed RDD
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INPUT_H
+#define INPUT_H
+
+/***************************** Imports ****************************************/
+
+#include <stddef.h>
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Input file formats */
+#define INPUT_TEXT 0        // decimal integers separated by anything else
+#define INPUT_BINARY 1      // one byte per RDD, used as is
+
+/************************ Input Structs & Types *******************************/
+
+/* The values a program's RDDs read, in order */
+struct input_s {
+    byte_t * values_p;
+    uint64_t num_values;
+    /* Index of the value the next RDD reads */
+    uint64_t next;
+    /* Binary files are mapped rather than copied; bytes mapped, or 0 */
+    size_t map_len;
+    /* 1 = values_p belongs to someone else (e.g. an archive being read) */
+    byte_t borrowed;
+} typedef input_t;
+
+/************************ Public Input Functions ******************************/
+
+uint64_t parse_decimal_values(const char * text_p, size_t len,
+    byte_t * out_values_p);
+int load_input_file(input_t * input_p, const char * file_name_p,
+    int format);
+void unload_input_file(input_t * input_p);
+
+#endif
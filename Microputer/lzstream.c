@@ -0,0 +1,528 @@
+////////////////////////////////////////////////////////////////////////////////
+/// LZ compressed output streams: a small LZ77 block codec (LZ4-like
+/// sequences of literals and 16-bit offset matches), and a writer that
+/// compresses and writes blocks on a background thread so the simulation
+/// never waits on the disk
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "lzstream.h"
+
+/***************************** Macros *****************************************/
+
+#define LZ_MIN_MATCH 4
+/* The last bytes of a block are always literals, so matching never reads
+   past the end */
+#define LZ_LAST_LITERALS 5
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 0xFFFF
+/* Lengths past 15 continue in bytes of 255 */
+#define LZ_RUN_MASK 15
+
+/*******************************************************************************
+ *                          Block Codec Functions
+ ******************************************************************************/
+
+/// @brief Reads 4 bytes as they lie in memory
+static inline uint32_t read_u32(const byte_t * p)
+{
+    uint32_t value;
+
+    memcpy( &value, p, sizeof( value ) );
+    return value;
+}
+
+/// @brief Stores a little endian 32-bit value
+static inline void put_u32_le(byte_t * p, uint32_t value)
+{
+    p[ 0 ] = (byte_t) value;
+    p[ 1 ] = (byte_t) (value >> 8);
+    p[ 2 ] = (byte_t) (value >> 16);
+    p[ 3 ] = (byte_t) (value >> 24);
+}
+
+/// @brief Loads a little endian 32-bit value
+static inline uint32_t get_u32_le(const byte_t * p)
+{
+    return (uint32_t) p[ 0 ] | (uint32_t) p[ 1 ] << 8 
+        | (uint32_t) p[ 2 ] << 16 | (uint32_t) p[ 3 ] << 24;
+}
+
+/// @brief Writes the extra bytes of a length that did not fit its nibble
+/// @param dst_p where they go
+/// @param len the length less LZ_RUN_MASK
+/// @return bytes written
+static inline size_t put_run_length(byte_t * dst_p, size_t len)
+{
+    size_t n = 0;
+
+    for (; len >= 255; len -= 255)
+    {
+        dst_p[ n++ ] = 255;
+    }
+    dst_p[ n++ ] = (byte_t) len;
+    return n;
+}
+
+/// @brief Appends a sequence: a token, literals, then a match (if any)
+/// @return bytes written, or 0 if they do not fit
+static size_t put_sequence(byte_t * dst_p, size_t capacity,
+    const byte_t * literals_p, size_t num_literals, size_t offset,
+    size_t match_len)
+{
+    size_t match_code = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+    size_t n = 1;
+
+    /* The worst case, before anything is written */
+    if (1 + num_literals / 255 + 1 + num_literals + 2 + match_code / 255 + 1 
+        > capacity)
+    {
+        return 0;
+    }
+    dst_p[ 0 ] = (byte_t) ((num_literals < LZ_RUN_MASK 
+        ? num_literals : LZ_RUN_MASK) << 4 
+        | (match_code < LZ_RUN_MASK ? match_code : LZ_RUN_MASK));
+    if (num_literals >= LZ_RUN_MASK)
+    {
+        n += put_run_length( dst_p + n, num_literals - LZ_RUN_MASK );
+    }
+    memcpy( dst_p + n, literals_p, num_literals );
+    n += num_literals;
+    if (match_len > 0)
+    {
+        dst_p[ n++ ] = (byte_t) offset;
+        dst_p[ n++ ] = (byte_t) (offset >> 8);
+        if (match_code >= LZ_RUN_MASK)
+        {
+            n += put_run_length( dst_p + n, match_code - LZ_RUN_MASK );
+        }
+    }
+    return n;
+}
+
+/// @brief Compresses a block, greedily taking the match a hash of the next
+/// 4 bytes points at
+/// @param src_p the block
+/// @param len its length, at most LZ_BLOCK_SIZE
+/// @param dst_p where the compressed block goes
+/// @param capacity room at dst_p
+/// @return the compressed length, or 0 if it does not fit in capacity
+size_t lz_compress_block(const byte_t * src_p, size_t len, byte_t * dst_p,
+    size_t capacity)
+{
+    uint32_t table[ 1 << LZ_HASH_BITS ] = { 0 };
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+    size_t n;
+    uint32_t seq;
+    uint32_t hash;
+    size_t candidate;
+    size_t match_len;
+
+    while (ip + LZ_MIN_MATCH + LZ_LAST_LITERALS <= len)
+    {
+        seq = read_u32( src_p + ip );
+        hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        candidate = table[ hash ];
+        table[ hash ] = (uint32_t) ip;
+        if (candidate >= ip || ip - candidate > LZ_MAX_OFFSET
+            || read_u32( src_p + candidate ) != seq)
+        {
+            ip++;
+            continue;
+        }
+        match_len = LZ_MIN_MATCH;
+        while (ip + match_len < len - LZ_LAST_LITERALS 
+            && src_p[ candidate + match_len ] == src_p[ ip + match_len ])
+        {
+            match_len++;
+        }
+        n = put_sequence( dst_p + op, capacity - op, src_p + anchor, 
+            ip - anchor, ip - candidate, match_len );
+        if (n == 0)
+        {
+            return 0;
+        }
+        op += n;
+        ip += match_len;
+        anchor = ip;
+    }
+    n = put_sequence( dst_p + op, capacity - op, src_p + anchor, 
+        len - anchor, 0, 0 );
+    return n == 0 ? 0 : op + n;
+}
+
+/// @brief Reads the extra bytes of a length that did not fit its nibble
+/// @return 1 if SUCCESS, otherwise ERROR (the block ended first)
+static inline int get_run_length(const byte_t * src_p, size_t len,
+    size_t * ip_p, size_t * out_len_p)
+{
+    byte_t b;
+
+    do
+    {
+        if (*ip_p >= len)
+        {
+            return ERROR;
+        }
+        b = src_p[ (*ip_p)++ ];
+        *out_len_p += b;
+    } while (b == 255);
+    return SUCCESS;
+}
+
+/// @brief Decompresses a block, checking every length and offset against
+/// the bounds of both buffers
+/// @param src_p the compressed block
+/// @param len its length
+/// @param dst_p where the block goes
+/// @param raw_len the length it must decompress to
+/// @return 1 if SUCCESS, otherwise ERROR
+int lz_decompress_block(const byte_t * src_p, size_t len, byte_t * dst_p,
+    size_t raw_len)
+{
+    size_t ip = 0;
+    size_t op = 0;
+    size_t num_literals;
+    size_t match_len;
+    size_t offset;
+    byte_t token;
+
+    while (ip < len)
+    {
+        token = src_p[ ip++ ];
+        num_literals = token >> 4;
+        if (num_literals == LZ_RUN_MASK 
+            && get_run_length( src_p, len, &ip, &num_literals ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        if (num_literals > len - ip || num_literals > raw_len - op)
+        {
+            return ERROR;
+        }
+        memcpy( dst_p + op, src_p + ip, num_literals );
+        ip += num_literals;
+        op += num_literals;
+        /* The last sequence has no match */
+        if (ip == len)
+        {
+            break;
+        }
+        if (len - ip < 2)
+        {
+            return ERROR;
+        }
+        offset = (size_t) src_p[ ip ] | (size_t) src_p[ ip + 1 ] << 8;
+        ip += 2;
+        match_len = token & LZ_RUN_MASK;
+        if (match_len == LZ_RUN_MASK 
+            && get_run_length( src_p, len, &ip, &match_len ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || match_len > raw_len - op)
+        {
+            return ERROR;
+        }
+        /* Byte by byte, as a match may overlap what it copies */
+        for (size_t i = 0; i < match_len; i++, op++)
+        {
+            dst_p[ op ] = dst_p[ op - offset ];
+        }
+    }
+    return op == raw_len ? SUCCESS : ERROR;
+}
+
+/*******************************************************************************
+ *                          Stream Functions
+ ******************************************************************************/
+
+/// @brief Writes one block, compressed when that makes it smaller
+/// @return 1 if SUCCESS, otherwise ERROR
+static int write_block(lz_stream_t * stream_p, const byte_t * block_p,
+    size_t len, byte_t * scratch_p)
+{
+    byte_t header[ 8 ];
+    size_t stored = lz_compress_block( block_p, len, scratch_p, len - 1 );
+    const byte_t * data_p = stored > 0 ? scratch_p : block_p;
+
+    if (stored == 0)
+    {
+        stored = len;
+    }
+    put_u32_le( header, (uint32_t) len );
+    put_u32_le( header + 4, (uint32_t) stored );
+    stream_p->raw_bytes += len;
+    stream_p->stored_bytes += sizeof( header ) + stored;
+    if (fwrite( header, 1, sizeof( header ), stream_p->file_p ) 
+        != sizeof( header )
+        || fwrite( data_p, 1, stored, stream_p->file_p ) != stored)
+    {
+        printf( "\t# [ERROR: Can not write the compressed stream!] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief The compressing thread; empties slots in order until the stream
+/// is closed and nothing is left
+/// @param arg_p the stream
+/// @return NULL
+static void * compress_slots(void * arg_p)
+{
+    lz_stream_t * stream_p = (lz_stream_t *) arg_p;
+    byte_t * scratch_p = (byte_t *) malloc( LZ_BLOCK_SIZE );
+    int result = scratch_p != NULL ? SUCCESS : ERROR;
+    size_t slot;
+
+    pthread_mutex_lock( &stream_p->lock );
+    for (;;)
+    {
+        while (stream_p->num_filled == stream_p->num_emptied 
+            && !stream_p->closing)
+        {
+            pthread_cond_wait( &stream_p->filled, &stream_p->lock );
+        }
+        if (stream_p->num_filled == stream_p->num_emptied)
+        {
+            break;
+        }
+        slot = stream_p->num_emptied % LZ_STREAM_SLOTS;
+        pthread_mutex_unlock( &stream_p->lock );
+
+        if (result == SUCCESS)
+        {
+            result = write_block( stream_p, stream_p->slots_p[ slot ],
+                stream_p->slot_lens[ slot ], scratch_p );
+        }
+
+        pthread_mutex_lock( &stream_p->lock );
+        stream_p->result = result;
+        stream_p->num_emptied++;
+        pthread_cond_signal( &stream_p->emptied );
+    }
+    stream_p->result = result;
+    pthread_mutex_unlock( &stream_p->lock );
+    free( scratch_p );
+    return NULL;
+}
+
+/// @brief Starts a compressed stream into a file and its compressing thread
+/// @param out_stream_pp a pointer to a pointer of the stream
+/// @param file_p the file (not closed with the stream)
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_lz_stream(lz_stream_t ** out_stream_pp, FILE * file_p)
+{
+    lz_stream_t * stream_p = NULL;
+
+    stream_p = (lz_stream_t *) calloc( 1, sizeof( lz_stream_t ) );
+    if (stream_p == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for "
+            "*out_stream_pp] #\n" );
+        return ERROR;
+    }
+    for (int i = 0; i < LZ_STREAM_SLOTS; i++)
+    {
+        stream_p->slots_p[ i ] = (byte_t *) malloc( LZ_BLOCK_SIZE );
+        if (stream_p->slots_p[ i ] == NULL)
+        {
+            printf( "\t# [ERROR: malloc failed to allocate stream "
+                "slots] #\n" );
+            goto FUNC_ERROR;
+        }
+    }
+    stream_p->file_p = file_p;
+    if (fwrite( LZ_STREAM_MAGIC, 1, 4, file_p ) != 4)
+    {
+        printf( "\t# [ERROR: Can not write the compressed stream!] #\n" );
+        goto FUNC_ERROR;
+    }
+    pthread_mutex_init( &stream_p->lock, NULL );
+    pthread_cond_init( &stream_p->filled, NULL );
+    pthread_cond_init( &stream_p->emptied, NULL );
+    if (pthread_create( &stream_p->thread, NULL, compress_slots, 
+        stream_p ) != 0)
+    {
+        printf( "\t# [ERROR: can not start the compressing thread] #\n" );
+        pthread_mutex_destroy( &stream_p->lock );
+        pthread_cond_destroy( &stream_p->filled );
+        pthread_cond_destroy( &stream_p->emptied );
+        goto FUNC_ERROR;
+    }
+    *out_stream_pp = stream_p;
+    return SUCCESS;
+
+    FUNC_ERROR:
+    for (int i = 0; i < LZ_STREAM_SLOTS; i++)
+    {
+        free( stream_p->slots_p[ i ] );
+    }
+    free( stream_p );
+    return ERROR;
+}
+
+/// @brief Drains and ends a stream, stops its thread and frees it
+/// @param stream_pp a pointer to a pointer of the stream
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_lz_stream(lz_stream_t ** stream_pp)
+{
+    lz_stream_t * stream_p = *stream_pp;
+    byte_t end[ 4 ] = { 0 };
+    int result;
+
+    if (stream_p == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *stream_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    pthread_mutex_lock( &stream_p->lock );
+    stream_p->closing = 1;
+    pthread_cond_signal( &stream_p->filled );
+    pthread_mutex_unlock( &stream_p->lock );
+    pthread_join( stream_p->thread, NULL );
+
+    result = stream_p->result;
+    if (result == SUCCESS 
+        && (fwrite( end, 1, sizeof( end ), stream_p->file_p ) != sizeof( end )
+            || fflush( stream_p->file_p ) != 0))
+    {
+        printf( "\t# [ERROR: Can not write the compressed stream!] #\n" );
+        result = ERROR;
+    }
+
+    pthread_mutex_destroy( &stream_p->lock );
+    pthread_cond_destroy( &stream_p->filled );
+    pthread_cond_destroy( &stream_p->emptied );
+    for (int i = 0; i < LZ_STREAM_SLOTS; i++)
+    {
+        free( stream_p->slots_p[ i ] );
+    }
+    free( stream_p );
+    *stream_pp = NULL;
+    return result;
+}
+
+/// @brief Queues data for the compressing thread, waiting only while every
+/// slot is still full
+/// @param stream_p the stream
+/// @param data_p the data
+/// @param len its length
+/// @return 1 if SUCCESS, otherwise ERROR (including an earlier failed write)
+int write_lz_stream(lz_stream_t * stream_p, const void * data_p, size_t len)
+{
+    const byte_t * byte_p = (const byte_t *) data_p;
+    size_t slot;
+    size_t n;
+    int result = SUCCESS;
+
+    while (len > 0 && result == SUCCESS)
+    {
+        n = len < LZ_BLOCK_SIZE ? len : LZ_BLOCK_SIZE;
+
+        pthread_mutex_lock( &stream_p->lock );
+        while (stream_p->num_filled - stream_p->num_emptied 
+            == LZ_STREAM_SLOTS)
+        {
+            pthread_cond_wait( &stream_p->emptied, &stream_p->lock );
+        }
+        slot = stream_p->num_filled % LZ_STREAM_SLOTS;
+        result = stream_p->result;
+        pthread_mutex_unlock( &stream_p->lock );
+
+        /* The thread only reads a slot once it is counted as filled */
+        memcpy( stream_p->slots_p[ slot ], byte_p, n );
+        stream_p->slot_lens[ slot ] = n;
+
+        pthread_mutex_lock( &stream_p->lock );
+        stream_p->num_filled++;
+        pthread_cond_signal( &stream_p->filled );
+        pthread_mutex_unlock( &stream_p->lock );
+
+        byte_p += n;
+        len -= n;
+    }
+    return result;
+}
+
+/// @brief Decompresses a stream file
+/// @param file_name_p the stream file
+/// @param out_file_p where the decompressed data goes
+/// @return 1 if SUCCESS, otherwise ERROR
+int decompress_lz_file(const char * file_name_p, FILE * out_file_p)
+{
+    FILE * file_p = fopen( file_name_p, "rb" );
+    byte_t * stored_p = (byte_t *) malloc( LZ_BLOCK_SIZE );
+    byte_t * raw_p = (byte_t *) malloc( LZ_BLOCK_SIZE );
+    byte_t header[ 8 ];
+    uint32_t raw_len;
+    uint32_t stored_len;
+    int result = ERROR;
+
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n", 
+            file_name_p );
+        goto FUNC_EXIT;
+    }
+    if (stored_p == NULL || raw_p == NULL
+        || fread( header, 1, 4, file_p ) != 4 
+        || memcmp( header, LZ_STREAM_MAGIC, 4 ) != 0)
+    {
+        printf( "\t# [ERROR: '%s' is not a compressed stream] #\n", 
+            file_name_p );
+        goto FUNC_EXIT;
+    }
+    for (;;)
+    {
+        if (fread( header, 1, 4, file_p ) != 4)
+        {
+            break;
+        }
+        raw_len = get_u32_le( header );
+        if (raw_len == 0)
+        {
+            result = SUCCESS;
+            break;
+        }
+        if (fread( header + 4, 1, 4, file_p ) != 4)
+        {
+            break;
+        }
+        stored_len = get_u32_le( header + 4 );
+        if (raw_len > LZ_BLOCK_SIZE || stored_len > raw_len
+            || fread( stored_p, 1, stored_len, file_p ) != stored_len
+            || (stored_len < raw_len && lz_decompress_block( stored_p,
+                stored_len, raw_p, raw_len ) != SUCCESS))
+        {
+            break;
+        }
+        if (fwrite( stored_len < raw_len ? raw_p : stored_p, 1, raw_len,
+            out_file_p ) != raw_len)
+        {
+            break;
+        }
+    }
+    if (result != SUCCESS)
+    {
+        printf( "\t# [ERROR: '%s' is truncated or corrupt] #\n", 
+            file_name_p );
+    }
+
+    FUNC_EXIT:
+    if (file_p != NULL)
+    {
+        fclose( file_p );
+    }
+    free( stored_p );
+    free( raw_p );
+    return result;
+}
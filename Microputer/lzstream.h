@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for LZ compressed output streams
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LZSTREAM_H
+#define LZSTREAM_H
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Streams start with this, then hold blocks of a 4 byte raw length, a 4 byte
+   stored length (equal to the raw length when stored uncompressed) and the
+   data, and end with a raw length of 0 */
+#define LZ_STREAM_MAGIC "MPZ1"
+/* Matches can reach back 16 bits, so blocks are at most this long */
+#define LZ_BLOCK_SIZE (1 << 16)
+/* Blocks waiting for the compressing thread */
+#define LZ_STREAM_SLOTS 4
+
+/*********************** LZ Stream Structs & Types ****************************/
+
+/* A file written through a compressing thread */
+struct lz_stream_s {
+    FILE * file_p;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    /* Signaled when a slot is filled, and when one is emptied */
+    pthread_cond_t filled;
+    pthread_cond_t emptied;
+    byte_t * slots_p[ LZ_STREAM_SLOTS ];
+    size_t slot_lens[ LZ_STREAM_SLOTS ];
+    /* Slots filled and emptied so far; their difference is the backlog */
+    uint64_t num_filled;
+    uint64_t num_emptied;
+    byte_t closing;
+    int result;
+    uint64_t raw_bytes;
+    uint64_t stored_bytes;
+} typedef lz_stream_t;
+
+/*********************** Public LZ Stream Functions ***************************/
+
+size_t lz_compress_block(const byte_t * src_p, size_t len, byte_t * dst_p,
+    size_t capacity);
+int lz_decompress_block(const byte_t * src_p, size_t len, byte_t * dst_p,
+    size_t raw_len);
+int create_lz_stream(lz_stream_t ** out_stream_pp, FILE * file_p);
+int delete_lz_stream(lz_stream_t ** stream_pp);
+int write_lz_stream(lz_stream_t * stream_p, const void * data_p, size_t len);
+int decompress_lz_file(const char * file_name_p, FILE * out_file_p);
+
+#endif
@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Simulates several microputer cores executing one shared memory image
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "machine.h"
+
+/************************** Private Types *************************************/
+
+/* State shared by the host threads of one run_machine_parallel call */
+struct parallel_run_s {
+    machine_t * machine_p;
+    /* Every worker and the coordinating thread meet here twice a quantum */
+    pthread_barrier_t barrier;
+    /* Held until the barrier exists, so workers can't reach it too early */
+    pthread_mutex_t gate;
+    /* Set by the coordinator when the workers should exit */
+    volatile int stop;
+    /* Each core's PRT output for the current quantum */
+    io_log_t logs[ MAX_CORES ];
+    /* Each core's cycle count when the quantum started */
+    uint64_t start[ MAX_CORES ];
+    int results[ MAX_CORES ];
+} typedef parallel_run_t;
+
+/* What a worker thread needs to find its core */
+struct core_worker_s {
+    parallel_run_t * run_p;
+    byte_t core;
+} typedef core_worker_t;
+
+/*******************************************************************************
+ *              Machine Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates a machine and its cores
+/// @param out_machine_pp a pointer to a pointer of the machine
+/// @param num_cores the number of cores, 1 to MAX_CORES
+/// @param quantum instructions per core per turn (0 = DEFAULT_QUANTUM)
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_machine(machine_t ** out_machine_pp, byte_t num_cores, 
+    uint64_t quantum)
+{
+    if (num_cores < 1 || num_cores > MAX_CORES)
+    {
+        printf( "\t# [ERROR: a machine has 1 to %d cores, not %hu] #\n",
+            MAX_CORES, (uint16_t) num_cores );
+        return ERROR;
+    }
+
+    *out_machine_pp = (machine_t *) malloc( sizeof( machine_t ) );
+    if (*out_machine_pp == NULL) 
+    { 
+        printf( "\t# [ERROR: malloc failed to allocate for *out_machine_pp] #\n" );
+        return ERROR; 
+    }
+    memset( *out_machine_pp, 0, sizeof( machine_t ) );
+    (*out_machine_pp)->num_cores = num_cores;
+    (*out_machine_pp)->quantum = quantum ? quantum : DEFAULT_QUANTUM;
+
+    for (byte_t i = 0; i < num_cores; i++)
+    {
+        if (create_microputer( &(*out_machine_pp)->cores_p[ i ] ) != SUCCESS)
+        {
+            delete_machine( out_machine_pp );
+            return ERROR;
+        }
+        create_instruction_set( (*out_machine_pp)->cores_p[ i ] );
+        /* R15 holds the core number, so firmware can tell the cores apart */
+        (*out_machine_pp)->cores_p[ i ]->reg[ NUM_REGISTERS - 1 ] = i;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief Frees the machine and all of its cores
+/// @param machine_pp a pointer to a pointer of the machine
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_machine(machine_t ** machine_pp)
+{
+    if (*machine_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *machine_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+
+    for (byte_t i = 0; i < MAX_CORES; i++)
+    {
+        if ((*machine_pp)->cores_p[ i ] != NULL)
+        {
+            delete_microputer( &(*machine_pp)->cores_p[ i ] );
+        }
+    }
+    free( *machine_pp );
+    *machine_pp = NULL;
+
+    return SUCCESS;
+}
+
+/// @brief Makes the program loaded into one microputer the machine's shared
+/// memory image and points every core at it and at its I/O bus
+/// @param machine_p machine pointer
+/// @param loaded_p the microputer the program was loaded into
+void share_machine_memory(machine_t * machine_p, microputer_t * loaded_p)
+{
+    memcpy( machine_p->mem, loaded_p->mem, MEM_BYTE_SIZE );
+    machine_p->loaded_mem_slots = loaded_p->loaded_mem_slots;
+
+    for (byte_t i = 0; i < machine_p->num_cores; i++)
+    {
+        microputer_t * core_p = machine_p->cores_p[ i ];
+        core_p->mem_p = machine_p->mem;
+        core_p->bus_p = loaded_p->bus_p;
+        core_p->loaded_mem_slots = machine_p->loaded_mem_slots;
+        core_p->pc = 0;
+        core_p->halted = 0;
+    }
+}
+
+/*******************************************************************************
+ *                        Machine Execution Functions
+ ******************************************************************************/
+
+/// @brief Runs every core to completion, giving each core quantum 
+/// instructions in turn (core 0 first); fully deterministic
+/// @param machine_p machine pointer
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_machine(machine_t * machine_p)
+{
+    byte_t running = machine_p->num_cores;
+
+    while (running > 0)
+    {
+        running = 0;
+        for (byte_t i = 0; i < machine_p->num_cores; i++)
+        {
+            microputer_t * core_p = machine_p->cores_p[ i ];
+            if (core_p->halted)
+            {
+                continue;
+            }
+            if (run_micro_program( core_p, machine_p->quantum ) != SUCCESS)
+            {
+                printf( "\t# [ERROR: core %hu stopped at pc %hu] #\n",
+                    (uint16_t) i, core_p->pc );
+                return ERROR;
+            }
+            running += !core_p->halted;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/// @brief Worker thread: simulates one core's part of every quantum
+/// @param worker_p the core_worker_t for this core
+/// @return NULL
+static void * core_worker(void * worker_p)
+{
+    core_worker_t * worker = (core_worker_t *) worker_p;
+    parallel_run_t * run_p = worker->run_p;
+    microputer_t * core_p = run_p->machine_p->cores_p[ worker->core ];
+
+    pthread_mutex_lock( &run_p->gate );
+    pthread_mutex_unlock( &run_p->gate );
+
+    for (;;)
+    {
+        /* Quantum starts */
+        pthread_barrier_wait( &run_p->barrier );
+        if (run_p->stop)
+        {
+            break;
+        }
+        run_p->start[ worker->core ] = core_p->cycles;
+        run_p->results[ worker->core ] = core_p->halted ? SUCCESS : 
+            run_micro_program_until_input( core_p, run_p->machine_p->quantum );
+        /* Quantum ends */
+        pthread_barrier_wait( &run_p->barrier );
+    }
+    return NULL;
+}
+
+/// @brief Runs the same schedule as run_machine with every core simulated 
+/// on its own host thread, synchronizing conservatively once a quantum. 
+/// Within a quantum a core's PRT output goes to its io_log and the core
+/// only stops early at an RDD, whose value can't be known in advance. At
+/// the barrier the coordinator, in core order, releases each core's 
+/// buffered output and finishes the turns stopped at an RDD. The output is
+/// identical to run_machine for the same quantum. Writes to devices that 
+/// affect the core (so can't be deferred) are treated like RDD
+/// @param machine_p machine pointer
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_machine_parallel(machine_t * machine_p)
+{
+    pthread_t threads[ MAX_CORES ];
+    core_worker_t workers[ MAX_CORES ];
+    parallel_run_t * run_p = NULL;
+    byte_t created = 0;
+    byte_t running = machine_p->num_cores;
+    int result = SUCCESS;
+
+    run_p = (parallel_run_t *) calloc( 1, sizeof( parallel_run_t ) );
+    if (run_p == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate parallel run] #\n" );
+        return ERROR;
+    }
+    run_p->machine_p = machine_p;
+    for (byte_t i = 0; i < machine_p->num_cores && result == SUCCESS; i++)
+    {
+        /* A whole quantum of PRTs always fits */
+        result = create_io_log( &run_p->logs[ i ], machine_p->quantum );
+        machine_p->cores_p[ i ]->io_log_p = &run_p->logs[ i ];
+    }
+
+    pthread_mutex_init( &run_p->gate, NULL );
+    pthread_mutex_lock( &run_p->gate );
+    while (result == SUCCESS && created < machine_p->num_cores)
+    {
+        workers[ created ].run_p = run_p;
+        workers[ created ].core = created;
+        if (pthread_create( &threads[ created ], NULL, core_worker, 
+            &workers[ created ] ) != 0)
+        {
+            break;
+        }
+        created++;
+    }
+    pthread_barrier_init( &run_p->barrier, NULL, created + 1 );
+    pthread_mutex_unlock( &run_p->gate );
+
+    /* Without a thread per core, the schedule is run on this thread alone */
+    if (result != SUCCESS || created < machine_p->num_cores)
+    {
+        running = 0;
+    }
+
+    while (running > 0 && result == SUCCESS)
+    {
+        pthread_barrier_wait( &run_p->barrier );
+        pthread_barrier_wait( &run_p->barrier );
+
+        running = 0;
+        for (byte_t i = 0; i < machine_p->num_cores && result == SUCCESS; i++)
+        {
+            microputer_t * core_p = machine_p->cores_p[ i ];
+            uint64_t used = core_p->cycles - run_p->start[ i ];
+
+            result = run_p->results[ i ];
+            if (result == SUCCESS)
+            {
+                result = flush_io_log( core_p );
+            }
+            if (result == SUCCESS && !core_p->halted 
+                && used < machine_p->quantum)
+            {
+                /* Its turn is now, so the rest of it prints directly */
+                core_p->io_log_p = NULL;
+                result = run_micro_program( core_p, 
+                    machine_p->quantum - used );
+                core_p->io_log_p = &run_p->logs[ i ];
+            }
+            if (result != SUCCESS)
+            {
+                printf( "\t# [ERROR: core %hu stopped at pc %hu] #\n",
+                    (uint16_t) i, core_p->pc );
+            }
+            running += !core_p->halted;
+        }
+    }
+
+    run_p->stop = 1;
+    pthread_barrier_wait( &run_p->barrier );
+    for (byte_t i = 0; i < created; i++)
+    {
+        pthread_join( threads[ i ], NULL );
+    }
+    pthread_barrier_destroy( &run_p->barrier );
+    pthread_mutex_destroy( &run_p->gate );
+
+    for (byte_t i = 0; i < machine_p->num_cores; i++)
+    {
+        machine_p->cores_p[ i ]->io_log_p = NULL;
+        delete_io_log( &run_p->logs[ i ] );
+    }
+    if (result == SUCCESS && created < machine_p->num_cores)
+    {
+        result = run_machine( machine_p );
+    }
+    free( run_p );
+
+    return result;
+}
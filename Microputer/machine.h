@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file to model a machine of microputer cores sharing one memory
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+#define MAX_CORES 16
+/* Instructions each core runs before the next core gets its turn */
+#define DEFAULT_QUANTUM 1024
+
+/*********************** Machine Structs & Types ******************************/
+
+/* Represents N microputer cores executing one shared memory image */
+struct machine_s {
+    /* Each core has its own registers, PC and IR */
+    microputer_t * cores_p[ MAX_CORES ];
+    /* The memory image every core fetches its instructions from */
+    byte_t mem[ MEM_BYTE_SIZE ];
+    byte_t loaded_mem_slots;
+    byte_t num_cores;
+    /* Instructions per core per round-robin turn */
+    uint64_t quantum;
+} typedef machine_t;
+
+/*********************** Public Machine Functions *****************************/
+
+int create_machine(machine_t ** out_machine_pp, byte_t num_cores, 
+    uint64_t quantum);
+int delete_machine(machine_t ** machine_pp);
+void share_machine_memory(machine_t * machine_p, microputer_t * loaded_p);
+int run_machine(machine_t * machine_p);
+int run_machine_parallel(machine_t * machine_p);
+
+#endif
@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Per-job latency histograms and throughput counters, exported in the
+/// Prometheus text format
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "metrics.h"
+
+/***************************** Globals ****************************************/
+
+/* Label values of the phases, by PHASE_ */
+static const char * phase_names[ NUM_PHASES ] = {
+    "load", "decode", "execute", "output"
+};
+
+/* Quantiles exported for each phase */
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+
+/*******************************************************************************
+ *              Metrics Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates empty metrics, starting the clock for rates
+/// @param out_metrics_pp a pointer to a pointer of the metrics
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_metrics(metrics_t ** out_metrics_pp)
+{
+    *out_metrics_pp = (metrics_t *) calloc( 1, sizeof( metrics_t ) );
+    if (*out_metrics_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for "
+            "*out_metrics_pp] #\n" );
+        return ERROR;
+    }
+    (*out_metrics_pp)->start_ns = metrics_now_ns();
+    return SUCCESS;
+}
+
+/// @brief Frees the metrics
+/// @param metrics_pp a pointer to a pointer of the metrics
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_metrics(metrics_t ** metrics_pp)
+{
+    if (*metrics_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *metrics_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    free( *metrics_pp );
+    *metrics_pp = NULL;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Histogram Functions
+ ******************************************************************************/
+
+/// @brief Reads the monotonic clock
+/// @return nanoseconds since an arbitrary point
+uint64_t metrics_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/// @brief Finds the bucket a value is counted in; values below
+/// HISTOGRAM_SUB_BUCKETS get a bucket each, above that every power of two
+/// gets HISTOGRAM_SUB_BUCKETS of them
+/// @param value the value
+/// @return the bucket index
+static int bucket_index(uint64_t value)
+{
+    int exponent;
+
+    if (value < HISTOGRAM_SUB_BUCKETS)
+    {
+        return (int) value;
+    }
+    exponent = 63 - __builtin_clzll( value );
+    return (exponent - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+        + (int) (value >> (exponent - HISTOGRAM_SUB_BUCKET_BITS))
+        - HISTOGRAM_SUB_BUCKETS;
+}
+
+/// @brief The largest value counted in a bucket
+/// @param index the bucket index
+/// @return the value
+static uint64_t bucket_highest(int index)
+{
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t) (index % HISTOGRAM_SUB_BUCKETS)
+        + HISTOGRAM_SUB_BUCKETS;
+
+    if (index < HISTOGRAM_SUB_BUCKETS)
+    {
+        return (uint64_t) index;
+    }
+    return ((sub + 1) << shift) - 1;
+}
+
+/// @brief Counts one latency
+/// @param hist_p the histogram
+/// @param ns the latency in nanoseconds
+void record_latency(latency_histogram_t * hist_p, uint64_t ns)
+{
+    hist_p->counts[ bucket_index( ns ) ]++;
+    hist_p->count++;
+    hist_p->sum += ns;
+    if (ns > hist_p->max)
+    {
+        hist_p->max = ns;
+    }
+}
+
+/// @brief Finds the latency a fraction of the recorded ones are at or under
+/// @param hist_p the histogram
+/// @param q the fraction, 0 to 1
+/// @return the latency in nanoseconds, to within a bucket; 0 if empty
+uint64_t latency_percentile(const latency_histogram_t * hist_p, double q)
+{
+    uint64_t rank = (uint64_t) (q * hist_p->count + 0.5);
+    uint64_t seen = 0;
+    uint64_t highest;
+
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += hist_p->counts[ i ];
+        if (seen >= rank)
+        {
+            highest = bucket_highest( i );
+            return highest < hist_p->max ? highest : hist_p->max;
+        }
+    }
+    return hist_p->max;
+}
+
+/*******************************************************************************
+ *                          Job & Export Functions
+ ******************************************************************************/
+
+/// @brief Records the phases a job got through and what it ran
+/// @param metrics_p the metrics
+/// @param phase_ends_p the job's start time, then the time each phase ended
+/// (NUM_PHASES + 1 entries); 0 for phases the job did not reach
+/// @param instructions simulated instructions the job executed
+/// @param result the job's result
+void record_job(metrics_t * metrics_p, const uint64_t * phase_ends_p,
+    uint64_t instructions, int result)
+{
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        if (phase_ends_p[ i + 1 ] == 0)
+        {
+            break;
+        }
+        record_latency( &metrics_p->phases[ i ],
+            phase_ends_p[ i + 1 ] - phase_ends_p[ i ] );
+    }
+    metrics_p->jobs++;
+    metrics_p->failed_jobs += (result != SUCCESS);
+    metrics_p->instructions += instructions;
+}
+
+/// @brief Writes the metrics in the Prometheus text format; the file is
+/// replaced in one rename, so a scraper (e.g. node_exporter's textfile
+/// collector) never reads half of it
+/// @param metrics_p the metrics
+/// @param metrics_file_name_p the file to write
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_prometheus_metrics(const metrics_t * metrics_p,
+    const char * metrics_file_name_p)
+{
+    size_t tmp_len = strlen( metrics_file_name_p ) + 5;
+    char * tmp_file_p = (char *) malloc( tmp_len );
+    FILE * file_p = NULL;
+    double uptime = (metrics_now_ns() - metrics_p->start_ns) / 1e9;
+    uint64_t lookups = metrics_p->listing_hits + metrics_p->listing_misses;
+    int result = SUCCESS;
+
+    if (tmp_file_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate metrics file name] #\n" );
+        return ERROR;
+    }
+    snprintf( tmp_file_p, tmp_len, "%s.tmp", metrics_file_name_p );
+    file_p = fopen( tmp_file_p, "w" );
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: Could not open '%s'] #\n", tmp_file_p );
+        free( tmp_file_p );
+        return ERROR;
+    }
+
+    fprintf( file_p, "# HELP microputer_job_phase_seconds Latency of each "
+        "phase of a job.\n# TYPE microputer_job_phase_seconds summary\n" );
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        for (size_t j = 0; j < sizeof( quantiles ) / sizeof( *quantiles ); j++)
+        {
+            fprintf( file_p, "microputer_job_phase_seconds{phase=\"%s\","
+                "quantile=\"%g\"} %.9f\n", phase_names[ i ], quantiles[ j ],
+                latency_percentile( &metrics_p->phases[ i ], quantiles[ j ] )
+                    / 1e9 );
+        }
+        fprintf( file_p, "microputer_job_phase_seconds_sum{phase=\"%s\"} "
+            "%.9f\n", phase_names[ i ], metrics_p->phases[ i ].sum / 1e9 );
+        fprintf( file_p, "microputer_job_phase_seconds_count{phase=\"%s\"} "
+            "%llu\n", phase_names[ i ],
+            (unsigned long long) metrics_p->phases[ i ].count );
+    }
+
+    fprintf( file_p, "# HELP microputer_jobs_total Jobs run.\n"
+        "# TYPE microputer_jobs_total counter\nmicroputer_jobs_total %llu\n",
+        (unsigned long long) metrics_p->jobs );
+    fprintf( file_p, "# HELP microputer_failed_jobs_total Jobs that failed.\n"
+        "# TYPE microputer_failed_jobs_total counter\n"
+        "microputer_failed_jobs_total %llu\n",
+        (unsigned long long) metrics_p->failed_jobs );
+    fprintf( file_p, "# HELP microputer_instructions_total Simulated "
+        "instructions executed.\n# TYPE microputer_instructions_total counter\n"
+        "microputer_instructions_total %llu\n",
+        (unsigned long long) metrics_p->instructions );
+    fprintf( file_p, "# HELP microputer_jobs_per_second Jobs per second "
+        "since start.\n# TYPE microputer_jobs_per_second gauge\n"
+        "microputer_jobs_per_second %g\n",
+        uptime > 0 ? metrics_p->jobs / uptime : 0.0 );
+    fprintf( file_p, "# HELP microputer_instructions_per_second Simulated "
+        "instructions per second since start.\n"
+        "# TYPE microputer_instructions_per_second gauge\n"
+        "microputer_instructions_per_second %g\n",
+        uptime > 0 ? metrics_p->instructions / uptime : 0.0 );
+    fprintf( file_p, "# HELP microputer_listing_cache_hit_ratio Listing "
+        "lines reused from the previous run.\n"
+        "# TYPE microputer_listing_cache_hit_ratio gauge\n"
+        "microputer_listing_cache_hit_ratio %g\n",
+        lookups ? (double) metrics_p->listing_hits / lookups : 0.0 );
+
+    if (ferror( file_p ))
+    {
+        result = ERROR;
+    }
+    if (fclose( file_p ) != 0 || result != SUCCESS
+        || rename( tmp_file_p, metrics_file_name_p ) != 0)
+    {
+        printf( "\t# [ERROR: Could not write '%s'] #\n", metrics_file_name_p );
+        result = ERROR;
+    }
+    free( tmp_file_p );
+    return result;
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for per-job latency histograms and metrics export
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef METRICS_H
+#define METRICS_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Each power of two is split into 2^4 buckets, so a recorded latency is off
+   by at most 1/16 (~6%), from 1 ns up to the whole 64-bit range */
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) \
+    * HISTOGRAM_SUB_BUCKETS)
+
+/* The phases of a job */
+#define PHASE_LOAD 0        // creating the microputer and its devices
+#define PHASE_DECODE 1      // loading the program and writing the listing
+#define PHASE_EXECUTE 2     // running it
+#define PHASE_OUTPUT 3      // writing the reports asked for
+#define NUM_PHASES 4
+/* -M rewrites its file at most this often while jobs run, and at exit */
+#define METRICS_WRITE_INTERVAL_NS 1000000000ull
+
+/*********************** Metrics Structs & Types ******************************/
+
+/* HDR-style log-linear histogram of latencies in nanoseconds */
+struct latency_histogram_s {
+    uint64_t counts[ HISTOGRAM_BUCKETS ];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} typedef latency_histogram_t;
+
+/* Everything recorded about the jobs run so far */
+struct metrics_s {
+    latency_histogram_t phases[ NUM_PHASES ];
+    uint64_t jobs;
+    uint64_t failed_jobs;
+    /* Simulated instructions executed by all jobs */
+    uint64_t instructions;
+    /* Listing lines kept from (hits) or redone after (misses) the last run */
+    uint64_t listing_hits;
+    uint64_t listing_misses;
+    /* When the metrics were created, for the rates */
+    uint64_t start_ns;
+} typedef metrics_t;
+
+/************************ Public Metrics Functions ****************************/
+
+int create_metrics(metrics_t ** out_metrics_pp);
+int delete_metrics(metrics_t ** metrics_pp);
+uint64_t metrics_now_ns(void);
+void record_latency(latency_histogram_t * hist_p, uint64_t ns);
+uint64_t latency_percentile(const latency_histogram_t * hist_p, double q);
+void record_job(metrics_t * metrics_p, const uint64_t * phase_ends_p,
+    uint64_t instructions, int result);
+int write_prometheus_metrics(const metrics_t * metrics_p,
+    const char * metrics_file_name_p);
+
+#endif
@@ -9,7 +9,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "microputer.h"
+#include "devices.h"
+#include "debugger.h"
+#include "coverage.h"
 
 /**************************** Constants ***************************************/
 
@@ -23,9 +30,6 @@
 /* Prints the function name at the end of the function */
 #define END_FUNC printf( "\n\t EXIT: [%s] (Ln.%d)\t-\n", __func__, __LINE__ )
 
-/* Max characters per line in the .asm file */
-#define MAX_ASM_LINE_LEN 15
-
 /************************* Testing Utility ************************************/
 
 #ifdef TEST_MODE
@@ -67,15 +71,12 @@ int create_microputer(microputer_t ** out_mp_pp)
         printf( "\t# [ERROR: malloc failed to allocate for *out_mp_pp] #\n" );
         return ERROR; 
     }
-    /* Wipe any existing memory */
-    memset( *out_mp_pp, 0, sizeof( microputer_t ) );
-
-    /* Setting the PC register to the first word boundary of memory */
-    (*out_mp_pp)->pc = 0;                            
-    /* Setting the IR register to 0 (NIL), no instruction executing currently */
-    (*out_mp_pp)->ir = 0;     
-    /* Setting the number of currently loaded instructions to 0 */
-    (*out_mp_pp)->loaded_mem_slots = 0; 
+    if (init_microputer( *out_mp_pp ) != SUCCESS)
+    {
+        free( *out_mp_pp );
+        *out_mp_pp = NULL;
+        return ERROR;
+    }
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -84,6 +85,53 @@ int create_microputer(microputer_t ** out_mp_pp)
     return SUCCESS;
 }
 
+/// @brief Sets up a microputer in memory the caller owns (e.g. an arena),
+/// as create_microputer does; it is never passed to delete_microputer
+/// @param mp_p microputer pointer
+/// @return 1 if SUCCESS, otherwise ERROR
+int init_microputer(microputer_t * mp_p)
+{
+    /* Wipe any existing memory */
+    memset( mp_p, 0, sizeof( microputer_t ) );
+
+    /* Setting the PC register to the first word boundary of memory */
+    mp_p->pc = 0;                            
+    /* Setting the IR register to 0 (NIL), no instruction executing currently */
+    mp_p->ir = 0;     
+    /* Setting the number of currently loaded instructions to 0 */
+    mp_p->loaded_mem_slots = 0; 
+    /* Instructions are fetched from the microputer's own memory */
+    mp_p->mem_p = mp_p->mem;
+    /* The timer is not armed and no loop has been seen */
+    mp_p->next_event = NO_EVENT;
+    mp_p->idle_pc = NO_PC;
+    /* PRT/RDD go to the console unless another bus is attached */
+    mp_p->bus_p = default_io_bus();
+    if (mp_p->bus_p == NULL)
+    {
+        printf( "\t# [ERROR: could not create the default io bus] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Puts a microputer back in the state create_microputer left it
+/// in, keeping its instruction set and bus, so one can run job after job
+/// @param mp_p microputer pointer
+void reset_microputer(microputer_t * mp_p)
+{
+    instruction_t instr_set[ NUM_INSTRUCTIONS ];
+    struct io_bus_s * bus_p = mp_p->bus_p;
+
+    memcpy( instr_set, mp_p->instr_set, sizeof( instr_set ) );
+    memset( mp_p, 0, sizeof( microputer_t ) );
+    memcpy( mp_p->instr_set, instr_set, sizeof( instr_set ) );
+    mp_p->mem_p = mp_p->mem;
+    mp_p->next_event = NO_EVENT;
+    mp_p->idle_pc = NO_PC;
+    mp_p->bus_p = bus_p;
+}
+
 /// @brief Frees the memory allocated for the microputer struct
 /// @param mp_pp a pointer to a pointer of the microputer
 /// @return 1 if SUCCESS, otherwise ERROR
@@ -131,6 +179,13 @@ int write_assembly_file(char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ],
     int result = SUCCESS;
     int i = 0;
 
+    if (!file_p)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            asm_file_name_p );
+        return ERROR;
+    }
+
     #if TEST_MODE == 1 
         printf( "\n\tASSEMBLY INSTRUCTIONS: \n" );
     #endif
@@ -169,72 +224,133 @@ int write_assembly_file(char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ],
     return result;
 }
 
-/// @brief Loads the program into memory and disassembles the program
+/// @brief Loads the machine code file into memory, without disassembling it
 /// @param mp_p microputer pointer
 /// @param bin_file_name_p the machine code file
-/// @param asm_file_name_p the assembly file  
 /// @return 1 if SUCCESS, otherwise ERROR
-int disassemble_micro_program(microputer_t * mp_p, 
-    const char * bin_file_name_p, const char * asm_file_name_p)
+int load_micro_program(microputer_t * mp_p, const char * bin_file_name_p)
 {
     #if TEST_MODE == 1
         START_FUNC;
     #endif 
 
     FILE * file_p = fopen( bin_file_name_p, "rb" );
-    byte_t op_code = 0;
-    uint16_t instr = 0;
-    int result = SUCCESS;
-    int counter = 0;
-    /* Declaring a pointer to an array (i.e. 2D array) to use as buffer*/
-    char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ] = 
-        (char (*)[]) malloc( sizeof( asm_file_buffer_p ) 
-            * (MEM_BYTE_SIZE / WORD_SIZE) );
+    size_t counter = 0;
 
     if (!file_p) 
     {
         printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
             bin_file_name_p );
-        result = ERROR;
-        goto EXIT_FUNC;
+        return ERROR;
     }
-    
-    while (fread( &mp_p->mem[ counter ], 
-        sizeof( char ), 1, file_p ) == 1 && counter < MEM_BYTE_SIZE) 
-    {
-        #if TEST_MODE == 1
-            printf( "Memory [%d]{ ", counter );
-            bitify( mp_p->mem[ counter ], 1 );
+
+    /* Anything past the end of memory is ignored */
+    memset( mp_p->mem, 0, MEM_BYTE_SIZE );
+    counter = fread( mp_p->mem, sizeof( byte_t ), MEM_BYTE_SIZE, file_p );
+    fclose( file_p );
+
+    #if TEST_MODE == 1
+        for (size_t i = 0; i < counter; i++)
+        {
+            printf( "Memory [%d]{ ", (int) i );
+            bitify( mp_p->mem[ i ], 1 );
             printf( " }\n" );
-        #endif
+        }
+    #endif
 
-        if ( (counter + 1) % 2 == 0 )
-        {
-            instr = mp_p->mem[ counter - 1 ] << 8;  // higher order bits
-            instr |= mp_p->mem[ counter ];          // lower order bits
-            op_code = (byte_t) ((instr & (0b111 << 13)) >> 13);
-
-            #if TEST_MODE == 1
-                printf( "Instruction: \n" );
-                printf( "\top_code: %d\n", op_code );
-                printf( "\tinstr:   " );
-                bitify( instr, 2 );
-                printf( "\n" );
-            #endif
-            /* Call the instruction's disassembler; no need to error check
-               since any series of bits is translatable */
-            (*mp_p->instr_set[ op_code ].disassembler)( 
-                instr, asm_file_buffer_p[ counter / 2 ] );
-        }   
-        counter++;
-    }
     /* Setting the PC register to the first word boundary of memory */
     mp_p->pc = 0;        
-    mp_p->loaded_mem_slots = counter;   
-    write_assembly_file( asm_file_buffer_p, asm_file_name_p, counter / 2 );
+    mp_p->loaded_mem_slots = (byte_t) counter;   
+    mp_p->halted = 0;
+
+    #if TEST_MODE == 1
+        END_FUNC;
+    #endif 
+
+    return SUCCESS;
+}
+
+/// @brief Reads the instruction word at the given word index of memory
+/// @param mp_p microputer pointer
+/// @param word_index index of the word (i.e. byte address / 2)
+/// @return the 16-bit binary instruction
+static uint16_t fetch_word(microputer_t * mp_p, byte_t word_index)
+{
+    return (uint16_t) ((mp_p->mem[ word_index * WORD_SIZE ] << 8) 
+        | mp_p->mem[ word_index * WORD_SIZE + 1 ]);
+}
+
+/// @brief Disassembles a single instruction word into a listing line
+/// @param mp_p microputer pointer
+/// @param instr the 16-bit binary instruction
+/// @param out_line_buffer_p pointer to a assembly instruction string 
+static void disassemble_word(microputer_t * mp_p, uint16_t instr, 
+    char * out_line_buffer_p)
+{
+    byte_t op_code = (byte_t) ((instr & (0b111 << 13)) >> 13);
+
+    #if TEST_MODE == 1
+        printf( "Instruction: \n" );
+        printf( "\top_code: %d\n", op_code );
+        printf( "\tinstr:   " );
+        bitify( instr, 2 );
+        printf( "\n" );
+    #endif
+
+    /* Call the instruction's disassembler; no need to error check
+       since any series of bits is translatable */
+    out_line_buffer_p[ 0 ] = '\0';
+    (*mp_p->instr_set[ op_code ].disassembler)( instr, out_line_buffer_p );
+}
+
+/// @brief Loads the program into memory and disassembles the program
+/// @param mp_p microputer pointer
+/// @param bin_file_name_p the machine code file
+/// @param asm_file_name_p the assembly file  
+/// @param annotate 1 = write labels and cross-references, 0 = plain listing
+/// @return 1 if SUCCESS, otherwise ERROR
+static int disassemble_to_file(microputer_t * mp_p, 
+    const char * bin_file_name_p, const char * asm_file_name_p, 
+    byte_t annotate)
+{
+    #if TEST_MODE == 1
+        START_FUNC;
+    #endif 
+
+    int result = SUCCESS;
+    byte_t num_words = 0;
+    /* Declaring a pointer to an array (i.e. 2D array) to use as buffer*/
+    char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ] = 
+        (char (*)[]) malloc( sizeof( *asm_file_buffer_p ) * MEM_WORD_COUNT );
+
+    if (asm_file_buffer_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate asm buffer] #\n" );
+        return ERROR;
+    }
+
+    result = load_micro_program( mp_p, bin_file_name_p );
+    if (result != SUCCESS)
+    {
+        goto EXIT_FUNC;
+    }
+
+    /* Only complete words are disassembled */
+    num_words = mp_p->loaded_mem_slots / WORD_SIZE;
+    for (byte_t i = 0; i < num_words; i++)
+    {
+        disassemble_word( mp_p, fetch_word( mp_p, i ), asm_file_buffer_p[ i ] );
+    }
+    if (annotate)
+    {
+        result = write_annotated_assembly_file( mp_p, asm_file_buffer_p, 
+            asm_file_name_p, num_words );
+    } else 
+    {
+        write_assembly_file( asm_file_buffer_p, asm_file_name_p, num_words );
+    }
 
 EXIT_FUNC:
-    fclose( file_p );
     free( asm_file_buffer_p );
 
     #if TEST_MODE == 1
@@ -244,21 +360,248 @@ EXIT_FUNC:
     return result;
 }
 
+/// @brief Loads the program into memory and disassembles the program
+/// @param mp_p microputer pointer
+/// @param bin_file_name_p the machine code file
+/// @param asm_file_name_p the assembly file  
+/// @return 1 if SUCCESS, otherwise ERROR
+int disassemble_micro_program(microputer_t * mp_p, 
+    const char * bin_file_name_p, const char * asm_file_name_p)
+{
+    return disassemble_to_file( mp_p, bin_file_name_p, asm_file_name_p, 0 );
+}
+
+/// @brief Loads the program into memory and writes an annotated listing 
+/// with labels at branch targets, cross-references and loop markers
+/// @param mp_p microputer pointer
+/// @param bin_file_name_p the machine code file
+/// @param asm_file_name_p the assembly file  
+/// @return 1 if SUCCESS, otherwise ERROR
+int disassemble_annotated_micro_program(microputer_t * mp_p, 
+    const char * bin_file_name_p, const char * asm_file_name_p)
+{
+    return disassemble_to_file( mp_p, bin_file_name_p, asm_file_name_p, 1 );
+}
+
+/// @brief Formats one line of a listing exactly as write_assembly_file does
+/// @param listing_p the listing
+/// @param i the line index
+/// @param out_line_p buffer of at least MAX_ASM_LINE_LEN + 6 chars
+/// @return the length of the formatted line
+static int format_listing_line(const asm_listing_t * listing_p, byte_t i, 
+    char * out_line_p)
+{
+    return sprintf( out_line_p, "%d: %s%s", i * 2, listing_p->lines[ i ],
+        i < listing_p->num_words - 1 ? "\n" : "" );
+}
+
+/// @brief Loads a (patched) program into memory and brings the listing and 
+/// its .asm file up to date, re-disassembling only the words that changed
+/// @param mp_p microputer pointer
+/// @param listing_p the listing from the previous disassembly (may be invalid)
+/// @param bin_file_name_p the machine code file
+/// @param asm_file_name_p the assembly file the listing was written to
+/// @return 1 if SUCCESS, otherwise ERROR
+int update_micro_listing(microputer_t * mp_p, asm_listing_t * listing_p,
+    const char * bin_file_name_p, const char * asm_file_name_p)
+{
+    #if TEST_MODE == 1
+        START_FUNC;
+    #endif 
+
+    FILE * file_p = NULL;
+    char line[ MAX_ASM_LINE_LEN + 6 ];
+    byte_t changed[ MEM_WORD_COUNT ] = { 0 };
+    byte_t old_words = listing_p->valid ? listing_p->num_words : 0;
+    byte_t new_words = 0;
+    byte_t tail = 0;
+    uint16_t instr = 0;
+    int len = 0;
+    int result = load_micro_program( mp_p, bin_file_name_p );
+
+    if (result != SUCCESS)
+    {
+        return result;
+    }
+    new_words = mp_p->loaded_mem_slots / WORD_SIZE;
+    listing_p->num_words = new_words;
+    listing_p->num_reused = new_words;
+
+    /* Re-disassemble only the words that differ from the previous image */
+    for (byte_t i = 0; i < new_words; i++)
+    {
+        instr = fetch_word( mp_p, i );
+        if (i >= old_words || listing_p->words[ i ] != instr)
+        {
+            listing_p->words[ i ] = instr;
+            disassemble_word( mp_p, instr, listing_p->lines[ i ] );
+            changed[ i ] = 1;
+            listing_p->num_reused--;
+        }
+    }
+
+    /* Everything from the first line that moves has to be rewritten; a change
+       in line count also moves the old last line's missing newline */
+    tail = new_words < old_words ? new_words : old_words;
+    if (new_words != old_words && tail > 0)
+    {
+        tail--;
+    }
+    for (byte_t i = 0; i < tail; i++)
+    {
+        if (changed[ i ] && format_listing_line( listing_p, i, line ) 
+            != listing_p->offsets[ i + 1 ] - listing_p->offsets[ i ])
+        {
+            tail = i;
+            break;
+        }
+    }
+
+    /* Only patch in place if the file still is the one the listing describes */
+    if (old_words > 0)
+    {
+        file_p = fopen( asm_file_name_p, "r+b" );
+    }
+    if (file_p && (fseek( file_p, 0, SEEK_END ) != 0 
+        || ftell( file_p ) != listing_p->offsets[ old_words ]))
+    {
+        fclose( file_p );
+        file_p = NULL;
+    }
+    if (!file_p)
+    {
+        tail = 0;
+        file_p = fopen( asm_file_name_p, "wb" );
+    }
+    if (!file_p)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            asm_file_name_p );
+        listing_p->valid = 0;
+        return ERROR;
+    }
+
+    /* Patch the changed lines that kept their length at their old offsets */
+    for (byte_t i = 0; i < tail; i++)
+    {
+        if (changed[ i ])
+        {
+            len = format_listing_line( listing_p, i, line );
+            fseek( file_p, listing_p->offsets[ i ], SEEK_SET );
+            fwrite( line, 1, len, file_p );
+        }
+    }
+
+    /* Rewrite the tail and truncate whatever the old listing left behind */
+    listing_p->offsets[ 0 ] = 0;
+    fseek( file_p, listing_p->offsets[ tail ], SEEK_SET );
+    for (byte_t i = tail; i < new_words; i++)
+    {
+        len = format_listing_line( listing_p, i, line );
+        fwrite( line, 1, len, file_p );
+        listing_p->offsets[ i + 1 ] = listing_p->offsets[ i ] + len;
+    }
+    fflush( file_p );
+    if (ferror( file_p ) || ftruncate( fileno( file_p ), 
+        listing_p->offsets[ new_words ] ) != 0)
+    {
+        printf( "\t# [ERROR: Can not write buffer to .asm file!] #\n" );
+        result = ERROR;
+    }
+    fclose( file_p );
+    listing_p->valid = (result == SUCCESS);
+
+    #if TEST_MODE == 1
+        END_FUNC;
+    #endif 
+
+    return result;
+}
+
+/// @brief Saves a listing so a later run can update it incrementally
+/// @param listing_p the listing
+/// @param lst_file_name_p the file to save it to
+/// @return 1 if SUCCESS, otherwise ERROR
+int save_micro_listing(const asm_listing_t * listing_p, 
+    const char * lst_file_name_p)
+{
+    FILE * file_p = fopen( lst_file_name_p, "wb" );
+    int result = SUCCESS;
+
+    if (!file_p)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            lst_file_name_p );
+        return ERROR;
+    }
+    if (fwrite( listing_p, sizeof( asm_listing_t ), 1, file_p ) != 1)
+    {
+        result = ERROR;
+    }
+    fclose( file_p );
+    return result;
+}
+
+/// @brief Loads a listing saved by save_micro_listing; a missing or damaged 
+/// file just leaves the listing invalid so the next update is a full one
+/// @param listing_p the listing
+/// @param lst_file_name_p the file to load it from
+/// @return 1 if SUCCESS, otherwise ERROR
+int load_micro_listing(asm_listing_t * listing_p, 
+    const char * lst_file_name_p)
+{
+    FILE * file_p = fopen( lst_file_name_p, "rb" );
+
+    memset( listing_p, 0, sizeof( asm_listing_t ) );
+    if (!file_p)
+    {
+        return ERROR;
+    }
+    if (fread( listing_p, sizeof( asm_listing_t ), 1, file_p ) != 1 
+        || listing_p->num_words > MEM_WORD_COUNT)
+    {
+        memset( listing_p, 0, sizeof( asm_listing_t ) );
+    }
+    fclose( file_p );
+    return listing_p->valid ? SUCCESS : ERROR;
+}
+
 /// @brief Executes the microprogram on the passed microputer
 /// @param mp_p microputer pointer
 /// @return 1 if SUCCESS, otherwise ERROR
 int execute_micro_program(microputer_t * mp_p)
+{
+    return execute_micro_program_budget( mp_p, RUN_UNBOUNDED );
+}
+
+/// @brief Executes up to budget instructions of the microprogram with the
+/// reference interpreter (e.g. to time it against the other engines)
+/// @param mp_p microputer pointer
+/// @param budget the max number of instructions to execute
+/// @return 1 if SUCCESS, otherwise ERROR
+int execute_micro_program_budget(microputer_t * mp_p, uint64_t budget)
 {
     #if TEST_MODE == 1
         START_FUNC;
     #endif 
 
+    uint64_t end = budget > UINT64_MAX - mp_p->cycles ? 
+        UINT64_MAX : mp_p->cycles + budget;
     byte_t op_code;
+    uint16_t instr_pc;
+    mp_p->engine = ENGINE_REFERENCE;
     do
     {
+        if (mp_p->cycles >= end)
+        {
+            mp_p->engine = ENGINE_IDLE;
+            return SUCCESS;
+        }
+        instr_pc = mp_p->pc;
+        mp_p->sample_pc = instr_pc;
         /* Combining the higher and lower order bits to into one value */
-        mp_p->ir = mp_p->mem[ mp_p->pc++ ] << 8;      // higher order bits
-        mp_p->ir |= mp_p->mem[ mp_p->pc++ ];          // lower order bits
+        mp_p->ir = mp_p->mem_p[ mp_p->pc++ ] << 8;    // higher order bits
+        mp_p->ir |= mp_p->mem_p[ mp_p->pc++ ];        // lower order bits
         op_code = (byte_t) ((mp_p->ir & (0b111 << 13)) >> 13);
 
         /* Call the instruction's handler and check for runtime errors */
@@ -266,9 +609,19 @@ int execute_micro_program(microputer_t * mp_p)
         {
             printf( "\t# [ERROR: %hu handler returned error code!] #\n", 
                 (uint16_t) op_code );
+            mp_p->engine = ENGINE_IDLE;
             return ERROR;
         }
+        mp_p->cycles++;
+
+        /* A BLT ends a block; the only place interrupts are taken */
+        if (op_code == 0b111 && mp_p->next_event != NO_EVENT)
+        {
+            end_of_block( mp_p, instr_pc );
+        }
     } while (mp_p->pc < mp_p->loaded_mem_slots);
+    mp_p->halted = 1;
+    mp_p->engine = ENGINE_IDLE;
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -277,6 +630,291 @@ int execute_micro_program(microputer_t * mp_p)
     return SUCCESS;
 }
 
+/// @brief Called after every BLT while the timer is armed. Takes the timer
+/// interrupt if it is due, and fast-forwards time when the program is in a
+/// loop that can only be left by an interrupt: a backward branch reached 
+/// again with the same registers and no I/O in between would repeat 
+/// forever, so the cycles until the next event are skipped, not executed
+/// @param mp_p microputer pointer
+/// @param branch_pc the address of the BLT
+void end_of_block(microputer_t * mp_p, uint16_t branch_pc)
+{
+    if (mp_p->in_interrupt)
+    {
+        /* Not interruptible, so no loop in here is waiting on the timer */
+        return;
+    }
+
+    if (mp_p->pc <= branch_pc)
+    {
+        if (mp_p->idle_pc == branch_pc && mp_p->idle_io_count == mp_p->io_count
+            && memcmp( mp_p->idle_reg, mp_p->reg, NUM_REGISTERS ) == 0
+            && mp_p->cycles < mp_p->next_event)
+        {
+            mp_p->skipped_cycles += mp_p->next_event - mp_p->cycles;
+            mp_p->cycles = mp_p->next_event;
+        } else 
+        {
+            mp_p->idle_pc = branch_pc;
+            mp_p->idle_io_count = mp_p->io_count;
+            memcpy( mp_p->idle_reg, mp_p->reg, NUM_REGISTERS );
+        }
+    }
+
+    if (mp_p->cycles >= mp_p->next_event)
+    {
+        mp_p->saved_pc = mp_p->pc;
+        mp_p->pc = mp_p->irq_vector;
+        mp_p->in_interrupt = 1;
+        mp_p->idle_pc = NO_PC;
+        /* A handler that overran its period doesn't get a backlog */
+        mp_p->next_event += mp_p->timer_period;
+        if (mp_p->next_event <= mp_p->cycles)
+        {
+            mp_p->next_event = mp_p->cycles + mp_p->timer_period;
+        }
+    }
+}
+
+/* The run loop stops in front of RDD, and PRT to a device whose writes 
+   can't be deferred, instead of executing them */
+#define RUN_STOP_AT_INPUT 0x1
+/* The run loop checks the attached debugger's breakpoints and watchpoints */
+#define RUN_DEBUG 0x2
+/* The run loop records executed words and BLT edges in the coverage */
+#define RUN_COVERAGE 0x4
+
+/// @brief Finds the registers an instruction changed
+/// @param before_p the register file before the instruction
+/// @param after_p the register file after it
+/// @return bit i set if Ri differs
+static inline uint16_t changed_registers(const byte_t * before_p, 
+    const byte_t * after_p)
+{
+#ifdef __SSE2__
+    /* The whole 16 byte register file in one compare */
+    __m128i before = _mm_loadu_si128( (const __m128i *) before_p );
+    __m128i after = _mm_loadu_si128( (const __m128i *) after_p );
+    return (uint16_t) ~_mm_movemask_epi8( _mm_cmpeq_epi8( before, after ) );
+#else
+    uint16_t mask = 0;
+    for (byte_t i = 0; i < NUM_REGISTERS; i++)
+    {
+        mask |= (uint16_t) ((before_p[ i ] != after_p[ i ]) << i);
+    }
+    return mask;
+#endif
+}
+
+/// @brief Executes up to budget instructions of the loaded program; the 
+/// flags are constant at every call site so each use gets its own copy
+/// @param mp_p microputer pointer
+/// @param budget the max number of instructions to execute
+/// @param flags RUN_* flags
+/// @return 1 if SUCCESS, otherwise ERROR
+static inline int run_loop(microputer_t * mp_p, uint64_t budget, 
+    const int flags)
+{
+    uint64_t end = budget > UINT64_MAX - mp_p->cycles ? 
+        UINT64_MAX : mp_p->cycles + budget;
+    debugger_t * dbg_p = (flags & RUN_DEBUG) ? mp_p->debugger_p : NULL;
+    coverage_t * cov_p = (flags & RUN_COVERAGE) ? mp_p->coverage_p : NULL;
+    uint32_t word_bit;
+    byte_t before[ NUM_REGISTERS ];
+    uint16_t changed;
+    uint16_t instr;
+    uint16_t instr_pc;
+    byte_t op_code;
+
+    mp_p->engine = ENGINE_RUN_LOOP + flags;
+    if (flags & RUN_DEBUG)
+    {
+        dbg_p->stop_reason = STOP_NONE;
+    }
+
+    while (mp_p->pc < mp_p->loaded_mem_slots)
+    {
+        if (mp_p->cycles >= end)
+        {
+            return SUCCESS;
+        }
+        instr = (uint16_t) ((mp_p->mem_p[ mp_p->pc ] << 8) 
+            | mp_p->mem_p[ mp_p->pc + 1 ]);
+        op_code = (byte_t) (instr >> 13);
+
+        /* RDD (0b110) and undeferrable PRT (0b101) are left for the caller */
+        if ((flags & RUN_STOP_AT_INPUT) && (op_code == 0b110 
+            || (op_code == 0b101 && !mp_p->bus_p->port_map[ 
+                (instr >> 1) & 0xFF ]->deferrable)))
+        {
+            return SUCCESS;
+        }
+
+        if (flags & RUN_DEBUG)
+        {
+            uint16_t word = mp_p->pc / WORD_SIZE;
+            if ((dbg_p->breakpoints[ word / 32 ] & (1u << (word % 32)))
+                && !dbg_p->resume_over)
+            {
+                dbg_p->stop_reason = STOP_BREAKPOINT;
+                dbg_p->stop_pc = mp_p->pc;
+                dbg_p->resume_over = 1;
+                return SUCCESS;
+            }
+            dbg_p->resume_over = 0;
+            memcpy( before, mp_p->reg, NUM_REGISTERS );
+        }
+
+        mp_p->ir = instr;
+        instr_pc = mp_p->pc;
+        mp_p->sample_pc = instr_pc;
+        mp_p->pc += WORD_SIZE;
+        if ((*mp_p->instr_set[ op_code ].handler)( mp_p ) != SUCCESS)
+        {
+            printf( "\t# [ERROR: %hu handler returned error code!] #\n", 
+                (uint16_t) op_code );
+            return ERROR;
+        }
+        mp_p->cycles++;
+
+        if (flags & RUN_COVERAGE)
+        {
+            word_bit = 1u << (instr_pc / WORD_SIZE % 32);
+            cov_p->executed[ instr_pc / WORD_SIZE / 32 ] |= word_bit;
+            if (op_code == 0b111)
+            {
+                if (mp_p->pc != instr_pc + WORD_SIZE)
+                {
+                    cov_p->taken[ instr_pc / WORD_SIZE / 32 ] |= word_bit;
+                } else 
+                {
+                    cov_p->not_taken[ instr_pc / WORD_SIZE / 32 ] |= word_bit;
+                }
+            }
+        }
+
+        if ((flags & RUN_DEBUG) && dbg_p->watch_mask)
+        {
+            changed = changed_registers( before, mp_p->reg ) 
+                & dbg_p->watch_mask;
+            if (changed)
+            {
+                dbg_p->stop_reason = STOP_WATCHPOINT;
+                dbg_p->stop_pc = instr_pc;
+                dbg_p->changed_mask = changed;
+                memcpy( dbg_p->old_reg, before, NUM_REGISTERS );
+                return SUCCESS;
+            }
+        }
+
+        /* A BLT ends a block; the only place interrupts are taken */
+        if (op_code == 0b111 && mp_p->next_event != NO_EVENT)
+        {
+            end_of_block( mp_p, instr_pc );
+        }
+    }
+    mp_p->halted = 1;
+
+    return SUCCESS;
+}
+
+/// @brief Executes up to budget instructions of the loaded program, so it
+/// can be suspended and resumed later from its pc and registers. With a 
+/// debugger attached the debug engine runs instead, which returns early 
+/// when a breakpoint or watchpoint is hit (see debugger_t.stop_reason), and
+/// with coverage attached the coverage engine runs
+/// @param mp_p microputer pointer
+/// @param budget the max number of instructions, or RUN_UNBOUNDED
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_micro_program(microputer_t * mp_p, uint64_t budget)
+{
+    int result;
+
+    /* Chosen once per call; the common case never sees the checks */
+    switch ((mp_p->debugger_p != NULL) | (mp_p->coverage_p != NULL) << 1)
+    {
+        case 0: result = run_loop( mp_p, budget, 0 ); break;
+        case 1: result = run_loop( mp_p, budget, RUN_DEBUG ); break;
+        case 2: result = run_loop( mp_p, budget, RUN_COVERAGE ); break;
+        default: 
+            result = run_loop( mp_p, budget, RUN_DEBUG | RUN_COVERAGE );
+    }
+    mp_p->engine = ENGINE_IDLE;
+    return result;
+}
+
+/// @brief Like run_micro_program, but stops in front of the first RDD (or
+/// PRT to a device that can't defer writes); with an io_log attached 
+/// nothing it runs has a visible side effect, so it can run on any thread
+/// @param mp_p microputer pointer
+/// @param budget the max number of instructions, or RUN_UNBOUNDED
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_micro_program_until_input(microputer_t * mp_p, uint64_t budget)
+{
+    int result;
+
+    if (mp_p->coverage_p != NULL)
+    {
+        result = run_loop( mp_p, budget, RUN_STOP_AT_INPUT | RUN_COVERAGE );
+    } else 
+    {
+        result = run_loop( mp_p, budget, RUN_STOP_AT_INPUT );
+    }
+    mp_p->engine = ENGINE_IDLE;
+    return result;
+}
+
+/// @brief Allocates a log for capacity buffered PRT lines
+/// @param log_p the log
+/// @param capacity the max number of lines held before a flush
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_io_log(io_log_t * log_p, uint64_t capacity)
+{
+    log_p->ports_p = (byte_t *) malloc( capacity );
+    log_p->regs_p = (byte_t *) malloc( capacity );
+    log_p->values_p = (byte_t *) malloc( capacity );
+    log_p->count = 0;
+    log_p->capacity = capacity;
+    if (log_p->ports_p == NULL || log_p->regs_p == NULL 
+        || log_p->values_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate io log] #\n" );
+        delete_io_log( log_p );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Frees a log created by create_io_log
+/// @param log_p the log
+void delete_io_log(io_log_t * log_p)
+{
+    free( log_p->ports_p );
+    free( log_p->regs_p );
+    free( log_p->values_p );
+    memset( log_p, 0, sizeof( io_log_t ) );
+}
+
+/// @brief Applies a microputer's buffered PRTs to their devices, oldest 
+/// first, and empties its log
+/// @param mp_p microputer pointer
+/// @return 1 if SUCCESS, otherwise ERROR
+int flush_io_log(microputer_t * mp_p)
+{
+    io_log_t * log_p = mp_p->io_log_p;
+    int result = SUCCESS;
+
+    for (uint64_t i = 0; i < log_p->count && result == SUCCESS; i++)
+    {
+        device_t * dev_p = mp_p->bus_p->port_map[ log_p->ports_p[ i ] ];
+        result = dev_p->write( dev_p, mp_p, 
+            log_p->ports_p[ i ] - dev_p->base_port, log_p->regs_p[ i ], 
+            log_p->values_p[ i ] );
+    }
+    log_p->count = 0;
+    return result;
+}
+
 /*******************************************************************************
  *                  Instruction Args Extractor Functions
  ******************************************************************************/
@@ -329,6 +967,7 @@ void prt_extract_instr_args(uint16_t instr, byte_t * out_instr_args_p)
     #endif 
 
     out_instr_args_p[ 0 ] = (byte_t) ((instr & (0xF << 9)) >> 9);
+    out_instr_args_p[ 1 ] = (byte_t) ((instr & (0xFF << 1)) >> 1);  // port
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -345,6 +984,7 @@ void rdd_extract_instr_args(uint16_t instr, byte_t * out_instr_args_p)
     #endif 
 
     out_instr_args_p[ 0 ] = (byte_t) ((instr & (0xF << 9)) >> 9);
+    out_instr_args_p[ 1 ] = (byte_t) ((instr & (0xFF << 1)) >> 1);  // port
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -369,6 +1009,163 @@ void blt_extract_instr_args(uint16_t instr, byte_t * out_instr_args_p)
     #endif 
 }
 
+/*******************************************************************************
+ *                          Predecoded Engine
+ ******************************************************************************/
+
+/// @brief Decodes each word of the loaded program once, so the loop never 
+/// has to fetch, shift or mask; instructions that talk to devices, and
+/// branches the handler would reject, keep going through their handler
+/// @param mp_p microputer pointer
+/// @param out_code_p the decoded program, one entry per word
+static void predecode(microputer_t * mp_p, decoded_instr_t * out_code_p)
+{
+    byte_t args[ 4 ];
+
+    /* An odd sized program still runs its last, half loaded word */
+    for (byte_t i = 0; i < (mp_p->loaded_mem_slots + 1) / WORD_SIZE; i++)
+    {
+        decoded_instr_t * code_p = &out_code_p[ i ];
+        code_p->instr = (uint16_t) ((mp_p->mem_p[ i * WORD_SIZE ] << 8) 
+            | mp_p->mem_p[ i * WORD_SIZE + 1 ]);
+        code_p->op_code = (byte_t) (code_p->instr >> 13);
+        switch (code_p->op_code)
+        {
+            case 0b000:
+                ldi_extract_instr_args( code_p->instr, args );
+                code_p->a = args[ 0 ];
+                code_p->b = args[ 1 ];
+                break;
+            case 0b001: case 0b010: case 0b011: case 0b100:
+                bit_op_extract_instr_args( code_p->instr, args );
+                code_p->a = args[ 1 ];
+                code_p->b = args[ 2 ];
+                code_p->c = args[ 3 ];
+                break;
+            case 0b111:
+                blt_extract_instr_args( code_p->instr, args );
+                code_p->a = args[ 0 ];
+                code_p->b = args[ 1 ];
+                code_p->c = args[ 2 ];
+                if (code_p->c % 2 != 0)
+                {
+                    code_p->op_code = DECODED_HANDLER;
+                }
+                break;
+            default:
+                code_p->op_code = DECODED_HANDLER;
+        }
+    }
+}
+
+/// @brief Executes up to budget instructions of the loaded program from a
+/// predecoded copy, switching on the decoded op instead of calling through
+/// the instruction set; decoding costs a pass over the program per call
+/// @param mp_p microputer pointer
+/// @param budget the max number of instructions to execute
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_predecoded_micro_program(microputer_t * mp_p, uint64_t budget)
+{
+    uint64_t end = budget > UINT64_MAX - mp_p->cycles ? 
+        UINT64_MAX : mp_p->cycles + budget;
+    decoded_instr_t code[ MEM_WORD_COUNT ];
+    const decoded_instr_t * code_p;
+    byte_t * reg_p = mp_p->reg;
+    uint16_t instr_pc;
+
+    predecode( mp_p, code );
+    mp_p->engine = ENGINE_PREDECODED;
+    while (mp_p->pc < mp_p->loaded_mem_slots)
+    {
+        if (mp_p->cycles >= end)
+        {
+            mp_p->engine = ENGINE_IDLE;
+            return SUCCESS;
+        }
+        /* Only word aligned code was decoded */
+        if (mp_p->pc % WORD_SIZE != 0)
+        {
+            mp_p->engine = ENGINE_IDLE;
+            return run_micro_program( mp_p, end - mp_p->cycles );
+        }
+        instr_pc = mp_p->pc;
+        code_p = &code[ instr_pc / WORD_SIZE ];
+        mp_p->sample_pc = instr_pc;
+        mp_p->ir = code_p->instr;
+        mp_p->pc += WORD_SIZE;
+
+        switch (code_p->op_code)
+        {
+            case 0b000: reg_p[ code_p->a ] = code_p->b; break;
+            case 0b001: reg_p[ code_p->c ] = reg_p[ code_p->a ] 
+                + reg_p[ code_p->b ]; break;
+            case 0b010: reg_p[ code_p->c ] = reg_p[ code_p->a ] 
+                & reg_p[ code_p->b ]; break;
+            case 0b011: reg_p[ code_p->c ] = reg_p[ code_p->a ] 
+                | reg_p[ code_p->b ]; break;
+            case 0b100: reg_p[ code_p->c ] = reg_p[ code_p->a ] 
+                ^ reg_p[ code_p->b ]; break;
+            case 0b111:
+                if (reg_p[ code_p->a ] < reg_p[ code_p->b ])
+                {
+                    mp_p->pc = code_p->c;
+                }
+                break;
+            default:
+                if ((*mp_p->instr_set[ code_p->instr >> 13 ].handler)( mp_p ) 
+                    != SUCCESS)
+                {
+                    printf( "\t# [ERROR: %hu handler returned error code!] "
+                        "#\n", (uint16_t) (code_p->instr >> 13) );
+                    mp_p->engine = ENGINE_IDLE;
+                    return ERROR;
+                }
+        }
+        mp_p->cycles++;
+
+        /* A BLT ends a block; the only place interrupts are taken */
+        if ((code_p->instr >> 13) == 0b111 && mp_p->next_event != NO_EVENT)
+        {
+            end_of_block( mp_p, instr_pc );
+        }
+    }
+    mp_p->halted = 1;
+    mp_p->engine = ENGINE_IDLE;
+
+    return SUCCESS;
+}
+
+/// @brief Runs up to budget instructions of the program on an engine
+/// @param mp_p microputer pointer
+/// @param engine ENGINE_REFERENCE, ENGINE_RUN_LOOP or ENGINE_PREDECODED
+/// @param budget the max number of instructions to execute
+/// @return 1 if SUCCESS, otherwise ERROR
+int run_engine(microputer_t * mp_p, byte_t engine, uint64_t budget)
+{
+    switch (engine)
+    {
+        case ENGINE_RUN_LOOP: return run_micro_program( mp_p, budget );
+        case ENGINE_PREDECODED:
+            return run_predecoded_micro_program( mp_p, budget );
+        default: return execute_micro_program_budget( mp_p, budget );
+    }
+}
+
+/// @brief Names an engine, as reported by the profiler and the selector
+/// @param engine a microputer_t.engine value
+/// @return the name
+const char * engine_name(byte_t engine)
+{
+    static const char * engine_names[ NUM_ENGINES ] = {
+        "idle", "reference",
+        "run_loop", "run_loop_input", "run_loop_debug", 
+        "run_loop_input_debug", "run_loop_coverage", 
+        "run_loop_input_coverage", "run_loop_debug_coverage", 
+        "run_loop_input_debug_coverage", "predecoded"
+    };
+    return engine < NUM_ENGINES ? engine_names[ engine ] : "unknown";
+}
+
 /*******************************************************************************
  *                     Instruction disassembler Functions
  ******************************************************************************/
@@ -434,10 +1231,19 @@ void prt_disassembler(uint16_t instr, char * out_line_buffer_p)
         START_FUNC;
     #endif 
 
-    byte_t out_instr_args_p[ 1 ];
+    byte_t out_instr_args_p[ 2 ];
     prt_extract_instr_args( instr, out_instr_args_p );
-    snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "PRT R%hu", 
-        (uint16_t) out_instr_args_p[ 0 ] );
+    /* Port 0 (the console) is implied */
+    if (out_instr_args_p[ 1 ] == CONSOLE_PORT)
+    {
+        snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "PRT R%hu", 
+            (uint16_t) out_instr_args_p[ 0 ] );
+    } else 
+    {
+        snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "PRT R%hu %hu", 
+            (uint16_t) out_instr_args_p[ 0 ], 
+            (uint16_t) out_instr_args_p[ 1 ] );
+    }
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -453,10 +1259,19 @@ void rdd_disassembler(uint16_t instr, char * out_line_buffer_p)
         START_FUNC;
     #endif 
 
-    byte_t out_instr_args_p[ 1 ];
+    byte_t out_instr_args_p[ 2 ];
     rdd_extract_instr_args( instr, out_instr_args_p );
-    snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "RDD R%hu", 
-        (uint16_t) out_instr_args_p[ 0 ] );
+    /* Port 0 (the console) is implied */
+    if (out_instr_args_p[ 1 ] == CONSOLE_PORT)
+    {
+        snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "RDD R%hu", 
+            (uint16_t) out_instr_args_p[ 0 ] );
+    } else 
+    {
+        snprintf( out_line_buffer_p, MAX_ASM_LINE_LEN, "RDD R%hu %hu", 
+            (uint16_t) out_instr_args_p[ 0 ], 
+            (uint16_t) out_instr_args_p[ 1 ] );
+    }
 
     #if TEST_MODE == 1
         END_FUNC;
@@ -484,6 +1299,145 @@ void blt_disassembler(uint16_t instr, char * out_line_buffer_p)
     #endif 
 }
 
+/*******************************************************************************
+ *                        Annotated Disassembly
+ ******************************************************************************/
+
+/// @brief Writes the assembly with a label at every BLT target, the BLTs 
+/// naming their label, a comment listing the branches into each label, and
+/// loop markers on backward branches. The branch index is built in one pass 
+/// over the decoded words (xrefs are chained per target, so nothing is ever 
+/// searched) and the file is written in a second
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @param asm_file_buffer_p the disassembled lines
+/// @param asm_file_name_p the name of the file
+/// @param lines the number of lines to write to the .asm file
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_annotated_assembly_file(microputer_t * mp_p,
+    char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ], 
+    const char * asm_file_name_p, byte_t lines)
+{
+    #if TEST_MODE == 1
+        START_FUNC;
+    #endif 
+
+    FILE * file_p = fopen( asm_file_name_p, "w" );
+    byte_t args[ 3 ];
+    /* First/last branch into each word, and the next branch into the same */
+    int xref_head[ MEM_WORD_COUNT ];
+    int xref_tail[ MEM_WORD_COUNT ];
+    int xref_next[ MEM_WORD_COUNT ];
+    /* BLT target word of each line, or -1 if it is not a branch into code */
+    int target[ MEM_WORD_COUNT ];
+    /* 1 = some branch from a later word jumps back here */
+    byte_t loop_head[ MEM_WORD_COUNT ] = { 0 };
+    int result = SUCCESS;
+
+    if (!file_p)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            asm_file_name_p );
+        return ERROR;
+    }
+
+    for (int i = 0; i < lines; i++)
+    {
+        xref_head[ i ] = xref_tail[ i ] = xref_next[ i ] = target[ i ] = -1;
+    }
+
+    /* Single pass: chain each branch onto its target's xref list in order */
+    for (int i = 0; i < lines; i++)
+    {
+        uint16_t instr = fetch_word( mp_p, i );
+        if ((instr >> 13) != 0b111)
+        {
+            continue;
+        }
+        blt_extract_instr_args( instr, args );
+        if (args[ 2 ] % 2 != 0 || args[ 2 ] / 2 >= lines)
+        {
+            continue;
+        }
+        target[ i ] = args[ 2 ] / 2;
+        if (xref_tail[ target[ i ] ] < 0)
+        {
+            xref_head[ target[ i ] ] = i;
+        } else 
+        {
+            xref_next[ xref_tail[ target[ i ] ] ] = i;
+        }
+        xref_tail[ target[ i ] ] = i;
+        if (target[ i ] <= i)
+        {
+            loop_head[ target[ i ] ] = 1;
+        }
+    }
+
+    for (int i = 0; i < lines && result >= 0; i++)
+    {
+        if (xref_head[ i ] >= 0)
+        {
+            result = fprintf( file_p, "L%d:%*s; xrefs:", i * 2, 
+                i * 2 < 10 ? 14 : 13, "" );
+            for (int j = xref_head[ i ]; j >= 0 && result >= 0; 
+                j = xref_next[ j ])
+            {
+                result = fprintf( file_p, " %d", j * 2 );
+            }
+            if (loop_head[ i ] && result >= 0)
+            {
+                result = fprintf( file_p, " ; loop head" );
+            }
+            if (result >= 0)
+            {
+                result = fputs( "\n", file_p );
+            }
+        }
+        if (result < 0)
+        {
+            break;
+        }
+
+        if (target[ i ] >= 0)
+        {
+            blt_extract_instr_args( fetch_word( mp_p, i ), args );
+            result = fprintf( file_p, "%d: BLT R%hu R%hu L%hu%s", i * 2,
+                (uint16_t) args[ 0 ], (uint16_t) args[ 1 ], 
+                (uint16_t) args[ 2 ], 
+                target[ i ] <= i ? "   ; loop back" : "" );
+        } else 
+        {
+            result = fprintf( file_p, "%d: %s", i * 2, asm_file_buffer_p[ i ] );
+            if (result >= 0 && (fetch_word( mp_p, i ) >> 13) == 0b111)
+            {
+                blt_extract_instr_args( fetch_word( mp_p, i ), args );
+                result = fputs( args[ 2 ] % 2 != 0 ? 
+                    "   ; misaligned target" : "   ; exits program", file_p );
+            }
+        }
+        if (result >= 0 && i < lines - 1)
+        {
+            result = fputs( "\n", file_p );
+        }
+    }
+
+    if (result < 0)
+    {
+        printf( "\t# [ERROR: Can not write buffer to .asm file!] #\n" );
+        result = ERROR;
+    } else 
+    {
+        result = SUCCESS;
+    }
+    fclose( file_p );
+
+    #if TEST_MODE == 1
+        END_FUNC;
+    #endif 
+
+    return result;
+}
+
 /*******************************************************************************
  *                     Instruction Handler Functions
 ******************************************************************************/
@@ -568,19 +1522,36 @@ int prt_handler(microputer_t * mp_p)
     #if TEST_MODE == 1
         START_FUNC;
     #endif 
-    /* Prints the contents of the register (in decimal)*/
-    byte_t out_instr_args_p[ 1 ];
+    /* Writes the contents of the register to the device on the port */
+    byte_t out_instr_args_p[ 2 ];
     prt_extract_instr_args( mp_p->ir, out_instr_args_p );
+    byte_t port = out_instr_args_p[ 1 ];
+    device_t * dev_p = mp_p->bus_p->port_map[ port ];
+    byte_t value = mp_p->reg[ out_instr_args_p[ 0 ] ];
 
-    printf( "R%hu = %hu\n", 
-        (uint16_t) out_instr_args_p[ 0 ],
-         (uint16_t) mp_p->reg[ out_instr_args_p[ 0 ] ] );
+    mp_p->io_count++;
+
+    /* Buffered writes are applied later by flush_io_log */
+    if (mp_p->io_log_p != NULL && dev_p->deferrable)
+    {
+        io_log_t * log_p = mp_p->io_log_p;
+        if (log_p->count == log_p->capacity)
+        {
+            printf( "\t# [ERROR: io log is full!] #\n" );
+            return ERROR;
+        }
+        log_p->ports_p[ log_p->count ] = port;
+        log_p->regs_p[ log_p->count ] = out_instr_args_p[ 0 ];
+        log_p->values_p[ log_p->count++ ] = value;
+        return SUCCESS;
+    }
 
     #if TEST_MODE == 1
         END_FUNC;
     #endif 
 
-    return SUCCESS;
+    return dev_p->write( dev_p, mp_p, port - dev_p->base_port, 
+        out_instr_args_p[ 0 ], value );
 }
 
 /// @brief Executes the RDD instruction on the passed microputer
@@ -592,14 +1563,20 @@ int rdd_handler(microputer_t * mp_p)
         START_FUNC;
     #endif 
 
-    byte_t out_instr_args_p[ 1 ];
+    byte_t out_instr_args_p[ 2 ];
     rdd_extract_instr_args( mp_p->ir, out_instr_args_p );
     byte_t * ri = &mp_p->reg[ out_instr_args_p[ 0 ] ];
-    unsigned int input = 0;
- 
-    printf( "Enter a value for R%d: ", (uint16_t) out_instr_args_p[ 0 ] ); 
-    scanf( "%d", &input );                      // read in an integer
-    *ri = (byte_t) (input & 0x00FF) ;     // take lower 8 bits
+    byte_t port = out_instr_args_p[ 1 ];
+    device_t * dev_p = mp_p->bus_p->port_map[ port ];
+
+    mp_p->io_count++;
+
+    /* Reads the register's new value from the device on the port */
+    if (dev_p->read( dev_p, mp_p, port - dev_p->base_port, 
+        out_instr_args_p[ 0 ], ri ) != SUCCESS)
+    {
+        return ERROR;
+    }
 
     #if TEST_MODE == 1
         printf( "RDD R%hu(%hu)\n", 
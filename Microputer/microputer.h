@@ -4,6 +4,9 @@
 /// @date 09.19.2023
 ////////////////////////////////////////////////////////////////////////////////
 
+#ifndef MICROPUTER_H
+#define MICROPUTER_H
+
 /***************************** Imports ****************************************/
 
 #include "stdint.h"
@@ -15,8 +18,26 @@
 #define NUM_INSTRUCTIONS 8
 #define NUM_REGISTERS 16
 #define MEM_BYTE_SIZE 32
+#define MEM_WORD_COUNT (MEM_BYTE_SIZE / WORD_SIZE)
+/* Max characters per line in the .asm file */
+#define MAX_ASM_LINE_LEN 15
 #define SUCCESS 0
 #define ERROR 1
+/* Budget for run_micro_program() that runs the program until it halts */
+#define RUN_UNBOUNDED UINT64_MAX
+/* next_event when the timer is not armed */
+#define NO_EVENT UINT64_MAX
+/* idle_pc when no backward branch has been seen */
+#define NO_PC UINT16_MAX
+/* Values of microputer_t.engine; the run loop adds its flags to 
+   ENGINE_RUN_LOOP, so each instantiation has its own value */
+#define ENGINE_IDLE 0
+#define ENGINE_REFERENCE 1
+#define ENGINE_RUN_LOOP 2
+#define ENGINE_PREDECODED (ENGINE_RUN_LOOP + 8)
+#define NUM_ENGINES (ENGINE_PREDECODED + 1)
+/* decoded_instr_t.op_code of instructions left to their handler */
+#define DECODED_HANDLER 0xFF
 
 /********************* Microputer Structs & Types *****************************/
 
@@ -24,6 +45,18 @@
 typedef unsigned char byte_t;
 
 struct microputer_s;
+struct io_bus_s;
+struct debugger_s;
+struct coverage_s;
+
+/* PRT output held back so it can be released at a synchronization point */
+struct io_log_s {
+    byte_t * ports_p;
+    byte_t * regs_p;
+    byte_t * values_p;
+    uint64_t count;
+    uint64_t capacity;
+} typedef io_log_t;
 
 /* Represents an instruction */
 struct instruction_s {
@@ -37,16 +70,102 @@ struct microputer_s {
     instruction_t instr_set[ NUM_INSTRUCTIONS ]; 
     byte_t reg[ NUM_REGISTERS ];     
     byte_t mem[ MEM_BYTE_SIZE ];             
+    /* Memory instructions are fetched from; mem, or a machine's shared image */
+    byte_t * mem_p;
     byte_t loaded_mem_slots;
+    /* 1 once the PC has run off the end of the loaded program */
+    byte_t halted;
     uint16_t pc;                                    
     uint16_t ir;                                   
+    /* Instructions executed so far (one cycle each) */
+    uint64_t cycles;
+    /* The devices PRT/RDD talk to, by port (see devices.h) */
+    struct io_bus_s * bus_p;
+    /* When set, PRT to a deferrable device appends here instead */
+    io_log_t * io_log_p;
+    /* PRT/RDD executed so far */
+    uint64_t io_count;
+
+    /* Timer interrupt state, programmed through the timer device */
+    uint64_t next_event;    // cycle the timer fires at, or NO_EVENT
+    uint64_t timer_period;  // cycles between interrupts
+    uint16_t irq_vector;    // address the interrupt jumps to
+    uint16_t saved_pc;      // where the interrupted program resumes
+    byte_t in_interrupt;
+
+    /* State at the last backward branch, to spot loops that only wait */
+    uint16_t idle_pc;
+    uint64_t idle_io_count;
+    byte_t idle_reg[ NUM_REGISTERS ];
+    /* Cycles fast-forwarded over instead of executed */
+    uint64_t skipped_cycles;
+
+    /* When set, runs use the debug engine (see debugger.h) */
+    struct debugger_s * debugger_p;
+    /* When set, runs record coverage here (see coverage.h); not shared */
+    struct coverage_s * coverage_p;
+
+    /* Published for the sampling profiler (see profiler.h): the engine 
+       running this microputer and the address of the instruction it runs */
+    volatile byte_t engine;
+    volatile uint16_t sample_pc;
 } typedef microputer_t;
 
+/* An instruction decoded ahead of time for the predecoded engine */
+struct decoded_instr_s {
+    uint16_t instr;
+    /* The op code, or DECODED_HANDLER to run the instruction's handler */
+    byte_t op_code;
+    /* Register indexes and immediate/address, in the order of the asm */
+    byte_t a;
+    byte_t b;
+    byte_t c;
+} typedef decoded_instr_t;
+
+/* A disassembled listing, kept so a patched image can be re-disassembled */
+struct asm_listing_s {
+    char lines[ MEM_WORD_COUNT ][ MAX_ASM_LINE_LEN ];
+    /* The instruction words the lines were disassembled from */
+    uint16_t words[ MEM_WORD_COUNT ];
+    /* Byte offset of each line in the .asm file, plus the end of file */
+    long offsets[ MEM_WORD_COUNT + 1 ];
+    byte_t num_words;
+    byte_t valid;
+    /* Lines the last update kept instead of disassembling again */
+    byte_t num_reused;
+} typedef asm_listing_t;
+
 /********************* Public Microputer Functions ****************************/
 
 int create_microputer(microputer_t ** mp_pp);
 int delete_microputer(microputer_t ** mp_pp);
+int init_microputer(microputer_t * mp_p);
+void reset_microputer(microputer_t * mp_p);
 void create_instruction_set(microputer_t * mp_p);
+int load_micro_program(microputer_t * mp_p, const char * bin_file_name_p);
 int disassemble_micro_program(microputer_t * mp_p, 
     const char * bin_file_name_p, const char * asm_file_name_p);
-int execute_micro_program(microputer_t * mp_p);
\ No newline at end of file
+int disassemble_annotated_micro_program(microputer_t * mp_p, 
+    const char * bin_file_name_p, const char * asm_file_name_p);
+int write_annotated_assembly_file(microputer_t * mp_p,
+    char (*asm_file_buffer_p)[ MAX_ASM_LINE_LEN ], 
+    const char * asm_file_name_p, byte_t lines);
+int update_micro_listing(microputer_t * mp_p, asm_listing_t * listing_p,
+    const char * bin_file_name_p, const char * asm_file_name_p);
+int save_micro_listing(const asm_listing_t * listing_p, 
+    const char * lst_file_name_p);
+int load_micro_listing(asm_listing_t * listing_p, 
+    const char * lst_file_name_p);
+int execute_micro_program(microputer_t * mp_p);
+int execute_micro_program_budget(microputer_t * mp_p, uint64_t budget);
+int run_predecoded_micro_program(microputer_t * mp_p, uint64_t budget);
+int run_engine(microputer_t * mp_p, byte_t engine, uint64_t budget);
+const char * engine_name(byte_t engine);
+int run_micro_program(microputer_t * mp_p, uint64_t budget);
+void end_of_block(microputer_t * mp_p, uint16_t branch_pc);
+int run_micro_program_until_input(microputer_t * mp_p, uint64_t budget);
+int create_io_log(io_log_t * log_p, uint64_t capacity);
+void delete_io_log(io_log_t * log_p);
+int flush_io_log(microputer_t * mp_p);
+
+#endif
\ No newline at end of file
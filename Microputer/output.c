@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Buffered PRT output: every line PRT can print is formatted once into a
+/// table, so printing one is a 16 byte copy into a large buffer
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "output.h"
+
+/**************************** Globals *****************************************/
+
+/* "R<reg> = <value>\n" for every register and value */
+static char prt_lines[ NUM_REGISTERS ][ 256 ][ PRT_LINE_STRIDE ];
+static pthread_once_t prt_lines_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+ *                          Formatting Functions
+ ******************************************************************************/
+
+/// @brief Formats the table of every PRT line
+static void create_prt_lines(void)
+{
+    for (int reg = 0; reg < NUM_REGISTERS; reg++)
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            prt_lines[ reg ][ value ][ PRT_LINE_STRIDE - 1 ] = (char) 
+                snprintf( prt_lines[ reg ][ value ], PRT_LINE_STRIDE - 1, 
+                    "R%hu = %hu\n", (uint16_t) reg, (uint16_t) value );
+        }
+    }
+}
+
+/// @brief Copies the line the console prints for a PRT
+/// @param reg_index the register
+/// @param value its value
+/// @param out_line_p where the line goes, with PRT_LINE_STRIDE bytes of room
+/// (everything past the line is scratch)
+/// @return the length of the line
+size_t format_prt_line(byte_t reg_index, byte_t value, char * out_line_p)
+{
+    const char * line_p;
+
+    pthread_once( &prt_lines_once, create_prt_lines );
+    line_p = prt_lines[ reg_index % NUM_REGISTERS ][ value ];
+    memcpy( out_line_p, line_p, PRT_LINE_STRIDE );
+    return (size_t) line_p[ PRT_LINE_STRIDE - 1 ];
+}
+
+/*******************************************************************************
+ *                  Output Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Creates a sink that buffers PRT output for a file
+/// @param out_sink_pp a pointer to a pointer of the sink
+/// @param file_p the file the output is written to (not closed with it)
+/// @param format OUTPUT_TEXT or OUTPUT_BINARY
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_output_sink(output_sink_t ** out_sink_pp, FILE * file_p,
+    byte_t format)
+{
+    pthread_once( &prt_lines_once, create_prt_lines );
+
+    *out_sink_pp = (output_sink_t *) calloc( 1, sizeof( output_sink_t ) );
+    if (*out_sink_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_sink_pp] #\n" );
+        return ERROR;
+    }
+    /* Room for a whole line copy past the end of the last one */
+    (*out_sink_pp)->buf_p = (char *) malloc( OUTPUT_BUFFER_SIZE 
+        + PRT_LINE_STRIDE );
+    if ((*out_sink_pp)->buf_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate the output buffer] "
+            "#\n" );
+        free( *out_sink_pp );
+        *out_sink_pp = NULL;
+        return ERROR;
+    }
+    (*out_sink_pp)->file_p = file_p;
+    (*out_sink_pp)->format = format;
+    return SUCCESS;
+}
+
+/// @brief Flushes and frees a sink
+/// @param sink_pp a pointer to a pointer of the sink
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_output_sink(output_sink_t ** sink_pp)
+{
+    int result;
+
+    if (*sink_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *sink_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    result = flush_output_sink( *sink_pp );
+    free( (*sink_pp)->buf_p );
+    free( *sink_pp );
+    *sink_pp = NULL;
+    return result;
+}
+
+/*******************************************************************************
+ *                          Output Functions
+ ******************************************************************************/
+
+/// @brief Adds a PRT to the sink, writing the buffer out once it is full
+/// @param sink_p the sink
+/// @param reg_index the register printed
+/// @param value its value
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_prt_output(output_sink_t * sink_p, byte_t reg_index, byte_t value)
+{
+    if (sink_p->len + PRT_LINE_STRIDE > OUTPUT_BUFFER_SIZE
+        && flush_output_sink( sink_p ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    if (sink_p->format == OUTPUT_BINARY)
+    {
+        sink_p->buf_p[ sink_p->len++ ] = (char) reg_index;
+        sink_p->buf_p[ sink_p->len++ ] = (char) value;
+    } else
+    {
+        /* The table was made with the sink */
+        const char * line_p = prt_lines[ reg_index % NUM_REGISTERS ][ value ];
+
+        memcpy( sink_p->buf_p + sink_p->len, line_p, PRT_LINE_STRIDE );
+        sink_p->len += (size_t) line_p[ PRT_LINE_STRIDE - 1 ];
+    }
+    return SUCCESS;
+}
+
+/// @brief Writes out everything buffered so far, or hands it to the
+/// compressing thread
+/// @param sink_p the sink
+/// @return 1 if SUCCESS, otherwise ERROR
+int flush_output_sink(output_sink_t * sink_p)
+{
+    size_t len = sink_p->len;
+
+    sink_p->len = 0;
+    if (sink_p->lz_p != NULL)
+    {
+        sink_p->bytes_written += len;
+        return write_lz_stream( sink_p->lz_p, sink_p->buf_p, len );
+    }
+    if (len > 0 && fwrite( sink_p->buf_p, 1, len, sink_p->file_p ) != len)
+    {
+        printf( "\t# [ERROR: Can not write the output!] #\n" );
+        return ERROR;
+    }
+    sink_p->bytes_written += len;
+    return fflush( sink_p->file_p ) == 0 ? SUCCESS : ERROR;
+}
@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for buffered PRT output in batch mode
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stddef.h>
+#include "microputer.h"
+#include "lzstream.h"
+
+/**************************** Constants ***************************************/
+
+/* Output formats */
+#define OUTPUT_TEXT 0       // "R%hu = %hu\n" lines, as the console prints
+#define OUTPUT_BINARY 1     // a (register, value) byte pair per PRT
+
+/* Each precomputed line has this many bytes, so one 16 byte copy moves it;
+   the last byte holds its length (at most 10, "R15 = 255\n") */
+#define PRT_LINE_STRIDE 16
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+
+/*********************** Output Structs & Types *******************************/
+
+/* Where PRT output is collected before it is written out in large blocks */
+struct output_sink_s {
+    FILE * file_p;
+    byte_t format;
+    char * buf_p;
+    size_t len;
+    /* Bytes written out so far */
+    uint64_t bytes_written;
+    /* Compresses the output on its way to file_p, or NULL */
+    lz_stream_t * lz_p;
+} typedef output_sink_t;
+
+/************************ Public Output Functions *****************************/
+
+size_t format_prt_line(byte_t reg_index, byte_t value, char * out_line_p);
+int create_output_sink(output_sink_t ** out_sink_pp, FILE * file_p,
+    byte_t format);
+int delete_output_sink(output_sink_t ** sink_pp);
+int write_prt_output(output_sink_t * sink_p, byte_t reg_index, byte_t value);
+int flush_output_sink(output_sink_t * sink_p);
+
+#endif
@@ -9,10 +9,481 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include "microputer.h"
+#include "machine.h"
+#include "devices.h"
+#include "debugger.h"
+#include "gdbstub.h"
+#include "coverage.h"
+#include "profiler.h"
+#include "perfcounters.h"
+#include "metrics.h"
+#include "selector.h"
+#include "difftest.h"
+#include "generator.h"
+#include "batch.h"
+#include "specializer.h"
+#include "snapshot.h"
+#include "scheduler.h"
+#include "shmring.h"
+
+/********************* Program Options & Types ********************************/
+
+/* Options chosen on the command line, shared by every run of start() */
+struct options_s {
+    /* 1 = only re-disassemble the words that changed since the last run */
+    int incremental;
+    /* 1 = write labels, cross-references and loop markers into the .asm */
+    int annotate;
+    /* Number of cores sharing the program's memory (1 = no machine) */
+    int cores;
+    /* Instructions each core runs per turn */
+    unsigned long long quantum;
+    /* 1 = simulate the cores on parallel host threads */
+    int parallel;
+    /* File backing a block device at BLOCK_PORT, or NULL for none */
+    const char * block_file_p;
+    /* File RDD on the console reads from instead of stdin, or NULL, and
+       its format (INPUT_TEXT or INPUT_BINARY) */
+    const char * input_file_p;
+    int input_format;
+    /* "text" or "binary", then optionally ":file", to buffer PRT output on 
+       the console into stdout or the file; NULL prints each PRT */
+    const char * output_spec_p;
+    /* 1 = compress the -O file as an LZ stream on a background thread */
+    int compress_output;
+    /* Compressed stream to decompress to stdout instead of running, or NULL */
+    const char * decompress_file_p;
+    /* File of job lines ("-" for stdin) to run instead of file pairs, or 
+       NULL */
+    const char * job_file_p;
+    /* Archive whose programs to run as one batch, or NULL, and how many
+       jobs ahead of the running one to prefetch */
+    const char * batch_archive_p;
+    int prefetch_depth;
+    /* Breakpoint addresses and watched registers */
+    uint16_t breakpoints[ MEM_WORD_COUNT ];
+    int num_breakpoints;
+    uint16_t watch_mask;
+    /* Localhost TCP port or Unix socket path to serve gdb on, or NULL */
+    const char * gdb_address_p;
+    /* lcov tracefile to write coverage to, or NULL */
+    const char * coverage_file_p;
+    /* Folded stacks file to write the sampling profile to, or NULL */
+    const char * profile_file_p;
+    /* Engine for single core runs, ENGINE_AUTO, or 0 for the reference */
+    int engine;
+    /* File the auto engine choices are kept in between runs, or NULL */
+    const char * engine_cache_file_p;
+    /* 1 = count host cycles, instructions and misses around the engine */
+    int host_counters;
+    /* 1 = put the differential test's corpus and instances on huge pages */
+    int huge_pages;
+    /* Prometheus text file the job metrics are written to, or NULL */
+    const char * metrics_file_p;
+    /* Random programs to test the engines against each other on (with the
+       files given as the corpus), or 0 to run the files as jobs */
+    unsigned long long diff_count;
+    uint32_t diff_seed;
+    /* Archive to generate random terminating programs into, or NULL, and
+       the "key=value,..." mix to generate them with */
+    const char * gen_archive_file_p;
+    const char * gen_mix_p;
+    /* Values of the first console reads to specialize a program to, or
+       NULL */
+    const char * spec_values_p;
+    /* Instructions a run of a job may execute, and the job in all, across 
+       the runs it is suspended and resumed over (RUN_UNBOUNDED = no limit) */
+    unsigned long long slice;
+    unsigned long long job_limit;
+    /* Snapshot a job resumes from when it exists and is suspended into when
+       its slice runs out, or NULL */
+    const char * snapshot_file_p;
+    /* Instructions a -J job runs before the scheduler may preempt it, or 0
+       to run the jobs one after another */
+    unsigned long long sched_quantum;
+    /* Shared memory ring channel the console's RDD and PRT go over, or 
+       NULL, and the channel to feed stdin into and print from as a client
+       of another process's program, or NULL */
+    const char * ring_channel_p;
+    const char * ring_client_p;
+} typedef options_t;
+
+static options_t options = { 0, 0, 1, DEFAULT_QUANTUM, 0, NULL };
+
+/* The running profiler, which the cores of a machine are added to */
+static profiler_t * profiler_p = NULL;
+
+/* 1 once a job has written the -P folded stacks or the -c tracefile; later
+   jobs of the run add to them instead of replacing them */
+static byte_t folded_written = 0;
+static byte_t lcov_written = 0;
+
+/* Metrics of every job run, when they are being exported */
+static metrics_t * metrics_p = NULL;
+/* When the -M file was last written */
+static uint64_t metrics_written_ns = 0;
+
+/* Picks the engine of every job, when asked to */
+static selector_t * selector_p = NULL;
+
+/* Where the console's PRT output is buffered with -O, across every job */
+static output_sink_t * output_p = NULL;
+
+/* The microputer and bus every job of a job list reuses, or NULL */
+static microputer_t * job_mp_p = NULL;
+static io_bus_t * job_bus_p = NULL;
+/* Where job_bus_p's devices were when it was made; every job starts there,
+   so it doesn't see the random or block device where the one before left
+   it */
+static device_cursors_t job_cursors;
 
 /************************* Program Functions **********************************/
 
+/// @brief Resumes the job suspended into the -Z snapshot, when there is one
+/// @param mp_p microputer pointer, with the job's program loaded
+/// @param budget_left_p the job's budget; replaced by what it had left
+/// @return 1 if SUCCESS, otherwise ERROR
+int resume_job(microputer_t * mp_p, uint64_t * budget_left_p)
+{
+    snapshot_t snapshot;
+
+    if (access( options.snapshot_file_p, F_OK ) != 0)
+    {
+        return SUCCESS;
+    }
+    if (load_snapshot( &snapshot, options.snapshot_file_p ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    /* No instruction writes memory, so the image tells jobs apart */
+    if (snapshot.loaded_mem_slots != mp_p->loaded_mem_slots
+        || memcmp( snapshot.mem, mp_p->mem, MEM_BYTE_SIZE ) != 0)
+    {
+        printf( "\t# [ERROR: '%s' is a snapshot of another program] #\n",
+            options.snapshot_file_p );
+        return ERROR;
+    }
+    restore_snapshot( mp_p, &snapshot );
+    *budget_left_p = snapshot.budget_left;
+    printf( "Resumed from '%s' at pc %hu after %llu instructions\n\n",
+        options.snapshot_file_p, snapshot.pc, 
+        (unsigned long long) snapshot.cycles );
+    return SUCCESS;
+}
+
+/// @brief Ends a run of a job. A job that halted is done and its snapshot
+/// removed; one out of its -L limit fails; any other is suspended into the
+/// -Z snapshot, for this or another process to resume later
+/// @param mp_p microputer pointer
+/// @param budget_left the job's budget when the run started
+/// @param ran instructions the run executed
+/// @return 1 if SUCCESS, otherwise ERROR
+int end_job_run(microputer_t * mp_p, uint64_t budget_left, uint64_t ran)
+{
+    snapshot_t snapshot;
+
+    if (budget_left != RUN_UNBOUNDED)
+    {
+        /* Fast-forwarding an idle timer can run past the budget */
+        budget_left = ran >= budget_left ? 0 : budget_left - ran;
+    }
+    if (mp_p->halted || budget_left == 0)
+    {
+        if (options.snapshot_file_p != NULL)
+        {
+            remove( options.snapshot_file_p );
+        }
+        if (mp_p->halted)
+        {
+            return SUCCESS;
+        }
+        printf( "\t# [ERROR: job ran out of its %llu instruction budget] #\n",
+            options.job_limit );
+        return ERROR;
+    }
+    if (options.snapshot_file_p == NULL)
+    {
+        printf( "\nStopped after %llu instructions at pc %hu\n",
+            (unsigned long long) ran, mp_p->pc );
+        return SUCCESS;
+    }
+    if (capture_snapshot( mp_p, budget_left, &snapshot ) != SUCCESS
+        || save_snapshot( &snapshot, options.snapshot_file_p ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    printf( "\nSuspended into '%s' at pc %hu after %llu instructions\n",
+        options.snapshot_file_p, mp_p->pc, 
+        (unsigned long long) mp_p->cycles );
+    return SUCCESS;
+}
+
+/// @brief Disassembles the program, patching the listing left by the last run
+/// (kept next to the .asm file as '<asm>.lst') instead of regenerating it
+/// @param mp_p microputer pointer
+/// @param in_bin_file the file to read the machine code from
+/// @param out_asm_file the file to write the assembly to
+/// @return 1 if SUCCESS, otherwise ERROR
+int disassemble_incrementally(microputer_t * mp_p, char * in_bin_file, 
+    char * out_asm_file)
+{
+    int result = SUCCESS;
+    size_t lst_len = strlen( out_asm_file ) + 5;
+    char * lst_file_p = (char *) malloc( lst_len );
+    asm_listing_t * listing_p = (asm_listing_t *) malloc( sizeof( *listing_p ) );
+
+    if (lst_file_p == NULL || listing_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate listing] #\n" );
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    snprintf( lst_file_p, lst_len, "%s.lst", out_asm_file );
+
+    /* A missing listing just means the whole program gets disassembled */
+    load_micro_listing( listing_p, lst_file_p );
+    result = update_micro_listing( mp_p, listing_p, in_bin_file, out_asm_file );
+    if (result == SUCCESS)
+    {
+        result = save_micro_listing( listing_p, lst_file_p );
+    }
+    if (result == SUCCESS && metrics_p != NULL)
+    {
+        metrics_p->listing_hits += listing_p->num_reused;
+        metrics_p->listing_misses += listing_p->num_words 
+            - listing_p->num_reused;
+    }
+
+    FUNC_EXIT:
+    free( lst_file_p );
+    free( listing_p );
+    return result;
+}
+
+/// @brief Disassembles the machine code into the .asm file, annotated or 
+/// incrementally if asked to, and loads the program into memory
+/// @param mp_p microputer pointer
+/// @param in_bin_file the file to read the machine code from
+/// @param out_asm_file the file to write the assembly to
+/// @return 1 if SUCCESS, otherwise ERROR
+int load_program(microputer_t * mp_p, char * in_bin_file, char * out_asm_file)
+{
+    if (options.annotate)
+    {
+        return disassemble_annotated_micro_program( mp_p, in_bin_file, 
+            out_asm_file );
+    } else if (options.incremental)
+    {
+        return disassemble_incrementally( mp_p, in_bin_file, out_asm_file );
+    }
+    return disassemble_micro_program( mp_p, in_bin_file, out_asm_file );
+}
+
+/// @brief Creates the default I/O bus plus a block device backed by the file
+/// given with -b, and a console reading the input file given with -r or -R
+/// and printing into the output sink given with -O, or going over the ring
+/// channel given with -y
+/// @param out_bus_pp a pointer to a pointer of the bus
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_io_bus_with_devices(io_bus_t ** out_bus_pp)
+{
+    device_t * dev_p = NULL;
+    /* Job lists and batches hand each job its input themselves */
+    const char * input_file_p = options.job_file_p != NULL 
+        || options.batch_archive_p != NULL ? NULL : options.input_file_p;
+
+    if (create_default_io_bus( out_bus_pp ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    if ((options.block_file_p != NULL
+        && (create_block_device( &dev_p, options.block_file_p ) != SUCCESS
+            || attach_device( *out_bus_pp, dev_p, BLOCK_PORT ) != SUCCESS))
+        || ((options.input_file_p != NULL || output_p != NULL 
+            || options.job_file_p != NULL || options.batch_archive_p != NULL)
+        && (create_stream_console_device( &dev_p, input_file_p, 
+            options.input_format, output_p ) != SUCCESS
+            || attach_device( *out_bus_pp, dev_p, CONSOLE_PORT ) != SUCCESS))
+        || (options.ring_channel_p != NULL
+        && (create_ring_console_device( &dev_p, options.ring_channel_p )
+            != SUCCESS
+            || attach_device( *out_bus_pp, dev_p, CONSOLE_PORT ) != SUCCESS)))
+    {
+        delete_device( &dev_p );
+        delete_io_bus( out_bus_pp );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Creates the output sink given with -O
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_output(void)
+{
+    const char * file_name_p = strchr( options.output_spec_p, ':' );
+    size_t format_len = file_name_p != NULL 
+        ? (size_t) (file_name_p - options.output_spec_p) 
+        : strlen( options.output_spec_p );
+    byte_t format;
+    FILE * file_p = stdout;
+
+    if (format_len == 4 && strncmp( options.output_spec_p, "text", 4 ) == 0)
+    {
+        format = OUTPUT_TEXT;
+    } else if (format_len == 6 
+        && strncmp( options.output_spec_p, "binary", 6 ) == 0)
+    {
+        format = OUTPUT_BINARY;
+    } else
+    {
+        printf( "\t# [ERROR: -O needs text or binary, not '%.*s'] #\n", 
+            (int) format_len, options.output_spec_p );
+        return ERROR;
+    }
+    if (file_name_p != NULL)
+    {
+        file_p = fopen( file_name_p + 1, "wb" );
+        if (file_p == NULL)
+        {
+            printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n", 
+                file_name_p + 1 );
+            return ERROR;
+        }
+    }
+    if (options.compress_output && file_p == stdout)
+    {
+        printf( "\t# [ERROR: -z needs a file to write, as in -O text:file] "
+            "#\n" );
+        return ERROR;
+    }
+    if (create_output_sink( &output_p, file_p, format ) != SUCCESS)
+    {
+        if (file_p != stdout)
+        {
+            fclose( file_p );
+        }
+        return ERROR;
+    }
+    if (options.compress_output 
+        && create_lz_stream( &output_p->lz_p, file_p ) != SUCCESS)
+    {
+        delete_output_sink( &output_p );
+        fclose( file_p );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Executes the loaded program on every core of a multi-core machine
+/// @param mp_p the microputer the program was loaded into
+/// @return 1 if SUCCESS, otherwise ERROR
+int execute_on_machine(microputer_t * mp_p)
+{
+    int result = SUCCESS;
+    machine_t * machine_p = NULL;
+
+    result = create_machine( &machine_p, (byte_t) options.cores, 
+        options.quantum );
+    if (result != SUCCESS)
+    {
+        return result;
+    }
+    share_machine_memory( machine_p, mp_p );
+
+    /* Each core records its own coverage, merged in when it is done */
+    for (byte_t i = 0; i < machine_p->num_cores && result == SUCCESS; i++)
+    {
+        if (mp_p->coverage_p != NULL)
+        {
+            result = create_coverage( &machine_p->cores_p[ i ]->coverage_p );
+        }
+    }
+
+    for (byte_t i = 0; i < machine_p->num_cores && result == SUCCESS; i++)
+    {
+        if (profiler_p != NULL)
+        {
+            char name[ MAX_TARGET_NAME_LEN ];
+            snprintf( name, sizeof( name ), "core%hu", (uint16_t) i );
+            result = add_profile_target( profiler_p, machine_p->cores_p[ i ], 
+                name );
+        }
+    }
+
+    if (result != SUCCESS)
+    {
+        /* Nothing runs */
+    } else if (options.parallel)
+    {
+        result = run_machine_parallel( machine_p );
+    } else 
+    {
+        result = run_machine( machine_p );
+    }
+
+    for (byte_t i = 0; i < machine_p->num_cores; i++)
+    {
+        if (machine_p->cores_p[ i ]->coverage_p != NULL)
+        {
+            merge_coverage( mp_p->coverage_p, 
+                machine_p->cores_p[ i ]->coverage_p );
+            delete_coverage( &machine_p->cores_p[ i ]->coverage_p );
+        }
+        if (profiler_p != NULL)
+        {
+            remove_profile_target( profiler_p, machine_p->cores_p[ i ] );
+        }
+    }
+
+    /* The machine's instructions are counted as the program's */
+    for (byte_t i = 0; i < machine_p->num_cores; i++)
+    {
+        mp_p->cycles += machine_p->cores_p[ i ]->cycles;
+    }
+
+    delete_machine( &machine_p );
+    return result;
+}
+
+/// @brief Executes the loaded program under the debug engine, reporting 
+/// each breakpoint and watchpoint hit and then carrying on
+/// @param mp_p microputer pointer
+/// @return 1 if SUCCESS, otherwise ERROR
+int execute_with_debugger(microputer_t * mp_p)
+{
+    int result = SUCCESS;
+    debugger_t * dbg_p = NULL;
+
+    result = create_debugger( &dbg_p );
+    for (int i = 0; i < options.num_breakpoints && result == SUCCESS; i++)
+    {
+        result = set_breakpoint( dbg_p, options.breakpoints[ i ] );
+    }
+    if (result != SUCCESS)
+    {
+        goto FUNC_EXIT;
+    }
+    dbg_p->watch_mask = options.watch_mask;
+    mp_p->debugger_p = dbg_p;
+
+    while (result == SUCCESS && !mp_p->halted)
+    {
+        result = run_micro_program( mp_p, RUN_UNBOUNDED );
+        print_debugger_stop( mp_p );
+    }
+
+    FUNC_EXIT:
+    mp_p->debugger_p = NULL;
+    if (dbg_p != NULL)
+    {
+        delete_debugger( &dbg_p );
+    }
+    return result;
+}
+
 /// @brief Sets up everything you need and starts the program
 /// @param in_bin_file the file to read the machine code from
 /// @param out_asm_file the file to write the assembly to
@@ -21,10 +492,32 @@ int start(char * in_bin_file, char * out_asm_file)
 {
     int result = SUCCESS;
     microputer_t * mp_p = NULL;
+    io_bus_t * bus_p = NULL;
+    coverage_t * cov_p = NULL;
+    perf_counters_t counters;
+    int counting = 0;
+    const char * engine_name_p = "reference";
+    byte_t engine;
+    /* The job's budget, what this run may use of it, and where it started */
+    uint64_t budget_left = options.job_limit;
+    uint64_t budget;
+    uint64_t start_cycles;
+    /* Start of the job, then the end of each phase it gets through */
+    uint64_t phase_ends[ NUM_PHASES + 1 ] = { metrics_now_ns() };
 
     printf( "\nInput File (machine code): \t'%s'\n", in_bin_file );
     printf( "Output File   (.asm file): \t'%s'\n\n", out_asm_file );
 
+    /* Jobs of a job list reuse one microputer and bus */
+    if (job_mp_p != NULL)
+    {
+        mp_p = job_mp_p;
+        reset_microputer( mp_p );
+        restore_device_cursors( job_bus_p, &job_cursors );
+        phase_ends[ PHASE_LOAD + 1 ] = metrics_now_ns();
+        goto LOAD_PROGRAM;
+    }
+
     /* Memory allocation for the microputer struct */
     result = create_microputer( &mp_p );
     if (result != SUCCESS)
@@ -36,24 +529,203 @@ int start(char * in_bin_file, char * out_asm_file)
     /* Creates the pre-defined instruction set used for this project */
     create_instruction_set( mp_p );
 
-    /* Disassemble the machine code into .asm file & load program into memory */
-    result = disassemble_micro_program( mp_p, in_bin_file, out_asm_file );
+    /* Attaches the devices asked for on top of the default ones */
+    if (options.block_file_p != NULL || options.input_file_p != NULL
+        || output_p != NULL || options.ring_channel_p != NULL)
+    {
+        result = create_io_bus_with_devices( &bus_p );
+        if (result != SUCCESS)
+        {
+            printf( "\t# [ERROR: attaching the devices] #\n" );
+            goto FUNC_EXIT;
+        }
+        mp_p->bus_p = bus_p;
+    }
+
+    phase_ends[ PHASE_LOAD + 1 ] = metrics_now_ns();
+
+    LOAD_PROGRAM:
+    result = load_program( mp_p, in_bin_file, out_asm_file );
     if (result != SUCCESS)
     {
         printf( "\t# [ERROR: loading machine code program into memory] #\n" );
         goto FUNC_EXIT;
     }
 
-    result = execute_micro_program( mp_p );
+    phase_ends[ PHASE_DECODE + 1 ] = metrics_now_ns();
+
+    /* A job suspended by an earlier run carries on where it stopped */
+    if (options.snapshot_file_p != NULL)
+    {
+        result = resume_job( mp_p, &budget_left );
+        if (result != SUCCESS)
+        {
+            goto FUNC_EXIT;
+        }
+    }
+    budget = budget_left < options.slice ? budget_left : options.slice;
+    start_cycles = mp_p->cycles;
+
+    /* Coverage needs the run loop, so the reference engine is not used */
+    if (options.coverage_file_p != NULL)
+    {
+        result = create_coverage( &cov_p );
+        if (result != SUCCESS)
+        {
+            goto FUNC_EXIT;
+        }
+        mp_p->coverage_p = cov_p;
+    }
+
+    if (options.profile_file_p != NULL)
+    {
+        result = create_profiler( &profiler_p );
+        if (result == SUCCESS)
+        {
+            result = add_profile_target( profiler_p, mp_p, "main" );
+        }
+        if (result == SUCCESS)
+        {
+            result = start_profiler( profiler_p, PROFILE_INTERVAL_USEC );
+        }
+        if (result != SUCCESS)
+        {
+            printf( "\t# [ERROR: starting the profiler] #\n" );
+            goto FUNC_EXIT;
+        }
+    }
+
+    if (options.host_counters)
+    {
+        result = open_perf_counters( &counters );
+        if (result != SUCCESS)
+        {
+            goto FUNC_EXIT;
+        }
+        counting = 1;
+        start_perf_counters( &counters );
+    }
+
+    if (options.gdb_address_p != NULL)
+    {
+        /* Whatever is left after gdb detaches runs normally */
+        engine_name_p = "gdb";
+        result = serve_gdb( mp_p, options.gdb_address_p );
+        if (result == SUCCESS && !mp_p->halted)
+        {
+            result = run_micro_program( mp_p, RUN_UNBOUNDED );
+        }
+    } else if (options.num_breakpoints > 0 || options.watch_mask)
+    {
+        engine_name_p = "run_loop_debug";
+        result = execute_with_debugger( mp_p );
+    } else if (options.cores > 1)
+    {
+        engine_name_p = options.parallel ? "parallel machine" : "machine";
+        result = execute_on_machine( mp_p );
+    } else if (cov_p != NULL)
+    {
+        engine_name_p = "run_loop_coverage";
+        result = run_micro_program( mp_p, budget );
+    } else if (options.engine == ENGINE_AUTO)
+    {
+        engine = select_engine( selector_p, mp_p );
+        engine_name_p = engine_name( engine );
+        printf( "Engine: %s\n\n", engine_name_p );
+        result = run_engine( mp_p, engine, budget );
+    } else if (options.engine != 0)
+    {
+        engine_name_p = engine_name( (byte_t) options.engine );
+        result = run_engine( mp_p, (byte_t) options.engine, budget );
+    } else 
+    {
+        result = execute_micro_program_budget( mp_p, budget );
+    }
+    if (counting)
+    {
+        stop_perf_counters( &counters );
+    }
+    phase_ends[ PHASE_EXECUTE + 1 ] = metrics_now_ns();
+    /* What the program printed comes before any report about it */
+    if (output_p != NULL && output_p->file_p == stdout
+        && flush_output_sink( output_p ) != SUCCESS)
+    {
+        result = ERROR;
+    }
     if (result != SUCCESS)
     {
         printf( "\t# [ERROR: executing program's instructions] #\n" );
         goto FUNC_EXIT;
     }
 
+    if (budget != RUN_UNBOUNDED || options.snapshot_file_p != NULL)
+    {
+        result = end_job_run( mp_p, budget_left, mp_p->cycles - start_cycles );
+        if (result != SUCCESS)
+        {
+            goto FUNC_EXIT;
+        }
+    }
+
+    if (counting)
+    {
+        print_perf_counters( &counters, engine_name_p, mp_p->cycles );
+    }
+
+    if (profiler_p != NULL)
+    {
+        stop_profiler( profiler_p );
+        print_profile( profiler_p, mp_p );
+        result = write_folded_stacks( profiler_p, mp_p, 
+            options.profile_file_p, folded_written );
+        folded_written = 1;
+    }
+
+    if (cov_p != NULL && result == SUCCESS)
+    {
+        result = write_lcov_report( cov_p, mp_p, out_asm_file, 
+            (byte_t) options.annotate, options.coverage_file_p, 
+            lcov_written );
+        lcov_written = 1;
+    }
+
+    phase_ends[ PHASE_OUTPUT + 1 ] = metrics_now_ns();
+
     FUNC_EXIT:
 
+    if (metrics_p != NULL)
+    {
+        record_job( metrics_p, phase_ends, mp_p != NULL ? mp_p->cycles : 0,
+            result );
+        /* Kept fresh for a scraper without rewriting it for every job */
+        if (metrics_now_ns() - metrics_written_ns >= METRICS_WRITE_INTERVAL_NS)
+        {
+            write_prometheus_metrics( metrics_p, options.metrics_file_p );
+            metrics_written_ns = metrics_now_ns();
+        }
+    }
+
     /* Freeing memory allocation and prepares to exit */
+    if (counting)
+    {
+        close_perf_counters( &counters );
+    }
+    if (profiler_p != NULL)
+    {
+        delete_profiler( &profiler_p );
+    }
+    if (cov_p != NULL)
+    {
+        delete_coverage( &cov_p );
+    }
+    if (bus_p != NULL)
+    {
+        delete_io_bus( &bus_p );
+    }
+    if (mp_p == job_mp_p)
+    {
+        return result;
+    }
     result = delete_microputer( &mp_p );
     if (result != SUCCESS)
     {
@@ -63,6 +735,216 @@ int start(char * in_bin_file, char * out_asm_file)
     return result;
 }
 
+/// @brief Loads a job of a job list and hands it to the scheduler, which 
+/// runs it later on the job list's microputer
+/// @param sched_p the scheduler
+/// @param in_bin_file the file to read the machine code from
+/// @param out_asm_file the file to write the assembly to
+/// @param input_file_p the file its RDDs read, or NULL
+/// @param shared_input_p the values it reads without one
+/// @param tenant_p the tenant it runs for, or NULL
+/// @param priority its class
+/// @return 1 if SUCCESS, otherwise ERROR
+int queue_job(scheduler_t * sched_p, char * in_bin_file, char * out_asm_file,
+    const char * input_file_p, const input_t * shared_input_p,
+    const char * tenant_p, byte_t priority)
+{
+    uint64_t phase_ends[ PHASE_DECODE + 2 ] = { metrics_now_ns() };
+    byte_t engine;
+
+    /* Its snapshot starts the devices where a sequential run would */
+    reset_microputer( job_mp_p );
+    restore_device_cursors( job_bus_p, &job_cursors );
+    phase_ends[ PHASE_LOAD + 1 ] = metrics_now_ns();
+    if (load_program( job_mp_p, in_bin_file, out_asm_file ) != SUCCESS)
+    {
+        printf( "\t# [ERROR: loading machine code program into memory] #\n" );
+        return ERROR;
+    }
+    phase_ends[ PHASE_DECODE + 1 ] = metrics_now_ns();
+    if (options.engine == ENGINE_AUTO)
+    {
+        engine = select_engine( selector_p, job_mp_p );
+    } else
+    {
+        engine = options.engine ? (byte_t) options.engine : ENGINE_REFERENCE;
+    }
+    return add_sched_job( sched_p, job_mp_p, in_bin_file, tenant_p, priority,
+        engine, input_file_p, options.input_format, shared_input_p,
+        phase_ends );
+}
+
+/// @brief Runs every job of a job list in this process, on one microputer
+/// and bus. Each line is "in_bin_file out_asm_file [input_file] 
+/// [class=interactive|normal|batch] [tenant=name]"; blank lines and lines 
+/// starting with '#' are skipped. A job's RDDs read its input file (in the 
+/// -R format if given, else decimal), or the -r/-R file, or 0 without 
+/// either, since stdin may be the job list. With -Q, every job is loaded
+/// first and then scheduled by class and tenant (see scheduler.h); class and
+/// tenant are ignored otherwise
+/// @param job_file_p the job list, or "-" for stdin
+/// @return 1 if SUCCESS, otherwise ERROR (some job failed)
+int run_job_list(const char * job_file_p)
+{
+    FILE * file_p = strcmp( job_file_p, "-" ) == 0 
+        ? stdin : fopen( job_file_p, "r" );
+    char * line_p = NULL;
+    size_t line_capacity = 0;
+    char * in_bin_file_p;
+    char * out_asm_file_p;
+    char * input_file_p;
+    char * token_p;
+    const char * tenant_p;
+    int priority;
+    scheduler_t * sched_p = NULL;
+    /* The -r/-R values, read once and shared by the jobs without their own */
+    input_t shared_input = { 0 };
+    uint64_t num_jobs = 0;
+    uint64_t num_failed = 0;
+    int result = SUCCESS;
+
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n", 
+            job_file_p );
+        return ERROR;
+    }
+    if ((options.input_file_p != NULL
+        && load_input_file( &shared_input, options.input_file_p,
+            options.input_format ) != SUCCESS)
+        || create_microputer( &job_mp_p ) != SUCCESS
+        || create_io_bus_with_devices( &job_bus_p ) != SUCCESS)
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+    create_instruction_set( job_mp_p );
+    job_mp_p->bus_p = job_bus_p;
+    save_device_cursors( job_bus_p, &job_cursors );
+    if (options.sched_quantum > 0
+        && create_scheduler( &sched_p, options.sched_quantum ) != SUCCESS)
+    {
+        result = ERROR;
+        goto FUNC_EXIT;
+    }
+
+    while (getline( &line_p, &line_capacity, file_p ) != -1)
+    {
+        in_bin_file_p = strtok( line_p, " \t\r\n" );
+        if (in_bin_file_p == NULL || in_bin_file_p[ 0 ] == '#')
+        {
+            continue;
+        }
+        out_asm_file_p = strtok( NULL, " \t\r\n" );
+        input_file_p = NULL;
+        tenant_p = NULL;
+        priority = SCHED_NORMAL;
+        while ((token_p = strtok( NULL, " \t\r\n" )) != NULL)
+        {
+            if (strncmp( token_p, "class=", 6 ) == 0)
+            {
+                priority = parse_sched_class( token_p + 6 );
+            } else if (strncmp( token_p, "tenant=", 7 ) == 0)
+            {
+                tenant_p = token_p + 7;
+            } else
+            {
+                input_file_p = token_p;
+            }
+        }
+        num_jobs++;
+        if (out_asm_file_p == NULL || priority < 0)
+        {
+            printf( "\t# [ERROR: job %llu has no .asm file or an unknown "
+                "class] #\n", (unsigned long long) num_jobs );
+            num_failed++;
+            continue;
+        }
+        if (sched_p != NULL)
+        {
+            num_failed += queue_job( sched_p, in_bin_file_p, out_asm_file_p,
+                input_file_p, &shared_input, tenant_p, (byte_t) priority )
+                != SUCCESS;
+            continue;
+        }
+        if ((input_file_p != NULL
+            ? load_stream_console_input( job_bus_p->port_map[ CONSOLE_PORT ],
+                input_file_p, options.input_format )
+            : set_stream_console_values( job_bus_p->port_map[ CONSOLE_PORT ],
+                shared_input.values_p, shared_input.num_values )) != SUCCESS
+            || start( in_bin_file_p, out_asm_file_p ) != SUCCESS)
+        {
+            num_failed++;
+        }
+    }
+    if (sched_p != NULL)
+    {
+        run_scheduler( sched_p, job_mp_p, metrics_p );
+        for (uint64_t i = 0; i < sched_p->num_jobs; i++)
+        {
+            num_failed += sched_p->jobs_p[ i ].result != SUCCESS;
+        }
+        /* What the jobs printed comes before the report about them */
+        if (output_p != NULL && output_p->file_p == stdout)
+        {
+            flush_output_sink( output_p );
+        }
+        print_schedule_report( sched_p );
+    }
+    printf( "\nJobs: %llu run, %llu failed\n", (unsigned long long) num_jobs,
+        (unsigned long long) num_failed );
+    result = num_failed == 0 ? SUCCESS : ERROR;
+
+    FUNC_EXIT:
+    free( line_p );
+    if (file_p != stdin)
+    {
+        fclose( file_p );
+    }
+    if (sched_p != NULL)
+    {
+        delete_scheduler( &sched_p );
+    }
+    if (job_bus_p != NULL)
+    {
+        delete_io_bus( &job_bus_p );
+    }
+    if (job_mp_p != NULL)
+    {
+        delete_microputer( &job_mp_p );
+    }
+    /* After the bus, whose console may still point into it */
+    unload_input_file( &shared_input );
+    return result;
+}
+
+/// @brief Runs every .dat member of an archive as a job of one batch (see
+/// batch.h) on the engine given with -e, the reference one by default. A
+/// job's RDDs read the archive's "x.in" member for "x.dat", or 0 without one
+/// @param archive_file_p the archive
+/// @return 1 if SUCCESS, otherwise ERROR (some job failed)
+int run_batch(const char * archive_file_p)
+{
+    batch_params_t params;
+    io_bus_t * bus_p = NULL;
+    int result;
+
+    if (create_io_bus_with_devices( &bus_p ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    params.engine = options.engine ? (byte_t) options.engine 
+        : ENGINE_REFERENCE;
+    params.selector_p = selector_p;
+    params.bus_p = bus_p;
+    params.sink_p = output_p;
+    params.prefetch_depth = options.prefetch_depth;
+    params.huge_pages = (byte_t) options.huge_pages;
+    result = run_archive_batch( archive_file_p, &params );
+    delete_io_bus( &bus_p );
+    return result;
+}
+
 /// @brief Runs the program for the 3 provided test files
 /// @return if all succeed SUCCESS, otherwise ERROR
 int run_default_tests() 
@@ -89,22 +971,416 @@ int run_default_tests()
     return result;
 }
 
+/// @brief Parses an option's argument as a whole decimal number in a range
+/// @param opt the option
+/// @param arg_p its argument
+/// @param min the smallest value allowed
+/// @param max the largest value allowed
+/// @param out_value_p the number
+/// @return 1 if SUCCESS, otherwise ERROR
+int parse_number_option(char opt, const char * arg_p, unsigned long long min,
+    unsigned long long max, unsigned long long * out_value_p)
+{
+    char * end_p = NULL;
+
+    errno = 0;
+    *out_value_p = strtoull( arg_p, &end_p, 10 );
+    if (arg_p[ 0 ] < '0' || arg_p[ 0 ] > '9' || *end_p != '\0' 
+        || errno != 0 || *out_value_p < min || *out_value_p > max)
+    {
+        printf( "\t# [ERROR: -%c needs a number from %llu to %llu, not "
+            "'%s'] #\n", opt, min, max, arg_p );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Splits an option argument of the form "first:second" in two
+/// @param arg_p the argument, cut short at the ':'
+/// @return the second part, or NULL without a ':'
+char * split_option_argument(char * arg_p)
+{
+    char * second_p = strchr( arg_p, ':' );
+
+    if (second_p != NULL)
+    {
+        *second_p++ = '\0';
+    }
+    return second_p;
+}
+
 /// @brief Main function for running the program
 /// @param argc the argument count
-/// @param argv for the input file and output file, in that order
+/// @param argv options, then the input file and output file, in that order
 /// @return 1 if SUCCESS, otherwise ERROR
 int main(int argc, char *argv[])
 {
     int result = SUCCESS;
+    int opt = 0;
+    char * end_p = NULL;
+    unsigned long long value;
+
+    options.prefetch_depth = BATCH_PREFETCH_DEPTH;
+    options.slice = RUN_UNBOUNDED;
+    options.job_limit = RUN_UNBOUNDED;
+    while ((opt = getopt( argc, argv, 
+        "aA:b:B:c:D:e:E:g:G:HiJ:K:L:m:M:n:O:pP:q:Q:r:R:S:TW:X:y:Y:zZ:" )) != -1)
+    {
+        switch (opt)
+        {
+            case 'a': options.annotate = 1; break;
+            case 'A': options.batch_archive_p = optarg; break;
+            case 'b': options.block_file_p = optarg; break;
+            case 'B':
+                /* Alignment is checked when the breakpoint is set */
+                if (parse_number_option( 'B', optarg, 0, MEM_BYTE_SIZE - 1,
+                    &value ) != SUCCESS)
+                {
+                    return ERROR;
+                }
+                if (options.num_breakpoints < MEM_WORD_COUNT)
+                {
+                    options.breakpoints[ options.num_breakpoints++ ] = 
+                        (uint16_t) value;
+                }
+                break;
+            case 'c': options.coverage_file_p = optarg; break;
+            case 'D':
+                /* count[:seed] */
+                end_p = split_option_argument( optarg );
+                value = 1;
+                if (parse_number_option( 'D', optarg, 1, UINT32_MAX,
+                    &options.diff_count ) != SUCCESS
+                    || (end_p != NULL && parse_number_option( 'D', end_p, 0,
+                        UINT32_MAX, &value ) != SUCCESS))
+                {
+                    return ERROR;
+                }
+                options.diff_seed = (uint32_t) value;
+                break;
+            case 'e':
+                options.engine = strcmp( optarg, "auto" ) == 0 ? ENGINE_AUTO 
+                    : strcmp( optarg, "run_loop" ) == 0 ? ENGINE_RUN_LOOP
+                    : strcmp( optarg, "predecoded" ) == 0 ? ENGINE_PREDECODED 
+                    : strcmp( optarg, "reference" ) == 0 ? 0 : -1;
+                if (options.engine < 0)
+                {
+                    printf( "\t# [ERROR: there is no engine '%s'] #\n", 
+                        optarg );
+                    return ERROR;
+                }
+                break;
+            case 'E':
+                options.engine = ENGINE_AUTO;
+                options.engine_cache_file_p = optarg;
+                break;
+            case 'g': options.gdb_address_p = optarg; break;
+            case 'G': options.gen_archive_file_p = optarg; break;
+            case 'H': options.host_counters = 1; break;
+            case 'T': options.huge_pages = 1; break;
+            case 'W':
+                if (parse_number_option( 'W', optarg, 0, NUM_REGISTERS - 1,
+                    &value ) != SUCCESS)
+                {
+                    return ERROR;
+                }
+                options.watch_mask |= (uint16_t) (1u << value);
+                break;
+            case 'i': options.incremental = 1; break;
+            case 'J': options.job_file_p = optarg; break;
+            case 'K':
+                if (parse_number_option( 'K', optarg, 0, 
+                    BATCH_MAX_PREFETCH_DEPTH, &value ) != SUCCESS)
+                {
+                    return ERROR;
+                }
+                options.prefetch_depth = (int) value;
+                break;
+            case 'L':
+                end_p = split_option_argument( optarg );
+                if (parse_number_option( 'L', optarg, 1, RUN_UNBOUNDED - 1,
+                    &options.slice ) != SUCCESS
+                    || (end_p != NULL && parse_number_option( 'L', end_p, 1,
+                        RUN_UNBOUNDED - 1, &options.job_limit ) != SUCCESS))
+                {
+                    return ERROR;
+                }
+                break;
+            case 'm': options.gen_mix_p = optarg; break;
+            case 'M': options.metrics_file_p = optarg; break;
+            case 'n':
+                if (parse_number_option( 'n', optarg, 1, MAX_CORES, &value )
+                    != SUCCESS)
+                {
+                    return ERROR;
+                }
+                options.cores = (int) value;
+                break;
+            case 'O': options.output_spec_p = optarg; break;
+            case 'X': options.decompress_file_p = optarg; break;
+            case 'y': options.ring_channel_p = optarg; break;
+            case 'Y': options.ring_client_p = optarg; break;
+            case 'z': options.compress_output = 1; break;
+            case 'Z': options.snapshot_file_p = optarg; break;
+            case 'p': options.parallel = 1; break;
+            case 'P': options.profile_file_p = optarg; break;
+            case 'r':
+                options.input_file_p = optarg;
+                options.input_format = INPUT_TEXT;
+                break;
+            case 'R':
+                options.input_file_p = optarg;
+                options.input_format = INPUT_BINARY;
+                break;
+            case 'S': options.spec_values_p = optarg; break;
+            case 'q':
+                if (parse_number_option( 'q', optarg, 1, RUN_UNBOUNDED - 1,
+                    &options.quantum ) != SUCCESS)
+                {
+                    return ERROR;
+                }
+                break;
+            case 'Q':
+                if (parse_number_option( 'Q', optarg, 1, RUN_UNBOUNDED - 1,
+                    &options.sched_quantum ) != SUCCESS)
+                {
+                    return ERROR;
+                }
+                break;
+            default:
+                printf( "usage: %s [-aHipT] [-b block_file] [-B addr] [-W reg] "
+                    "[-c info_file] [-D count[:seed]] [-e engine] [-E cache_file] [-g port|path] [-n cores] [-q quantum] "
+                    "[-P folded_file] [-M metrics_file] "
+                    "[-G archive_file [-m mix]] "
+                    "[-r|-R input_file] [-O text|binary[:file] [-z]] "
+                    "[-X lz_file] [-J job_file|- [-Q quantum]] "
+                    "[-A archive_file [-K depth]] "
+                    "[-S values in_bin_file out_bin_file] "
+                    "[-L slice[:limit]] [-Z snapshot_file] "
+                    "[-y channel] [-Y channel] "
+                    "[in_bin_file out_asm_file]...\n", 
+                    argv[ 0 ] );
+                printf( "\t-a  annotate the listing with labels and xrefs "
+                    "(overrides -i)\n" );
+                printf( "\t-b  attach a block device backed by the file at "
+                    "port %d\n", BLOCK_PORT );
+                printf( "\t-i  re-disassemble only words changed since "
+                    "the last run\n" );
+                printf( "\t-B  report each time execution reaches addr "
+                    "(single core, repeatable)\n" );
+                printf( "\t-W  report each change to register reg "
+                    "(single core, repeatable)\n" );
+                printf( "\t-c  write lcov coverage of the .asm lines to "
+                    "info_file\n" );
+                printf( "\t-D  run the files and count random programs on "
+                    "every engine in\n\t    parallel and compare them "
+                    "with the reference\n" );
+                printf( "\t-T  with -D, keep the corpus and instances in an "
+                    "arena on 2 MiB huge\n\t    pages\n" );
+                printf( "\t-e  run single core programs on 'reference' "
+                    "(default), 'run_loop',\n\t    'predecoded' or 'auto' "
+                    "(picked per program)\n" );
+                printf( "\t-E  like -e auto, keeping the choices in "
+                    "cache_file between runs\n" );
+                printf( "\t-S  specialize in_bin_file to the given values of "
+                    "its first console\n\t    reads (e.g. 3,250) and write "
+                    "the smaller residual program\n" );
+                printf( "\t-G  generate random programs that halt into the "
+                    "tar archive_file,\n\t    with a manifest of their "
+                    "instruction counts\n" );
+                printf( "\t-m  the mix, e.g. count=100,len=16,alu=60,prt=10,"
+                    "rdd=5,depth=2,\n\t    max=100000,seed=1 (the "
+                    "defaults)\n" );
+                printf( "\t-H  report host cycles, instructions, branch, "
+                    "L1d and dTLB misses\n\t    per simulated "
+                    "instruction\n" );
+                printf( "\t-g  wait for gdb on a localhost TCP port or Unix "
+                    "socket path\n" );
+                printf( "\t-M  write latency percentiles and throughput to "
+                    "metrics_file\n\t    (Prometheus text format) every "
+                    "second while jobs run, and at exit\n" );
+                printf( "\t-n  run the program on n cores sharing memory "
+                    "(core i starts with R15 = i)\n" );
+                printf( "\t-q  instructions per core per turn (default %d)\n", 
+                    DEFAULT_QUANTUM );
+                printf( "\t-r  RDD on the console reads the decimal numbers "
+                    "in input_file\n\t    instead of stdin\n" );
+                printf( "\t-R  RDD on the console reads the bytes of the "
+                    "binary input_file\n" );
+                printf( "\t-O  buffer PRT output as text lines or (register, "
+                    "value) byte pairs\n\t    into stdout or file\n" );
+                printf( "\t-z  compress the -O file on a background thread "
+                    "(LZ blocks)\n" );
+                printf( "\t-X  decompress an -z file to stdout\n" );
+                printf( "\t-J  run the jobs listed in job_file (or stdin), "
+                    "one per line:\n\t    in_bin_file out_asm_file "
+                    "[input_file] [class=c] [tenant=t]\n" );
+                printf( "\t-Q  with -J, load every job first, then run them "
+                    "quantum instructions\n\t    at a time by class= and "
+                    "tenant= (interactive first, fair\n\t    share between "
+                    "tenants)\n" );
+                printf( "\t-A  run each .dat program of the tar archive_file "
+                    "(RDD reads x.in\n\t    for x.dat), checked against its "
+                    "manifest\n" );
+                printf( "\t-K  with -A, prefetch the next depth jobs while one "
+                    "runs (default %d,\n\t    0 = off)\n", 
+                    BATCH_PREFETCH_DEPTH );
+                printf( "\t-L  run a single core job slice instructions at a "
+                    "time, and at most\n\t    limit in all\n" );
+                printf( "\t-Z  resume the job from snapshot_file if it "
+                    "exists, and suspend it\n\t    into it when its slice "
+                    "runs out (for any process to resume)\n" );
+                printf( "\t-y  RDD and PRT on the console go over the shared "
+                    "memory ring channel\n\t    (RDD reads 0 once the "
+                    "client is done)\n" );
+                printf( "\t-Y  be the client of a -y channel: send it the "
+                    "numbers on stdin and\n\t    print what comes back, "
+                    "until the program ends\n" );
+                printf( "\t-p  simulate the cores on parallel host threads\n" );
+                printf( "\t-P  sample the running instruction every %d us of "
+                    "CPU time; print a\n\t    histogram and write folded "
+                    "stacks for flame graphs\n", PROFILE_INTERVAL_USEC );
+                return ERROR;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (options.diff_count > 0)
+    {
+        return run_differential_tests( argv, argc, options.diff_count, 
+            options.diff_seed, (int) sysconf( _SC_NPROCESSORS_ONLN ),
+            (byte_t) options.huge_pages, (byte_t) options.host_counters );
+    }
+    if (options.decompress_file_p != NULL)
+    {
+        return decompress_lz_file( options.decompress_file_p, stdout );
+    }
+    if (options.gen_archive_file_p != NULL)
+    {
+        gen_params_t params;
 
-    if (argc >= 2 && strlen( argv[ 1 ] ) && strlen( argv[ 2 ] ))
+        default_gen_params( &params );
+        if (options.gen_mix_p != NULL 
+            && parse_gen_params( &params, options.gen_mix_p ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        return generate_program_archive( &params, 
+            options.gen_archive_file_p );
+    }
+    if (options.spec_values_p != NULL)
+    {
+        if (argc < 2)
+        {
+            printf( "\t# [ERROR: -S needs in_bin_file out_bin_file] #\n" );
+            return ERROR;
+        }
+        return specialize_program_file( argv[ 0 ], options.spec_values_p,
+            argv[ 1 ] );
+    }
+
+    if (options.ring_client_p != NULL)
+    {
+        return pump_shm_channel( options.ring_client_p, stdin, stdout );
+    }
+    /* The rings have one reader and one writer, and take the console's 
+       place, so other consoles and parallel cores can't share them */
+    if (options.ring_channel_p != NULL
+        && (options.input_file_p != NULL || options.output_spec_p != NULL
+            || options.job_file_p != NULL || options.batch_archive_p != NULL
+            || options.parallel))
+    {
+        printf( "\t# [ERROR: -y can't be used with -r, -R, -O, -J, -A or "
+            "-p] #\n" );
+        return ERROR;
+    }
+    /* Only a single core run with a budget can stop between instructions,
+       and one snapshot holds one job */
+    if ((options.slice != RUN_UNBOUNDED || options.job_limit != RUN_UNBOUNDED
+        || options.snapshot_file_p != NULL)
+        && (options.cores > 1 || options.gdb_address_p != NULL
+            || options.num_breakpoints > 0 || options.watch_mask
+            || options.job_file_p != NULL || options.batch_archive_p != NULL
+            || (options.snapshot_file_p != NULL && argc != 2)))
+    {
+        printf( "\t# [ERROR: -L and -Z are for one single core job] #\n" );
+        return ERROR;
+    }
+
+    if (options.output_spec_p != NULL && create_output() != SUCCESS)
+    {
+        return ERROR;
+    }
+    if (options.metrics_file_p != NULL 
+        && create_metrics( &metrics_p ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    if (options.engine == ENGINE_AUTO)
+    {
+        if (create_selector( &selector_p ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        if (options.engine_cache_file_p != NULL)
+        {
+            load_selector_cache( selector_p, options.engine_cache_file_p );
+        }
+    }
+
+    if (options.batch_archive_p != NULL)
     {
-        result = start( argv[ 1 ], argv[ 2 ] );
+        result = run_batch( options.batch_archive_p );
+    } else if (options.job_file_p != NULL)
+    {
+        result = run_job_list( options.job_file_p );
+    } else if (argc >= 2 && strlen( argv[ 0 ] ) && strlen( argv[ 1 ] ))
+    {
+        /* Each pair of files is a job of the batch */
+        for (int i = 0; i + 1 < argc && result == SUCCESS; i += 2)
+        {
+            result = start( argv[ i ], argv[ i + 1 ] );
+        }
     } else 
     {
         printf( "\n\t# [WARNING: Files were not specified properly] #\n" );
         printf( "\t# [Executing tests with the 3 default files...] #\n" );
         run_default_tests();
     }
+
+    if (selector_p != NULL)
+    {
+        if (options.engine_cache_file_p != NULL)
+        {
+            save_selector_cache( selector_p, options.engine_cache_file_p );
+        }
+        delete_selector( &selector_p );
+    }
+    if (metrics_p != NULL)
+    {
+        write_prometheus_metrics( metrics_p, options.metrics_file_p );
+        delete_metrics( &metrics_p );
+    }
+    if (output_p != NULL)
+    {
+        FILE * file_p = output_p->file_p;
+        lz_stream_t * lz_p = output_p->lz_p;
+
+        /* The sink's last flush writes into the file, so it goes first;
+           the stream is finished even if the sink failed */
+        if (delete_output_sink( &output_p ) != SUCCESS)
+        {
+            result = ERROR;
+        }
+        if (lz_p != NULL && delete_lz_stream( &lz_p ) != SUCCESS)
+        {
+            result = ERROR;
+        }
+        if (file_p != stdout)
+        {
+            fclose( file_p );
+        }
+    }
     return result;
 }
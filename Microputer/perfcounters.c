@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Host hardware counters (perf_event_open) around microputer engines, to
+/// see what each dispatch strategy costs per simulated instruction
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfcounters.h"
+
+/***************************** Globals ****************************************/
+
+/* What each counter counts, in the order of perf_counters_t.fds */
+static const struct {
+    const char * name_p;
+    uint32_t type;
+    uint64_t config;
+} perf_events[ NUM_PERF_COUNTERS ] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d-read-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "dTLB-load-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+};
+
+/*******************************************************************************
+ *          Performance Counter Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Opens the counters, stopped and at zero; user space only, and
+/// inherited by threads started afterwards (e.g. a parallel machine's cores)
+/// @param counters_p the counters
+/// @return 1 if SUCCESS, otherwise ERROR (when no counter could be opened)
+int open_perf_counters(perf_counters_t * counters_p)
+{
+    struct perf_event_attr attr;
+    int num_open = 0;
+
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        memset( &attr, 0, sizeof( attr ) );
+        attr.size = sizeof( attr );
+        attr.type = perf_events[ i ].type;
+        attr.config = perf_events[ i ].config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters_p->fds[ i ] = (int) syscall( SYS_perf_event_open, &attr, 0,
+            -1, -1, 0 );
+        counters_p->values[ i ] = 0;
+        if (counters_p->fds[ i ] >= 0)
+        {
+            num_open++;
+        }
+    }
+
+    if (num_open == 0)
+    {
+        printf( "\t# [ERROR: perf_event_open gave no counters (see "
+            "/proc/sys/kernel/perf_event_paranoid)] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Closes the counters
+/// @param counters_p the counters
+void close_perf_counters(perf_counters_t * counters_p)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters_p->fds[ i ] >= 0)
+        {
+            close( counters_p->fds[ i ] );
+            counters_p->fds[ i ] = -1;
+        }
+    }
+}
+
+/*******************************************************************************
+ *                      Performance Counter Functions
+ ******************************************************************************/
+
+/// @brief Zeroes and starts the counters; call right before the engine
+/// @param counters_p the counters
+void start_perf_counters(perf_counters_t * counters_p)
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters_p->fds[ i ] >= 0)
+        {
+            ioctl( counters_p->fds[ i ], PERF_EVENT_IOC_RESET, 0 );
+            ioctl( counters_p->fds[ i ], PERF_EVENT_IOC_ENABLE, 0 );
+        }
+    }
+}
+
+/// @brief Stops the counters and reads them; call right after the engine
+/// @param counters_p the counters
+void stop_perf_counters(perf_counters_t * counters_p)
+{
+    /* value, time enabled, time running */
+    uint64_t data[ 3 ];
+
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters_p->fds[ i ] < 0)
+        {
+            continue;
+        }
+        ioctl( counters_p->fds[ i ], PERF_EVENT_IOC_DISABLE, 0 );
+        if (read( counters_p->fds[ i ], data, sizeof( data ) )
+            != sizeof( data ))
+        {
+            counters_p->values[ i ] = 0;
+        } else if (data[ 2 ] > 0 && data[ 2 ] < data[ 1 ])
+        {
+            counters_p->values[ i ] = (uint64_t) ((double) data[ 0 ]
+                * data[ 1 ] / data[ 2 ]);
+        } else
+        {
+            counters_p->values[ i ] = data[ 0 ];
+        }
+    }
+}
+
+/// @brief Prints each counter in total and per simulated instruction
+/// @param counters_p the counters, stopped
+/// @param engine_name_p the engine that ran between start and stop
+/// @param instructions simulated instructions the engine executed
+void print_perf_counters(const perf_counters_t * counters_p,
+    const char * engine_name_p, uint64_t instructions)
+{
+    printf( "\nHost counters (%s, %llu simulated instructions):\n",
+        engine_name_p, (unsigned long long) instructions );
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+    {
+        if (counters_p->fds[ i ] < 0)
+        {
+            printf( "\t%-16s %16s\n", perf_events[ i ].name_p,
+                "not supported" );
+        } else
+        {
+            printf( "\t%-16s %16llu %10.2f / instr\n", perf_events[ i ].name_p,
+                (unsigned long long) counters_p->values[ i ],
+                instructions ? (double) counters_p->values[ i ]
+                    / instructions : 0.0 );
+        }
+    }
+}
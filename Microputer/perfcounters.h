@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for host hardware counters around microputer engines
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Host cycles, instructions, branch misses, L1d read misses and dTLB load
+   misses */
+#define NUM_PERF_COUNTERS 5
+
+/******************* Performance Counter Structs & Types **********************/
+
+/* Linux perf_event counters of this process (and threads it starts while
+   they are open); a counter the host will not give us is left out */
+struct perf_counters_s {
+    int fds[ NUM_PERF_COUNTERS ];
+    /* Counts, scaled up if the kernel had to multiplex the counters */
+    uint64_t values[ NUM_PERF_COUNTERS ];
+} typedef perf_counters_t;
+
+/****************** Public Performance Counter Functions **********************/
+
+int open_perf_counters(perf_counters_t * counters_p);
+void close_perf_counters(perf_counters_t * counters_p);
+void start_perf_counters(perf_counters_t * counters_p);
+void stop_perf_counters(perf_counters_t * counters_p);
+void print_perf_counters(const perf_counters_t * counters_p,
+    const char * engine_name_p, uint64_t instructions);
+
+#endif
@@ -0,0 +1,346 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Sampling profiler: a SIGPROF timer reads the address and engine each
+/// microputer publishes, building per-instruction histograms and folded
+/// stacks for flame graphs
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+
+/***************************** Globals ****************************************/
+
+/* The profiler the SIGPROF handler samples into; one runs at a time */
+static profiler_t * volatile active_profiler_p = NULL;
+
+/* SIGPROF handlers running right now, on any thread */
+static volatile int samples_in_progress = 0;
+
+/*******************************************************************************
+ *                          Private Functions
+ ******************************************************************************/
+
+/// @brief Waits until no SIGPROF handler is running, so one that read a
+/// profiler or target before it was taken away is done with it
+static void wait_for_samples(void)
+{
+    while (__atomic_load_n( &samples_in_progress, __ATOMIC_SEQ_CST ) != 0)
+    {
+        sched_yield();
+    }
+}
+
+/*******************************************************************************
+ *              Profiler Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates a profiler with no targets
+/// @param out_prof_pp a pointer to a pointer of the profiler
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_profiler(profiler_t ** out_prof_pp)
+{
+    *out_prof_pp = (profiler_t *) calloc( 1, sizeof( profiler_t ) );
+    if (*out_prof_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_prof_pp] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Stops the profiler if it is running and frees it
+/// @param prof_pp a pointer to a pointer of the profiler
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_profiler(profiler_t ** prof_pp)
+{
+    if (*prof_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *prof_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    if (active_profiler_p == *prof_pp)
+    {
+        stop_profiler( *prof_pp );
+    }
+    free( *prof_pp );
+    *prof_pp = NULL;
+    return SUCCESS;
+}
+
+/// @brief Starts sampling a microputer; safe while the profiler is running
+/// @param prof_p the profiler
+/// @param mp_p the microputer
+/// @param name_p the name its samples are reported under
+/// @return 1 if SUCCESS, otherwise ERROR
+int add_profile_target(profiler_t * prof_p, microputer_t * mp_p,
+    const char * name_p)
+{
+    int i = prof_p->num_targets;
+
+    if (i >= MAX_PROFILE_TARGETS)
+    {
+        printf( "\t# [ERROR: profiler can only sample %d microputers] #\n",
+            MAX_PROFILE_TARGETS );
+        return ERROR;
+    }
+    snprintf( prof_p->names[ i ], MAX_TARGET_NAME_LEN, "%s", name_p );
+    prof_p->targets_p[ i ] = mp_p;
+    /* Published last, so the handler never sees a half-filled slot */
+    __atomic_store_n( &prof_p->num_targets, i + 1, __ATOMIC_RELEASE );
+    return SUCCESS;
+}
+
+/// @brief Stops sampling a microputer (e.g. before it is deleted); the
+/// samples taken so far are kept. Returns once no SIGPROF handler can still
+/// be reading it
+/// @param prof_p the profiler
+/// @param mp_p the microputer
+void remove_profile_target(profiler_t * prof_p, microputer_t * mp_p)
+{
+    for (int i = 0; i < prof_p->num_targets; i++)
+    {
+        if (prof_p->targets_p[ i ] == mp_p)
+        {
+            __atomic_store_n( &prof_p->targets_p[ i ], NULL, 
+                __ATOMIC_SEQ_CST );
+        }
+    }
+    wait_for_samples();
+}
+
+/*******************************************************************************
+ *                          Sampling Functions
+ ******************************************************************************/
+
+/// @brief SIGPROF handler; counts the instruction each running target is at.
+/// Only reads what the engines publish and adds to counters, so it is
+/// async-signal-safe. It is counted in samples_in_progress before it reads
+/// the profiler or a target, so neither is freed while it runs
+/// @param signal_number SIGPROF
+static void take_sample(int signal_number)
+{
+    profiler_t * prof_p;
+    microputer_t * mp_p;
+    int num_targets;
+    int running = 0;
+    byte_t engine;
+    uint16_t word;
+
+    (void) signal_number;
+    __atomic_fetch_add( &samples_in_progress, 1, __ATOMIC_SEQ_CST );
+    prof_p = __atomic_load_n( &active_profiler_p, __ATOMIC_SEQ_CST );
+    if (prof_p == NULL)
+    {
+        goto FUNC_EXIT;
+    }
+
+    num_targets = __atomic_load_n( &prof_p->num_targets, __ATOMIC_ACQUIRE );
+    for (int i = 0; i < num_targets; i++)
+    {
+        mp_p = __atomic_load_n( &prof_p->targets_p[ i ], __ATOMIC_SEQ_CST );
+        if (mp_p == NULL)
+        {
+            continue;
+        }
+        engine = mp_p->engine;
+        word = mp_p->sample_pc / WORD_SIZE;
+        if (engine == ENGINE_IDLE || engine >= NUM_ENGINES
+            || word >= MEM_WORD_COUNT)
+        {
+            continue;
+        }
+        /* Atomic, since SIGPROF may land on any thread of a parallel run */
+        __atomic_fetch_add( &prof_p->samples[ i ][ engine ][ word ], 1,
+            __ATOMIC_RELAXED );
+        running = 1;
+    }
+    if (!running)
+    {
+        __atomic_fetch_add( &prof_p->idle_samples, 1, __ATOMIC_RELAXED );
+    }
+
+    FUNC_EXIT:
+    __atomic_fetch_sub( &samples_in_progress, 1, __ATOMIC_SEQ_CST );
+}
+
+/// @brief Installs the SIGPROF handler and starts the host profiling timer
+/// @param prof_p the profiler
+/// @param interval_usec host CPU time between samples, in microseconds
+/// @return 1 if SUCCESS, otherwise ERROR
+int start_profiler(profiler_t * prof_p, long interval_usec)
+{
+    struct sigaction action;
+    struct itimerval timer;
+
+    if (active_profiler_p != NULL)
+    {
+        printf( "\t# [ERROR: a profiler is already running] #\n" );
+        return ERROR;
+    }
+    active_profiler_p = prof_p;
+
+    memset( &action, 0, sizeof( action ) );
+    action.sa_handler = take_sample;
+    /* Console reads and socket I/O carry on across samples */
+    action.sa_flags = SA_RESTART;
+    sigemptyset( &action.sa_mask );
+    if (sigaction( SIGPROF, &action, &prof_p->old_action ) != 0)
+    {
+        printf( "\t# [ERROR: could not install the SIGPROF handler] #\n" );
+        active_profiler_p = NULL;
+        return ERROR;
+    }
+
+    timer.it_interval.tv_sec = interval_usec / 1000000;
+    timer.it_interval.tv_usec = interval_usec % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer( ITIMER_PROF, &timer, &prof_p->old_timer ) != 0)
+    {
+        printf( "\t# [ERROR: could not start the profiling timer] #\n" );
+        sigaction( SIGPROF, &prof_p->old_action, NULL );
+        active_profiler_p = NULL;
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Stops the timer and puts SIGPROF back the way it was; returns
+/// once no SIGPROF handler can still be sampling into the profiler
+/// @param prof_p the profiler
+void stop_profiler(profiler_t * prof_p)
+{
+    if (active_profiler_p != prof_p)
+    {
+        return;
+    }
+    setitimer( ITIMER_PROF, &prof_p->old_timer, NULL );
+    sigaction( SIGPROF, &prof_p->old_action, NULL );
+    __atomic_store_n( &active_profiler_p, NULL, __ATOMIC_SEQ_CST );
+    wait_for_samples();
+}
+
+/*******************************************************************************
+ *                          Report Functions
+ ******************************************************************************/
+
+/// @brief Disassembles the word a sample was counted against
+/// @param mp_p a microputer with the program loaded
+/// @param word index of the word
+/// @param out_line_buffer_p the assembly instruction string
+static void sample_instruction(microputer_t * mp_p, uint16_t word,
+    char * out_line_buffer_p)
+{
+    uint16_t instr = (uint16_t) ((mp_p->mem_p[ word * WORD_SIZE ] << 8)
+        | mp_p->mem_p[ word * WORD_SIZE + 1 ]);
+
+    out_line_buffer_p[ 0 ] = '\0';
+    (*mp_p->instr_set[ instr >> 13 ].disassembler)( instr, out_line_buffer_p );
+}
+
+/// @brief Prints how many samples landed on each instruction and in each
+/// engine, with a bar for each instruction's share
+/// @param prof_p the profiler
+/// @param mp_p a microputer with the program loaded, for the disassembly
+void print_profile(const profiler_t * prof_p, microputer_t * mp_p)
+{
+    uint64_t by_word[ MEM_WORD_COUNT ] = { 0 };
+    uint64_t by_engine[ NUM_ENGINES ] = { 0 };
+    uint64_t total = 0;
+    char line[ MAX_ASM_LINE_LEN ];
+
+    for (int i = 0; i < prof_p->num_targets; i++)
+    {
+        for (int e = 0; e < NUM_ENGINES; e++)
+        {
+            for (int w = 0; w < MEM_WORD_COUNT; w++)
+            {
+                by_word[ w ] += prof_p->samples[ i ][ e ][ w ];
+                by_engine[ e ] += prof_p->samples[ i ][ e ][ w ];
+                total += prof_p->samples[ i ][ e ][ w ];
+            }
+        }
+    }
+
+    printf( "\nProfile: %llu samples (%llu outside the program)\n",
+        (unsigned long long) total,
+        (unsigned long long) prof_p->idle_samples );
+    if (total == 0)
+    {
+        return;
+    }
+
+    for (int w = 0; w < mp_p->loaded_mem_slots / WORD_SIZE; w++)
+    {
+        sample_instruction( mp_p, (uint16_t) w, line );
+        printf( "\t0x%02X  %-14s %8llu %5.1f%%  ", w * WORD_SIZE, line,
+            (unsigned long long) by_word[ w ], 100.0 * by_word[ w ] / total );
+        for (uint64_t bar = 0; bar < by_word[ w ] * 40 / total; bar++)
+        {
+            putchar( '#' );
+        }
+        putchar( '\n' );
+    }
+    for (int e = 0; e < NUM_ENGINES; e++)
+    {
+        if (by_engine[ e ] > 0)
+        {
+            printf( "\t%-30s %8llu %5.1f%%\n", engine_name( (byte_t) e ),
+                (unsigned long long) by_engine[ e ],
+                100.0 * by_engine[ e ] / total );
+        }
+    }
+}
+
+/// @brief Writes the samples as folded stacks (target;engine;instruction
+/// count), the input format of flamegraph.pl and similar tools, which add
+/// up repeated stacks
+/// @param prof_p the profiler
+/// @param mp_p a microputer with the program loaded, for the disassembly
+/// @param folded_file_name_p the file to write
+/// @param append 1 to add the stacks to the file, 0 to replace it
+/// @return 1 if SUCCESS, otherwise ERROR
+int write_folded_stacks(const profiler_t * prof_p, microputer_t * mp_p,
+    const char * folded_file_name_p, byte_t append)
+{
+    FILE * folded_file_p = fopen( folded_file_name_p, append ? "a" : "w" );
+    char line[ MAX_ASM_LINE_LEN ];
+
+    if (folded_file_p == NULL)
+    {
+        printf( "\t# [ERROR: Could not open '%s'] #\n", folded_file_name_p );
+        return ERROR;
+    }
+
+    for (int i = 0; i < prof_p->num_targets; i++)
+    {
+        for (int e = 0; e < NUM_ENGINES; e++)
+        {
+            for (int w = 0; w < MEM_WORD_COUNT; w++)
+            {
+                if (prof_p->samples[ i ][ e ][ w ] == 0)
+                {
+                    continue;
+                }
+                sample_instruction( mp_p, (uint16_t) w, line );
+                fprintf( folded_file_p, "%s;%s;0x%02X %s %llu\n",
+                    prof_p->names[ i ], engine_name( (byte_t) e ),
+                    w * WORD_SIZE, line,
+                    (unsigned long long) prof_p->samples[ i ][ e ][ w ] );
+            }
+        }
+    }
+    if (prof_p->idle_samples > 0)
+    {
+        fprintf( folded_file_p, "host %llu\n",
+            (unsigned long long) prof_p->idle_samples );
+    }
+
+    fclose( folded_file_p );
+    return SUCCESS;
+}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for the sampling profiler of long-running microputer programs
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/***************************** Imports ****************************************/
+
+#include <signal.h>
+#include <sys/time.h>
+#include "microputer.h"
+#include "machine.h"
+
+/**************************** Constants ***************************************/
+
+/* Microputers one profiler can sample: the main one, and every core of a
+   machine */
+#define MAX_PROFILE_TARGETS (MAX_CORES + 1)
+/* Host CPU time between samples, in microseconds */
+#define PROFILE_INTERVAL_USEC 1000
+/* Longest name a target is reported under */
+#define MAX_TARGET_NAME_LEN 16
+
+/********************** Profiler Structs & Types ******************************/
+
+/* Samples of the instruction each target was running, by engine; filled in
+   from a SIGPROF handler, so nothing is counted between samples */
+struct profiler_s {
+    /* Slots are never reused, so a removed target keeps its samples */
+    microputer_t * volatile targets_p[ MAX_PROFILE_TARGETS ];
+    char names[ MAX_PROFILE_TARGETS ][ MAX_TARGET_NAME_LEN ];
+    volatile int num_targets;
+    uint64_t samples[ MAX_PROFILE_TARGETS ][ NUM_ENGINES ][ MEM_WORD_COUNT ];
+    /* Samples taken while no target was running (loading, host I/O, ...) */
+    uint64_t idle_samples;
+    /* What SIGPROF and the profiling timer were set to before starting */
+    struct sigaction old_action;
+    struct itimerval old_timer;
+} typedef profiler_t;
+
+/*********************** Public Profiler Functions ****************************/
+
+int create_profiler(profiler_t ** out_prof_pp);
+int delete_profiler(profiler_t ** prof_pp);
+int add_profile_target(profiler_t * prof_p, microputer_t * mp_p,
+    const char * name_p);
+void remove_profile_target(profiler_t * prof_p, microputer_t * mp_p);
+int start_profiler(profiler_t * prof_p, long interval_usec);
+void stop_profiler(profiler_t * prof_p);
+void print_profile(const profiler_t * prof_p, microputer_t * mp_p);
+int write_folded_stacks(const profiler_t * prof_p, microputer_t * mp_p,
+    const char * folded_file_name_p, byte_t append);
+
+#endif
@@ -0,0 +1,357 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Scheduling of jobs that share one microputer. Each job runs a quantum of
+/// instructions at a time and is then preempted: its registers, pc and
+/// device cursors are captured into its snapshot and the next job's are
+/// restored, which is all a switch costs. The next job is the first of the
+/// highest priority class with anything runnable, from the tenant of that
+/// class whose jobs have run the fewest instructions so far, so short
+/// interactive jobs never wait behind long sweeps and no tenant can crowd
+/// out the others by queueing more jobs
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+/**************************** Globals *****************************************/
+
+/* Names of the priority classes, as job lines give them */
+static const char * class_names[ NUM_SCHED_CLASSES ] = {
+    "interactive", "normal", "batch"
+};
+
+/*******************************************************************************
+ *                          Private Functions
+ ******************************************************************************/
+
+/// @brief Finds a tenant by name, adding it if it is new
+/// @param sched_p the scheduler
+/// @param tenant_p the tenant's name
+/// @param out_index_p the tenant's index
+/// @return 1 if SUCCESS, otherwise ERROR
+static int find_tenant(scheduler_t * sched_p, const char * tenant_p,
+    byte_t * out_index_p)
+{
+    sched_tenant_t * tenant_entry_p;
+
+    for (byte_t i = 0; i < sched_p->num_tenants; i++)
+    {
+        if (strncmp( sched_p->tenants[ i ].name, tenant_p,
+            MAX_TENANT_NAME_LEN ) == 0)
+        {
+            *out_index_p = i;
+            return SUCCESS;
+        }
+    }
+    if (sched_p->num_tenants == SCHED_MAX_TENANTS)
+    {
+        printf( "\t# [ERROR: more than %d tenants] #\n", SCHED_MAX_TENANTS );
+        return ERROR;
+    }
+    tenant_entry_p = &sched_p->tenants[ sched_p->num_tenants ];
+    strncpy( tenant_entry_p->name, tenant_p, MAX_TENANT_NAME_LEN );
+    for (int c = 0; c < NUM_SCHED_CLASSES; c++)
+    {
+        tenant_entry_p->head[ c ] = NO_JOB;
+        tenant_entry_p->tail[ c ] = NO_JOB;
+    }
+    *out_index_p = sched_p->num_tenants++;
+    return SUCCESS;
+}
+
+/// @brief Puts a job at the end of its tenant's run queue of its class
+/// @param sched_p the scheduler
+/// @param index the job
+static void enqueue_job(scheduler_t * sched_p, uint64_t index)
+{
+    sched_job_t * job_p = &sched_p->jobs_p[ index ];
+    sched_tenant_t * tenant_p = &sched_p->tenants[ job_p->tenant ];
+
+    job_p->next = NO_JOB;
+    if (tenant_p->tail[ job_p->priority ] == NO_JOB)
+    {
+        tenant_p->head[ job_p->priority ] = index;
+    } else
+    {
+        sched_p->jobs_p[ tenant_p->tail[ job_p->priority ] ].next = index;
+    }
+    tenant_p->tail[ job_p->priority ] = index;
+}
+
+/// @brief Takes the next job to run off its run queue: the first of the
+/// highest class with one, from the tenant of that class that has used the
+/// least so far (ties go to the tenant seen first)
+/// @param sched_p the scheduler
+/// @return the job, or NO_JOB when every job is done
+static uint64_t dequeue_next_job(scheduler_t * sched_p)
+{
+    sched_tenant_t * best_p;
+    sched_tenant_t * tenant_p;
+    uint64_t index;
+
+    for (int c = 0; c < NUM_SCHED_CLASSES; c++)
+    {
+        best_p = NULL;
+        for (byte_t t = 0; t < sched_p->num_tenants; t++)
+        {
+            tenant_p = &sched_p->tenants[ t ];
+            if (tenant_p->head[ c ] != NO_JOB
+                && (best_p == NULL || tenant_p->usage < best_p->usage))
+            {
+                best_p = tenant_p;
+            }
+        }
+        if (best_p != NULL)
+        {
+            index = best_p->head[ c ];
+            best_p->head[ c ] = sched_p->jobs_p[ index ].next;
+            if (best_p->head[ c ] == NO_JOB)
+            {
+                best_p->tail[ c ] = NO_JOB;
+            }
+            return index;
+        }
+    }
+    return NO_JOB;
+}
+
+/*******************************************************************************
+ *                          Public Functions
+ ******************************************************************************/
+
+/// @brief Allocates a scheduler with no jobs
+/// @param out_sched_pp a pointer to a pointer of the scheduler
+/// @param quantum instructions a job runs before it can be preempted
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_scheduler(scheduler_t ** out_sched_pp, uint64_t quantum)
+{
+    *out_sched_pp = (scheduler_t *) calloc( 1, sizeof( scheduler_t ) );
+    if (*out_sched_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate the scheduler] #\n" );
+        return ERROR;
+    }
+    (*out_sched_pp)->quantum = quantum ? quantum : SCHED_QUANTUM;
+    return SUCCESS;
+}
+
+/// @brief Frees a scheduler, its jobs and their input
+/// @param sched_pp a pointer to a pointer of the scheduler
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_scheduler(scheduler_t ** sched_pp)
+{
+    if (*sched_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *sched_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    for (uint64_t i = 0; i < (*sched_pp)->num_jobs; i++)
+    {
+        unload_input_file( &(*sched_pp)->jobs_p[ i ].input );
+        free( (*sched_pp)->jobs_p[ i ].name_p );
+    }
+    free( (*sched_pp)->jobs_p );
+    free( *sched_pp );
+    *sched_pp = NULL;
+    return SUCCESS;
+}
+
+/// @brief Looks up a priority class by name
+/// @param name_p "interactive", "normal" or "batch"
+/// @return the class, or -1 if there is no such class
+int parse_sched_class(const char * name_p)
+{
+    for (int c = 0; c < NUM_SCHED_CLASSES; c++)
+    {
+        if (strcmp( name_p, class_names[ c ] ) == 0)
+        {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/// @brief Adds the program loaded on a microputer as a job; it is captured
+/// as it stands, so the microputer can load the next one
+/// @param sched_p the scheduler
+/// @param mp_p microputer pointer, with the program loaded
+/// @param name_p the job's name (copied)
+/// @param tenant_p the tenant it runs for, or NULL for DEFAULT_TENANT
+/// @param priority its class, SCHED_INTERACTIVE to SCHED_BATCH
+/// @param engine the engine it runs on
+/// @param input_file_p the file its console RDDs read, or NULL
+/// @param input_format INPUT_TEXT or INPUT_BINARY
+/// @param shared_input_p the values it reads without an input file, which
+/// must outlive the scheduler, or NULL to read 0
+/// @param phase_ends_p when it started loading, then when the load and
+/// decode phases ended
+/// @return 1 if SUCCESS, otherwise ERROR
+int add_sched_job(scheduler_t * sched_p, const microputer_t * mp_p,
+    const char * name_p, const char * tenant_p, byte_t priority,
+    byte_t engine, const char * input_file_p, int input_format,
+    const input_t * shared_input_p, const uint64_t * phase_ends_p)
+{
+    sched_job_t * jobs_p;
+    sched_job_t * job_p;
+    uint64_t capacity;
+
+    if (sched_p->num_jobs == sched_p->capacity)
+    {
+        capacity = sched_p->capacity ? sched_p->capacity * 2 : 64;
+        jobs_p = (sched_job_t *) realloc( sched_p->jobs_p,
+            capacity * sizeof( sched_job_t ) );
+        if (jobs_p == NULL)
+        {
+            printf( "\t# [ERROR: realloc failed to grow the job table] #\n" );
+            return ERROR;
+        }
+        sched_p->jobs_p = jobs_p;
+        sched_p->capacity = capacity;
+    }
+    job_p = &sched_p->jobs_p[ sched_p->num_jobs ];
+    memset( job_p, 0, sizeof( sched_job_t ) );
+    job_p->priority = priority;
+    job_p->engine = engine;
+    memcpy( job_p->phase_ends, phase_ends_p,
+        (PHASE_DECODE + 2) * sizeof( uint64_t ) );
+    job_p->name_p = strdup( name_p );
+    if (job_p->name_p == NULL
+        || find_tenant( sched_p, tenant_p != NULL ? tenant_p : DEFAULT_TENANT,
+            &job_p->tenant ) != SUCCESS
+        || capture_snapshot( mp_p, RUN_UNBOUNDED, &job_p->snapshot )
+            != SUCCESS
+        || (input_file_p != NULL
+            && load_input_file( &job_p->input, input_file_p, input_format )
+                != SUCCESS))
+    {
+        free( job_p->name_p );
+        return ERROR;
+    }
+    if (input_file_p == NULL && shared_input_p != NULL)
+    {
+        job_p->input.values_p = shared_input_p->values_p;
+        job_p->input.num_values = shared_input_p->num_values;
+        job_p->input.borrowed = 1;
+    }
+    enqueue_job( sched_p, sched_p->num_jobs++ );
+    return SUCCESS;
+}
+
+/// @brief Runs every job to the end on one microputer, a quantum at a time,
+/// in the order described at the top of this file. The console of the
+/// microputer's bus must be a stream console; it reads each job's input
+/// while the job runs. Output of jobs that are preempted interleaves
+/// @param sched_p the scheduler
+/// @param mp_p microputer pointer
+/// @param metrics_p metrics each finished job is recorded in, or NULL
+/// @return 1 if SUCCESS, otherwise ERROR (some job failed)
+int run_scheduler(scheduler_t * sched_p, microputer_t * mp_p,
+    metrics_t * metrics_p)
+{
+    device_t * console_p = mp_p->bus_p->port_map[ CONSOLE_PORT ];
+    sched_job_t * job_p;
+    uint64_t index;
+    uint64_t start_cycles;
+    int result = SUCCESS;
+
+    sched_p->start_ns = metrics_now_ns();
+    while ((index = dequeue_next_job( sched_p )) != NO_JOB)
+    {
+        job_p = &sched_p->jobs_p[ index ];
+        if (set_stream_console_values( console_p, job_p->input.values_p,
+            job_p->input.num_values ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        restore_snapshot( mp_p, &job_p->snapshot );
+        start_cycles = mp_p->cycles;
+        job_p->result = run_engine( mp_p, job_p->engine, sched_p->quantum );
+        sched_p->tenants[ job_p->tenant ].usage += mp_p->cycles - start_cycles;
+        job_p->slices++;
+
+        /* Captured even when done, for the report */
+        if (capture_snapshot( mp_p, RUN_UNBOUNDED, &job_p->snapshot )
+            != SUCCESS)
+        {
+            job_p->result = ERROR;
+        }
+        if (job_p->result == SUCCESS && !mp_p->halted)
+        {
+            enqueue_job( sched_p, index );
+            continue;
+        }
+        job_p->phase_ends[ PHASE_EXECUTE + 1 ] = metrics_now_ns();
+        job_p->phase_ends[ PHASE_OUTPUT + 1 ] =
+            job_p->phase_ends[ PHASE_EXECUTE + 1 ];
+        if (job_p->result != SUCCESS)
+        {
+            printf( "\t# [ERROR: job '%s' failed] #\n", job_p->name_p );
+            result = ERROR;
+        }
+        if (metrics_p != NULL)
+        {
+            record_job( metrics_p, job_p->phase_ends,
+                job_p->snapshot.cycles, job_p->result );
+        }
+    }
+    return result;
+}
+
+/// @brief Prints how long each class waited for its jobs and how the
+/// instructions run were shared between the tenants
+/// @param sched_p the scheduler, after run_scheduler
+void print_schedule_report(const scheduler_t * sched_p)
+{
+    const sched_job_t * job_p;
+    uint64_t jobs[ NUM_SCHED_CLASSES ] = { 0 };
+    uint64_t slices[ NUM_SCHED_CLASSES ] = { 0 };
+    uint64_t total_ns[ NUM_SCHED_CLASSES ] = { 0 };
+    uint64_t max_ns[ NUM_SCHED_CLASSES ] = { 0 };
+    uint64_t turnaround_ns;
+    uint64_t total_usage = 0;
+
+    for (uint64_t i = 0; i < sched_p->num_jobs; i++)
+    {
+        job_p = &sched_p->jobs_p[ i ];
+        turnaround_ns = job_p->phase_ends[ PHASE_EXECUTE + 1 ]
+            - sched_p->start_ns;
+        jobs[ job_p->priority ]++;
+        slices[ job_p->priority ] += job_p->slices;
+        total_ns[ job_p->priority ] += turnaround_ns;
+        if (turnaround_ns > max_ns[ job_p->priority ])
+        {
+            max_ns[ job_p->priority ] = turnaround_ns;
+        }
+    }
+    printf( "\nSchedule (quantum %llu):\n",
+        (unsigned long long) sched_p->quantum );
+    printf( "\t%-12s %8s %10s %14s %14s\n", "class", "jobs", "slices",
+        "mean done ms", "last done ms" );
+    for (int c = 0; c < NUM_SCHED_CLASSES; c++)
+    {
+        if (jobs[ c ] > 0)
+        {
+            printf( "\t%-12s %8llu %10llu %14.3f %14.3f\n", class_names[ c ],
+                (unsigned long long) jobs[ c ],
+                (unsigned long long) slices[ c ],
+                total_ns[ c ] / 1e6 / jobs[ c ], max_ns[ c ] / 1e6 );
+        }
+    }
+    for (byte_t t = 0; t < sched_p->num_tenants; t++)
+    {
+        total_usage += sched_p->tenants[ t ].usage;
+    }
+    printf( "\t%-12s %19s %14s\n", "tenant", "instructions", "share" );
+    for (byte_t t = 0; t < sched_p->num_tenants; t++)
+    {
+        printf( "\t%-12s %19llu %13.1f%%\n", sched_p->tenants[ t ].name,
+            (unsigned long long) sched_p->tenants[ t ].usage,
+            total_usage ? 100.0 * sched_p->tenants[ t ].usage / total_usage
+                : 0.0 );
+    }
+}
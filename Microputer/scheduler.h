@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for scheduling jobs by priority class and tenant
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+#include "devices.h"
+#include "input.h"
+#include "snapshot.h"
+#include "metrics.h"
+
+/**************************** Constants ***************************************/
+
+/* Priority classes; a runnable job of a lower class always runs first */
+#define SCHED_INTERACTIVE 0
+#define SCHED_NORMAL 1
+#define SCHED_BATCH 2
+#define NUM_SCHED_CLASSES 3
+/* Instructions a job runs before it can be preempted, unless -Q says */
+#define SCHED_QUANTUM 4096
+#define SCHED_MAX_TENANTS 64
+#define MAX_TENANT_NAME_LEN 31
+/* Tenant of jobs that do not name one */
+#define DEFAULT_TENANT "default"
+/* sched_job_t.next at the end of a run queue */
+#define NO_JOB UINT64_MAX
+
+/********************** Scheduler Structs & Types *****************************/
+
+/* A job and where it was preempted */
+struct sched_job_s {
+    snapshot_t snapshot;
+    /* The values its console RDDs read */
+    input_t input;
+    char * name_p;
+    byte_t priority;
+    byte_t tenant;
+    byte_t engine;
+    int result;
+    uint64_t slices;
+    /* When it started loading, then the end of each phase (see metrics.h);
+       it executes from when it is loaded until its last slice */
+    uint64_t phase_ends[ NUM_PHASES + 1 ];
+    /* Next job in its tenant's run queue of its class, or NO_JOB */
+    uint64_t next;
+} typedef sched_job_t;
+
+/* A tenant, and its jobs waiting to run, per class */
+struct sched_tenant_s {
+    char name[ MAX_TENANT_NAME_LEN + 1 ];
+    /* Instructions its jobs have run; the tenant with the least goes next */
+    uint64_t usage;
+    uint64_t head[ NUM_SCHED_CLASSES ];
+    uint64_t tail[ NUM_SCHED_CLASSES ];
+} typedef sched_tenant_t;
+
+/* Jobs waiting for, or done with, the one microputer they share */
+struct scheduler_s {
+    sched_job_t * jobs_p;
+    uint64_t num_jobs;
+    uint64_t capacity;
+    sched_tenant_t tenants[ SCHED_MAX_TENANTS ];
+    byte_t num_tenants;
+    uint64_t quantum;
+    /* When run_scheduler started; turnaround is measured from here */
+    uint64_t start_ns;
+} typedef scheduler_t;
+
+/*********************** Public Scheduler Functions ***************************/
+
+int create_scheduler(scheduler_t ** out_sched_pp, uint64_t quantum);
+int delete_scheduler(scheduler_t ** sched_pp);
+int parse_sched_class(const char * name_p);
+int add_sched_job(scheduler_t * sched_p, const microputer_t * mp_p,
+    const char * name_p, const char * tenant_p, byte_t priority,
+    byte_t engine, const char * input_file_p, int input_format,
+    const input_t * shared_input_p, const uint64_t * phase_ends_p);
+int run_scheduler(scheduler_t * sched_p, microputer_t * mp_p,
+    metrics_t * metrics_p);
+void print_schedule_report(const scheduler_t * sched_p);
+
+#endif
@@ -0,0 +1,300 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Picks the fastest engine for each program from its static features and,
+/// for programs that loop, a short calibration run of each engine; the
+/// choice is remembered by a hash of the program
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "selector.h"
+#include "devices.h"
+
+/***************************** Globals ****************************************/
+
+/* Engines the selector picks between */
+static const byte_t candidate_engines[] = {
+    ENGINE_REFERENCE, ENGINE_RUN_LOOP, ENGINE_PREDECODED
+};
+#define NUM_CANDIDATE_ENGINES \
+    (sizeof( candidate_engines ) / sizeof( *candidate_engines ))
+
+/*******************************************************************************
+ *              Selector Initialization & Termination Functions
+ ******************************************************************************/
+
+/// @brief Dynamically allocates a selector with nothing remembered
+/// @param out_sel_pp a pointer to a pointer of the selector
+/// @return 1 if SUCCESS, otherwise ERROR
+int create_selector(selector_t ** out_sel_pp)
+{
+    *out_sel_pp = (selector_t *) calloc( 1, sizeof( selector_t ) );
+    if (*out_sel_pp == NULL)
+    {
+        printf( "\t# [ERROR: calloc failed to allocate for *out_sel_pp] #\n" );
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/// @brief Frees the selector
+/// @param sel_pp a pointer to a pointer of the selector
+/// @return 1 if SUCCESS, otherwise ERROR
+int delete_selector(selector_t ** sel_pp)
+{
+    if (*sel_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *sel_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    free( *sel_pp );
+    *sel_pp = NULL;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Program Analysis Functions
+ ******************************************************************************/
+
+/// @brief Hashes the loaded program image (FNV-1a)
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @return the hash
+uint64_t hash_micro_program(const microputer_t * mp_p)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (byte_t i = 0; i < mp_p->loaded_mem_slots; i++)
+    {
+        hash = (hash ^ mp_p->mem_p[ i ]) * 0x100000001b3ull;
+    }
+    /* Programs that differ only by trailing zero bytes are still different */
+    return hash ^ mp_p->loaded_mem_slots;
+}
+
+/// @brief Reads the features the selector goes by off the program image
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @param out_features_p the features
+void extract_program_features(const microputer_t * mp_p,
+    program_features_t * out_features_p)
+{
+    uint16_t instr;
+
+    memset( out_features_p, 0, sizeof( *out_features_p ) );
+    out_features_p->num_words = (mp_p->loaded_mem_slots + 1) / WORD_SIZE;
+    for (byte_t i = 0; i < out_features_p->num_words; i++)
+    {
+        instr = (uint16_t) ((mp_p->mem_p[ i * WORD_SIZE ] << 8)
+            | mp_p->mem_p[ i * WORD_SIZE + 1 ]);
+        switch (instr >> 13)
+        {
+            case 0b101: case 0b110:
+                out_features_p->num_io++;
+                break;
+            case 0b111:
+                /* The CFG has a cycle iff some edge goes back (or stays) */
+                if ((instr & 0b11111) <= i * WORD_SIZE)
+                {
+                    out_features_p->has_loop = 1;
+                }
+                break;
+        }
+    }
+}
+
+/*******************************************************************************
+ *                          Selection Functions
+ ******************************************************************************/
+
+/// @brief Times an engine on a copy of the microputer whose devices are all
+/// null, so calibration neither prints, reads input nor touches files
+/// @param mp_p microputer pointer (not changed)
+/// @param scratch_p a microputer to run the copies on
+/// @param null_bus_p a bus with no devices attached
+/// @param engine the engine
+/// @return the fastest trial, in nanoseconds
+static uint64_t calibrate_engine(const microputer_t * mp_p,
+    microputer_t * scratch_p, io_bus_t * null_bus_p, byte_t engine)
+{
+    struct timespec before;
+    struct timespec after;
+    uint64_t elapsed;
+    uint64_t best = UINT64_MAX;
+
+    for (int trial = 0; trial < CALIBRATION_TRIALS; trial++)
+    {
+        memcpy( (void *) scratch_p, (const void *) mp_p, sizeof( *mp_p ) );
+        if (mp_p->mem_p == mp_p->mem)
+        {
+            scratch_p->mem_p = scratch_p->mem;
+        }
+        scratch_p->bus_p = null_bus_p;
+        scratch_p->io_log_p = NULL;
+        scratch_p->debugger_p = NULL;
+        scratch_p->coverage_p = NULL;
+
+        clock_gettime( CLOCK_MONOTONIC, &before );
+        run_engine( scratch_p, engine, CALIBRATION_BUDGET );
+        clock_gettime( CLOCK_MONOTONIC, &after );
+        elapsed = (uint64_t) (after.tv_sec - before.tv_sec) * 1000000000ull
+            + (uint64_t) after.tv_nsec - (uint64_t) before.tv_nsec;
+        if (elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/// @brief Picks the engine to run the loaded program on. A program without
+/// loops runs each instruction at most once, so the reference interpreter
+/// wins by not decoding anything; one that is mostly I/O spends its time in
+/// devices, so the run loop is as good as any. Anything else is calibrated
+/// @param sel_p the selector
+/// @param mp_p microputer pointer (the program must be loaded)
+/// @return the engine
+byte_t select_engine(selector_t * sel_p, microputer_t * mp_p)
+{
+    uint64_t hash = hash_micro_program( mp_p );
+    selector_entry_t * entry_p = &sel_p->entries[ hash % SELECTOR_CACHE_SIZE ];
+    program_features_t features;
+    microputer_t * scratch_p = NULL;
+    io_bus_t * null_bus_p = NULL;
+    uint64_t best_ns = UINT64_MAX;
+    uint64_t ns;
+    byte_t engine = ENGINE_REFERENCE;
+
+    /* Linear probing; a full cache overwrites the program's home slot */
+    for (int i = 0; i < SELECTOR_CACHE_SIZE; i++)
+    {
+        selector_entry_t * probe_p =
+            &sel_p->entries[ (hash + i) % SELECTOR_CACHE_SIZE ];
+        if (probe_p->valid && probe_p->hash == hash)
+        {
+            sel_p->hits++;
+            return probe_p->engine;
+        }
+        if (!probe_p->valid)
+        {
+            entry_p = probe_p;
+            break;
+        }
+    }
+    sel_p->misses++;
+
+    extract_program_features( mp_p, &features );
+    if (!features.has_loop)
+    {
+        engine = ENGINE_REFERENCE;
+    } else if (features.num_io * 2 >= features.num_words)
+    {
+        engine = ENGINE_RUN_LOOP;
+    } else if (create_null_io_bus( &null_bus_p ) == SUCCESS
+        && create_microputer( &scratch_p ) == SUCCESS)
+    {
+        for (size_t i = 0; i < NUM_CANDIDATE_ENGINES; i++)
+        {
+            ns = calibrate_engine( mp_p, scratch_p, null_bus_p,
+                candidate_engines[ i ] );
+            if (ns < best_ns)
+            {
+                best_ns = ns;
+                engine = candidate_engines[ i ];
+            }
+        }
+    }
+    if (scratch_p != NULL)
+    {
+        delete_microputer( &scratch_p );
+    }
+    if (null_bus_p != NULL)
+    {
+        delete_io_bus( &null_bus_p );
+    }
+
+    entry_p->hash = hash;
+    entry_p->engine = engine;
+    entry_p->valid = 1;
+    return engine;
+}
+
+/*******************************************************************************
+ *                          Cache File Functions
+ ******************************************************************************/
+
+/// @brief Remembers the choices saved by an earlier run; a missing file
+/// just means nothing is remembered yet
+/// @param sel_p the selector
+/// @param cache_file_name_p the file
+/// @return 1 if SUCCESS, otherwise ERROR (including when there is no file)
+int load_selector_cache(selector_t * sel_p, const char * cache_file_name_p)
+{
+    FILE * file_p = fopen( cache_file_name_p, "r" );
+    unsigned long long hash;
+    char name[ 32 ];
+    selector_entry_t * entry_p;
+
+    if (file_p == NULL)
+    {
+        return ERROR;
+    }
+    while (fscanf( file_p, "%llx %31s", &hash, name ) == 2)
+    {
+        for (size_t i = 0; i < NUM_CANDIDATE_ENGINES; i++)
+        {
+            if (strcmp( name, engine_name( candidate_engines[ i ] ) ) != 0)
+            {
+                continue;
+            }
+            for (int j = 0; j < SELECTOR_CACHE_SIZE; j++)
+            {
+                entry_p = &sel_p->entries[ (hash + j) % SELECTOR_CACHE_SIZE ];
+                if (!entry_p->valid || entry_p->hash == hash)
+                {
+                    entry_p->hash = hash;
+                    entry_p->engine = candidate_engines[ i ];
+                    entry_p->valid = 1;
+                    break;
+                }
+            }
+        }
+    }
+    fclose( file_p );
+    return SUCCESS;
+}
+
+/// @brief Saves the choices as "hash engine" lines
+/// @param sel_p the selector
+/// @param cache_file_name_p the file
+/// @return 1 if SUCCESS, otherwise ERROR
+int save_selector_cache(const selector_t * sel_p,
+    const char * cache_file_name_p)
+{
+    FILE * file_p = fopen( cache_file_name_p, "w" );
+    int result = SUCCESS;
+
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: Could not open '%s'] #\n", cache_file_name_p );
+        return ERROR;
+    }
+    for (int i = 0; i < SELECTOR_CACHE_SIZE; i++)
+    {
+        if (sel_p->entries[ i ].valid)
+        {
+            fprintf( file_p, "%016llx %s\n",
+                (unsigned long long) sel_p->entries[ i ].hash,
+                engine_name( sel_p->entries[ i ].engine ) );
+        }
+    }
+    if (ferror( file_p ))
+    {
+        result = ERROR;
+    }
+    fclose( file_p );
+    return result;
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for picking the fastest engine for each program
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SELECTOR_H
+#define SELECTOR_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Engine option asking for the selector to pick */
+#define ENGINE_AUTO 0xFF
+/* Programs whose choice is remembered */
+#define SELECTOR_CACHE_SIZE 64
+/* Instructions each engine runs per calibration trial, and trials each */
+#define CALIBRATION_BUDGET 4096
+#define CALIBRATION_TRIALS 5
+
+/********************** Selector Structs & Types ******************************/
+
+/* What can be told about a program without running it */
+struct program_features_s {
+    byte_t num_words;
+    /* 1 if some BLT branches backwards, so the program can run for long */
+    byte_t has_loop;
+    /* PRT and RDD instructions */
+    byte_t num_io;
+} typedef program_features_t;
+
+/* The engine picked for a program, by a hash of its image */
+struct selector_entry_s {
+    uint64_t hash;
+    byte_t engine;
+    byte_t valid;
+} typedef selector_entry_t;
+
+/* Picks engines and remembers what it picked */
+struct selector_s {
+    selector_entry_t entries[ SELECTOR_CACHE_SIZE ];
+    uint64_t hits;
+    uint64_t misses;
+} typedef selector_t;
+
+/*********************** Public Selector Functions ****************************/
+
+int create_selector(selector_t ** out_sel_pp);
+int delete_selector(selector_t ** sel_pp);
+uint64_t hash_micro_program(const microputer_t * mp_p);
+void extract_program_features(const microputer_t * mp_p,
+    program_features_t * out_features_p);
+byte_t select_engine(selector_t * sel_p, microputer_t * mp_p);
+int load_selector_cache(selector_t * sel_p, const char * cache_file_name_p);
+int save_selector_cache(const selector_t * sel_p,
+    const char * cache_file_name_p);
+
+#endif
@@ -0,0 +1,522 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Shared memory ring channels. A channel is a POSIX shared memory segment
+/// holding two single producer, single consumer rings: values other local
+/// processes send for RDD to read, and values PRT sends back. Each index
+/// has one writer, so a send or receive is a plain copy and one release
+/// store, with no locks and no system calls while the rings have room;
+/// an end that has to wait spins briefly, then yields, then sleeps
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmring.h"
+
+/***************************** Macros *****************************************/
+
+#define SHM_RING_MASK (SHM_RING_SIZE - 1)
+
+/*******************************************************************************
+ *                          Private Functions
+ ******************************************************************************/
+
+/// @brief Waits a little before a ring is polled again; the longer an end
+/// has been waiting, the less CPU it spends doing so
+/// @param polls_p how many polls the end has waited for so far
+static void wait_for_ring(uint64_t * polls_p)
+{
+    struct timespec delay = { 0, SHM_SLEEP_NSEC };
+    uint64_t polls = (*polls_p)++;
+
+    if (polls < SHM_SPIN_POLLS)
+    {
+        #if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+        #endif
+    } else if (polls < SHM_SPIN_POLLS + SHM_YIELD_POLLS)
+    {
+        sched_yield();
+    } else
+    {
+        nanosleep( &delay, NULL );
+    }
+}
+
+/// @brief Receives everything the microputer has sent so far into a file,
+/// one decimal value per line
+/// @param link_p the client's link
+/// @param out_file_p the file
+/// @return SUCCESS, SHM_RING_EMPTY, or SHM_RING_CLOSED once it is done
+static int drain_shm_output(shm_link_t * link_p, FILE * out_file_p)
+{
+    byte_t value;
+    int result;
+
+    while ((result = try_shm_receive( link_p, &value )) == SUCCESS)
+    {
+        fprintf( out_file_p, "%hu\n", (uint16_t) value );
+    }
+    fflush( out_file_p );
+    return result;
+}
+
+/// @brief Whether the process at an end of a channel has exited
+/// @param pid the process, or 0 for none yet
+/// @return 1 if it is gone, otherwise 0
+static int process_is_gone(pid_t pid)
+{
+    return pid != 0 && kill( pid, 0 ) != 0 && errno == ESRCH;
+}
+
+/// @brief Whether the other end's process has exited while this end waits
+/// on it; asked only once the wait has come to sleeping, so the spinning
+/// fast path makes no system calls
+/// @param link_p the link
+/// @param polls how many polls this end has waited for so far
+/// @return 1 if it is gone, otherwise 0
+static int peer_is_gone(shm_link_t * link_p, uint64_t polls)
+{
+    return polls >= SHM_SPIN_POLLS + SHM_YIELD_POLLS
+        && process_is_gone( atomic_load_explicit(
+            &link_p->channel_p->pids[ !link_p->end ], memory_order_relaxed ) );
+}
+
+/// @brief Creates a channel's segment, or opens the one that exists, and
+/// maps it; link_p->created says which
+/// @param link_p the link, with its name set
+/// @return 1 if SUCCESS, otherwise ERROR
+static int map_shm_channel(shm_link_t * link_p)
+{
+    struct stat st;
+    void * map_p;
+    uint64_t polls = 0;
+    int fd;
+
+    link_p->created = 0;
+    fd = shm_open( link_p->name_p, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if (fd >= 0)
+    {
+        link_p->created = 1;
+    } else if (errno == EEXIST)
+    {
+        fd = shm_open( link_p->name_p, O_RDWR, 0600 );
+    }
+    if (fd < 0 || fstat( fd, &st ) != 0)
+    {
+        printf( "\t# [ERROR: shared memory '%s' could NOT be opened!] #\n",
+            link_p->name_p );
+        goto FUNC_ERROR;
+    }
+    if (link_p->created)
+    {
+        if (ftruncate( fd, sizeof( shm_channel_t ) ) != 0)
+        {
+            printf( "\t# [ERROR: sizing shared memory '%s'] #\n",
+                link_p->name_p );
+            goto FUNC_ERROR;
+        }
+        st.st_size = sizeof( shm_channel_t );
+    }
+    /* The other end may have created it but not sized it yet */
+    while (st.st_size == 0 && polls <= SHM_SPIN_POLLS + 2 * SHM_YIELD_POLLS)
+    {
+        wait_for_ring( &polls );
+        if (fstat( fd, &st ) != 0)
+        {
+            break;
+        }
+    }
+    if ((size_t) st.st_size < sizeof( shm_channel_t ))
+    {
+        printf( "\t# [ERROR: '%s' is not a ring channel] #\n",
+            link_p->name_p );
+        goto FUNC_ERROR;
+    }
+    map_p = mmap( NULL, sizeof( shm_channel_t ), PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0 );
+    if (map_p == MAP_FAILED)
+    {
+        printf( "\t# [ERROR: mapping shared memory '%s'] #\n",
+            link_p->name_p );
+        goto FUNC_ERROR;
+    }
+    close( fd );
+    link_p->channel_p = (shm_channel_t *) map_p;
+    return SUCCESS;
+
+    FUNC_ERROR:
+    if (fd >= 0)
+    {
+        close( fd );
+    }
+    if (link_p->created)
+    {
+        shm_unlink( link_p->name_p );
+        link_p->created = 0;
+    }
+    return ERROR;
+}
+
+/// @brief Waits for the end that created a channel to lay it out, which it
+/// does right away
+/// @param channel_p the channel
+/// @return 1 if SUCCESS, otherwise ERROR (it never did)
+static int wait_for_magic(shm_channel_t * channel_p)
+{
+    uint64_t polls = 0;
+
+    while (atomic_load_explicit( &channel_p->magic, memory_order_acquire )
+        != SHM_CHANNEL_MAGIC)
+    {
+        if (polls > SHM_SPIN_POLLS + 2 * SHM_YIELD_POLLS)
+        {
+            return ERROR;
+        }
+        wait_for_ring( &polls );
+    }
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Public Functions
+ ******************************************************************************/
+
+/// @brief Opens one end of a channel, creating its segment if the other end
+/// has not yet. A segment left over from an earlier session (this end was
+/// taken by a process that is gone or is this one, or the other end's
+/// process is gone) is unlinked and created afresh, so no old index or
+/// closed flag carries over
+/// @param out_link_pp a pointer to a pointer of the link
+/// @param name_p the channel's name ('/' is put in front if missing)
+/// @param end SHM_END_MICROPUTER or SHM_END_CLIENT
+/// @return 1 if SUCCESS, otherwise ERROR
+int open_shm_link(shm_link_t ** out_link_pp, const char * name_p,
+    byte_t end)
+{
+    shm_link_t * link_p = (shm_link_t *) calloc( 1, sizeof( shm_link_t ) );
+    shm_channel_t * channel_p;
+    pid_t pid = 0;
+    int attempts = 0;
+
+    *out_link_pp = NULL;
+    if (link_p == NULL
+        || (link_p->name_p = (char *) malloc( strlen( name_p ) + 2 )) == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate the shm link] #\n" );
+        free( link_p );
+        return ERROR;
+    }
+    snprintf( link_p->name_p, strlen( name_p ) + 2, "%s%s",
+        name_p[ 0 ] == '/' ? "" : "/", name_p );
+
+    while (1)
+    {
+        if (map_shm_channel( link_p ) != SUCCESS)
+        {
+            goto FUNC_ERROR;
+        }
+        channel_p = link_p->channel_p;
+
+        /* A fresh segment is all zeros, which is two empty, open rings */
+        if (link_p->created)
+        {
+            channel_p->ring_size = SHM_RING_SIZE;
+            atomic_store_explicit( &channel_p->pids[ end ], getpid(),
+                memory_order_relaxed );
+            atomic_store_explicit( &channel_p->magic, SHM_CHANNEL_MAGIC,
+                memory_order_release );
+            break;
+        }
+        if (wait_for_magic( channel_p ) == SUCCESS)
+        {
+            if (channel_p->ring_size != SHM_RING_SIZE)
+            {
+                printf( "\t# [ERROR: '%s' has rings of %u bytes, not %d] #\n",
+                    link_p->name_p, channel_p->ring_size, SHM_RING_SIZE );
+                goto FUNC_ERROR;
+            }
+            pid = 0;
+            if (atomic_compare_exchange_strong( &channel_p->pids[ end ], &pid,
+                getpid() ) && !process_is_gone( atomic_load( 
+                    &channel_p->pids[ !end ] ) ))
+            {
+                break;
+            }
+            /* This process held it before only if it already closed it */
+            if (pid != 0 && pid != getpid() && !process_is_gone( pid ))
+            {
+                printf( "\t# [ERROR: process %d already has this end of '%s'] "
+                    "#\n", (int) pid, link_p->name_p );
+                goto FUNC_ERROR;
+            }
+        }
+        /* Stale, or its creator died before laying it out */
+        munmap( channel_p, sizeof( shm_channel_t ) );
+        link_p->channel_p = NULL;
+        if (++attempts > SHM_STALE_RETRIES)
+        {
+            printf( "\t# [ERROR: '%s' is not a ring channel] #\n",
+                link_p->name_p );
+            goto FUNC_ERROR;
+        }
+        shm_unlink( link_p->name_p );
+    }
+
+    link_p->end = end;
+    link_p->send_p = end == SHM_END_MICROPUTER
+        ? &channel_p->output : &channel_p->input;
+    link_p->receive_p = end == SHM_END_MICROPUTER
+        ? &channel_p->input : &channel_p->output;
+    link_p->send_head = atomic_load_explicit( &link_p->send_p->head,
+        memory_order_relaxed );
+    link_p->send_tail_cache = atomic_load_explicit( &link_p->send_p->tail,
+        memory_order_acquire );
+    link_p->receive_tail = atomic_load_explicit( &link_p->receive_p->tail,
+        memory_order_relaxed );
+    link_p->receive_head_cache = link_p->receive_tail;
+    *out_link_pp = link_p;
+    return SUCCESS;
+
+    FUNC_ERROR:
+    if (link_p->channel_p != NULL)
+    {
+        munmap( link_p->channel_p, sizeof( shm_channel_t ) );
+    }
+    if (link_p->created)
+    {
+        shm_unlink( link_p->name_p );
+    }
+    free( link_p->name_p );
+    free( link_p );
+    return ERROR;
+}
+
+/// @brief Closes one end of a channel; what it sent stays readable, and the
+/// segment goes away once both ends have let go of it (if this end made it)
+/// @param link_pp a pointer to a pointer of the link
+/// @return 1 if SUCCESS, otherwise ERROR
+int close_shm_link(shm_link_t ** link_pp)
+{
+    if (*link_pp == NULL)
+    {
+        printf( "\t# [ERROR: Can NOT free( *link_pp ) it is NULL!] #\n" );
+        return ERROR;
+    }
+    close_shm_send( *link_pp );
+    munmap( (*link_pp)->channel_p, sizeof( shm_channel_t ) );
+    if ((*link_pp)->created)
+    {
+        shm_unlink( (*link_pp)->name_p );
+    }
+    free( (*link_pp)->name_p );
+    free( *link_pp );
+    *link_pp = NULL;
+    return SUCCESS;
+}
+
+/// @brief Sends a value if the ring has room
+/// @param link_p the link
+/// @param value the value
+/// @return SUCCESS, or SHM_RING_FULL
+int try_shm_send(shm_link_t * link_p, byte_t value)
+{
+    if (link_p->send_head - link_p->send_tail_cache == SHM_RING_SIZE)
+    {
+        link_p->send_tail_cache = atomic_load_explicit(
+            &link_p->send_p->tail, memory_order_acquire );
+        if (link_p->send_head - link_p->send_tail_cache == SHM_RING_SIZE)
+        {
+            return SHM_RING_FULL;
+        }
+    }
+    link_p->send_p->data[ link_p->send_head & SHM_RING_MASK ] = value;
+    atomic_store_explicit( &link_p->send_p->head, ++link_p->send_head,
+        memory_order_release );
+    return SUCCESS;
+}
+
+/// @brief Receives a value if one has been sent
+/// @param link_p the link
+/// @param out_value_p the value
+/// @return SUCCESS, SHM_RING_EMPTY, or SHM_RING_CLOSED when the other end
+/// is done and everything it sent has been received
+int try_shm_receive(shm_link_t * link_p, byte_t * out_value_p)
+{
+    shm_ring_t * ring_p = link_p->receive_p;
+
+    if (link_p->receive_tail == link_p->receive_head_cache)
+    {
+        link_p->receive_head_cache = atomic_load_explicit( &ring_p->head,
+            memory_order_acquire );
+        if (link_p->receive_tail == link_p->receive_head_cache)
+        {
+            /* The sender closes after its last send, so the head is read
+               again once it has */
+            if (!atomic_load_explicit( &ring_p->closed, memory_order_acquire ))
+            {
+                return SHM_RING_EMPTY;
+            }
+            link_p->receive_head_cache = atomic_load_explicit( &ring_p->head,
+                memory_order_acquire );
+            if (link_p->receive_tail == link_p->receive_head_cache)
+            {
+                return SHM_RING_CLOSED;
+            }
+        }
+    }
+    *out_value_p = ring_p->data[ link_p->receive_tail & SHM_RING_MASK ];
+    atomic_store_explicit( &ring_p->tail, ++link_p->receive_tail,
+        memory_order_release );
+    return SUCCESS;
+}
+
+/// @brief Sends a value, waiting for room if the ring is full
+/// @param link_p the link
+/// @param value the value
+/// @return SUCCESS, or SHM_RING_CLOSED if the other end's process died
+/// without draining the ring (the value is dropped)
+int shm_send(shm_link_t * link_p, byte_t value)
+{
+    uint64_t polls = 0;
+
+    while (try_shm_send( link_p, value ) == SHM_RING_FULL)
+    {
+        if (peer_is_gone( link_p, polls ))
+        {
+            return SHM_RING_CLOSED;
+        }
+        wait_for_ring( &polls );
+    }
+    return SUCCESS;
+}
+
+/// @brief Receives a value, waiting for one to be sent
+/// @param link_p the link
+/// @param out_value_p the value, or 0 once the channel is closed
+/// @return SUCCESS, or SHM_RING_CLOSED (also once the other end's process
+/// died without closing, after what it sent has been received)
+int shm_receive(shm_link_t * link_p, byte_t * out_value_p)
+{
+    uint64_t polls = 0;
+    int result;
+
+    while ((result = try_shm_receive( link_p, out_value_p ))
+        == SHM_RING_EMPTY)
+    {
+        if (peer_is_gone( link_p, polls ))
+        {
+            /* It may have sent more just before it went */
+            result = try_shm_receive( link_p, out_value_p );
+            if (result == SHM_RING_EMPTY)
+            {
+                result = SHM_RING_CLOSED;
+            }
+            break;
+        }
+        wait_for_ring( &polls );
+    }
+    if (result == SHM_RING_CLOSED)
+    {
+        *out_value_p = 0;
+    }
+    return result;
+}
+
+/// @brief Tells the other end this end will send no more
+/// @param link_p the link
+void close_shm_send(shm_link_t * link_p)
+{
+    atomic_store_explicit( &link_p->send_p->closed, 1, memory_order_release );
+}
+
+/// @brief Client end of a channel: sends the decimal numbers of a file (any
+/// other characters separate them) for the microputer's RDDs, and writes
+/// what its PRTs send back to another file, one per line, until the
+/// microputer closes the channel or its process is gone. Output is drained
+/// while input is sent, so neither ring can fill up for good, and input the
+/// program did not read before it ended is dropped. A value past 255 stops
+/// it with an error, since RDD reads a byte
+/// @param name_p the channel's name
+/// @param in_file_p the file of values to send
+/// @param out_file_p the file to write the values received to
+/// @return 1 if SUCCESS, otherwise ERROR
+int pump_shm_channel(const char * name_p, FILE * in_file_p,
+    FILE * out_file_p)
+{
+    shm_link_t * link_p = NULL;
+    unsigned int value = 0;
+    byte_t in_number = 0;
+    uint64_t polls;
+    int drained = SUCCESS;
+    int c;
+
+    if (open_shm_link( &link_p, name_p, SHM_END_CLIENT ) != SUCCESS)
+    {
+        return ERROR;
+    }
+    do
+    {
+        c = getc( in_file_p );
+        if (c >= '0' && c <= '9')
+        {
+            /* Past a byte, it only has to stay past one */
+            value = value > UINT8_MAX ? value : value * 10 + (c - '0');
+            in_number = 1;
+            continue;
+        }
+        if (in_number && value > UINT8_MAX)
+        {
+            printf( "\t# [ERROR: RDD reads bytes, so values past 255 can NOT "
+                "be sent] #\n" );
+            close_shm_link( &link_p );
+            return ERROR;
+        }
+        if (in_number)
+        {
+            polls = 0;
+            while (drained != SHM_RING_CLOSED
+                && try_shm_send( link_p, (byte_t) value ) == SHM_RING_FULL)
+            {
+                drained = drain_shm_output( link_p, out_file_p );
+                if (drained != SHM_RING_CLOSED && peer_is_gone( link_p, polls ))
+                {
+                    drained = SHM_RING_CLOSED;
+                }
+                wait_for_ring( &polls );
+            }
+            value = 0;
+            in_number = 0;
+        }
+        /* What came back so far is written at each line */
+        if (c == '\n')
+        {
+            drained = drain_shm_output( link_p, out_file_p );
+        }
+    } while (c != EOF && drained != SHM_RING_CLOSED);
+    close_shm_send( link_p );
+
+    polls = 0;
+    while (drained != SHM_RING_CLOSED)
+    {
+        drained = drain_shm_output( link_p, out_file_p );
+        if (drained != SHM_RING_CLOSED && peer_is_gone( link_p, polls ))
+        {
+            /* It may have sent more just before it went */
+            drain_shm_output( link_p, out_file_p );
+            drained = SHM_RING_CLOSED;
+        }
+        wait_for_ring( &polls );
+    }
+    return close_shm_link( &link_p );
+}
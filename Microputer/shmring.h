@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for shared memory ring channels to other local processes
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Bytes each ring holds; a power of 2, so indexes wrap with a mask */
+#define SHM_RING_SIZE 4096
+#define SHM_CACHE_LINE 64
+/* Set once a channel's segment is laid out, so either end can create it */
+#define SHM_CHANNEL_MAGIC 0x4D50524Eu
+/* Times a stale segment (left by ends that are gone) is replaced before
+   opening gives up */
+#define SHM_STALE_RETRIES 2
+/* Which end of a channel a link is; the microputer reads the input ring
+   and writes the output ring, a client the other way round */
+#define SHM_END_MICROPUTER 0
+#define SHM_END_CLIENT 1
+/* Results of the non-blocking calls besides SUCCESS */
+#define SHM_RING_EMPTY 2    // nothing to receive yet
+#define SHM_RING_FULL 2     // no room to send yet
+#define SHM_RING_CLOSED 3   // drained, and the sender is done
+/* Polls of a ring spent spinning, then yielding, before a waiting end
+   sleeps SHM_SLEEP_NSEC between polls */
+#define SHM_SPIN_POLLS 256
+#define SHM_YIELD_POLLS 1024
+#define SHM_SLEEP_NSEC 50000
+
+/*********************** Shm Ring Structs & Types *****************************/
+
+/* A single producer, single consumer ring of bytes. Each index is written
+   by one end only and sits on its own cache line, so polling the other
+   end's index never takes the line the owner writes */
+struct shm_ring_s {
+    /* Bytes sent so far; written by the producer only */
+    _Alignas( SHM_CACHE_LINE ) _Atomic uint64_t head;
+    /* 1 once the producer will send no more */
+    _Atomic uint32_t closed;
+    /* Bytes received so far; written by the consumer only */
+    _Alignas( SHM_CACHE_LINE ) _Atomic uint64_t tail;
+    _Alignas( SHM_CACHE_LINE ) byte_t data[ SHM_RING_SIZE ];
+} typedef shm_ring_t;
+
+/* The shared memory segment of a channel */
+struct shm_channel_s {
+    _Atomic uint32_t magic;
+    uint32_t ring_size;
+    /* The process at each end (by SHM_END_*), or 0 before it opens. An end
+       that is taken, or whose process is gone, marks the segment as left
+       over from an earlier session */
+    _Atomic pid_t pids[ 2 ];
+    /* Client to microputer (RDD), then microputer to client (PRT) */
+    shm_ring_t input;
+    shm_ring_t output;
+} typedef shm_channel_t;
+
+/* One end's view of a channel. The other end's index is cached and only
+   read again when the cached one says the ring is empty or full */
+struct shm_link_s {
+    shm_channel_t * channel_p;
+    char * name_p;
+    /* 1 = this end created the segment, and unlinks it when done */
+    byte_t created;
+    /* SHM_END_MICROPUTER or SHM_END_CLIENT */
+    byte_t end;
+    shm_ring_t * send_p;
+    shm_ring_t * receive_p;
+    uint64_t send_head;
+    uint64_t send_tail_cache;
+    uint64_t receive_tail;
+    uint64_t receive_head_cache;
+} typedef shm_link_t;
+
+/************************ Public Shm Ring Functions ***************************/
+
+int open_shm_link(shm_link_t ** out_link_pp, const char * name_p,
+    byte_t end);
+int close_shm_link(shm_link_t ** link_pp);
+int try_shm_send(shm_link_t * link_p, byte_t value);
+int try_shm_receive(shm_link_t * link_p, byte_t * out_value_p);
+int shm_send(shm_link_t * link_p, byte_t value);
+int shm_receive(shm_link_t * link_p, byte_t * out_value_p);
+void close_shm_send(shm_link_t * link_p);
+int pump_shm_channel(const char * name_p, FILE * in_file_p,
+    FILE * out_file_p);
+
+#endif
@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Snapshots of running jobs. A job stopped at a budget boundary is only a
+/// few dozen bytes of state (registers, memory, pc, timer, device cursors),
+/// so it can be captured on one worker and restored on another, in this
+/// process or another one, and run on as if it had never stopped
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "snapshot.h"
+
+/*******************************************************************************
+ *                          Private Functions
+ ******************************************************************************/
+
+/// @brief Checksum of a snapshot: FNV-1a of every byte before the checksum
+/// @param snapshot_p the snapshot
+/// @return the checksum
+static uint64_t snapshot_checksum(const snapshot_t * snapshot_p)
+{
+    const byte_t * byte_p = (const byte_t *) snapshot_p;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < offsetof( snapshot_t, checksum ); i++)
+    {
+        hash = (hash ^ byte_p[ i ]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/*******************************************************************************
+ *                          Public Functions
+ ******************************************************************************/
+
+/// @brief Captures a job stopped between instructions. A microputer running
+/// on a machine's shared image, or holding back output, is not a job of its
+/// own and is refused
+/// @param mp_p microputer pointer
+/// @param budget_left instructions the job may still run, or RUN_UNBOUNDED
+/// @param out_snapshot_p the snapshot
+/// @return 1 if SUCCESS, otherwise ERROR
+int capture_snapshot(const microputer_t * mp_p, uint64_t budget_left,
+    snapshot_t * out_snapshot_p)
+{
+    if (mp_p->mem_p != mp_p->mem
+        || (mp_p->io_log_p != NULL && mp_p->io_log_p->count > 0))
+    {
+        printf( "\t# [ERROR: only a job running on its own can be "
+            "suspended] #\n" );
+        return ERROR;
+    }
+
+    /* Zeroed first, so the padding the checksum covers is always the same */
+    memset( out_snapshot_p, 0, sizeof( snapshot_t ) );
+    memcpy( out_snapshot_p->magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN );
+    memcpy( out_snapshot_p->reg, mp_p->reg, NUM_REGISTERS );
+    memcpy( out_snapshot_p->mem, mp_p->mem, MEM_BYTE_SIZE );
+    out_snapshot_p->loaded_mem_slots = mp_p->loaded_mem_slots;
+    out_snapshot_p->halted = mp_p->halted;
+    out_snapshot_p->pc = mp_p->pc;
+    out_snapshot_p->ir = mp_p->ir;
+    out_snapshot_p->cycles = mp_p->cycles;
+    out_snapshot_p->io_count = mp_p->io_count;
+
+    out_snapshot_p->next_event = mp_p->next_event;
+    out_snapshot_p->timer_period = mp_p->timer_period;
+    out_snapshot_p->irq_vector = mp_p->irq_vector;
+    out_snapshot_p->saved_pc = mp_p->saved_pc;
+    out_snapshot_p->in_interrupt = mp_p->in_interrupt;
+
+    out_snapshot_p->idle_pc = mp_p->idle_pc;
+    out_snapshot_p->idle_io_count = mp_p->idle_io_count;
+    memcpy( out_snapshot_p->idle_reg, mp_p->idle_reg, NUM_REGISTERS );
+    out_snapshot_p->skipped_cycles = mp_p->skipped_cycles;
+
+    save_device_cursors( mp_p->bus_p, &out_snapshot_p->cursors );
+    out_snapshot_p->budget_left = budget_left;
+    out_snapshot_p->checksum = snapshot_checksum( out_snapshot_p );
+    return SUCCESS;
+}
+
+/// @brief Restores a job onto a microputer, which keeps its instruction
+/// set, bus, debugger and coverage; the bus's devices are moved to the
+/// job's cursors
+/// @param mp_p microputer pointer
+/// @param snapshot_p the snapshot
+void restore_snapshot(microputer_t * mp_p, const snapshot_t * snapshot_p)
+{
+    memcpy( mp_p->reg, snapshot_p->reg, NUM_REGISTERS );
+    memcpy( mp_p->mem, snapshot_p->mem, MEM_BYTE_SIZE );
+    mp_p->mem_p = mp_p->mem;
+    mp_p->loaded_mem_slots = snapshot_p->loaded_mem_slots;
+    mp_p->halted = snapshot_p->halted;
+    mp_p->pc = snapshot_p->pc;
+    mp_p->ir = snapshot_p->ir;
+    mp_p->cycles = snapshot_p->cycles;
+    mp_p->io_count = snapshot_p->io_count;
+
+    mp_p->next_event = snapshot_p->next_event;
+    mp_p->timer_period = snapshot_p->timer_period;
+    mp_p->irq_vector = snapshot_p->irq_vector;
+    mp_p->saved_pc = snapshot_p->saved_pc;
+    mp_p->in_interrupt = snapshot_p->in_interrupt;
+
+    mp_p->idle_pc = snapshot_p->idle_pc;
+    mp_p->idle_io_count = snapshot_p->idle_io_count;
+    memcpy( mp_p->idle_reg, snapshot_p->idle_reg, NUM_REGISTERS );
+    mp_p->skipped_cycles = snapshot_p->skipped_cycles;
+
+    restore_device_cursors( mp_p->bus_p, &snapshot_p->cursors );
+}
+
+/// @brief Writes a snapshot to a file, for another process to pick up. It
+/// is written next to the file and renamed over it, so a reader never sees
+/// half of one
+/// @param snapshot_p the snapshot
+/// @param file_name_p the file
+/// @return 1 if SUCCESS, otherwise ERROR
+int save_snapshot(const snapshot_t * snapshot_p, const char * file_name_p)
+{
+    size_t len = strlen( file_name_p );
+    char * tmp_name_p = (char *) malloc( len + 5 );
+    FILE * file_p = NULL;
+    int result = ERROR;
+
+    if (tmp_name_p == NULL)
+    {
+        printf( "\t# [ERROR: malloc failed to allocate for tmp_name_p] #\n" );
+        return ERROR;
+    }
+    memcpy( tmp_name_p, file_name_p, len );
+    memcpy( tmp_name_p + len, ".tmp", 5 );
+
+    file_p = fopen( tmp_name_p, "wb" );
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            tmp_name_p );
+        goto FUNC_EXIT;
+    }
+    if (fwrite( snapshot_p, sizeof( snapshot_t ), 1, file_p ) != 1)
+    {
+        printf( "\t# [ERROR: writing snapshot '%s'] #\n", tmp_name_p );
+        fclose( file_p );
+        remove( tmp_name_p );
+        goto FUNC_EXIT;
+    }
+    if (fclose( file_p ) != 0 || rename( tmp_name_p, file_name_p ) != 0)
+    {
+        printf( "\t# [ERROR: writing snapshot '%s'] #\n", file_name_p );
+        remove( tmp_name_p );
+        goto FUNC_EXIT;
+    }
+    result = SUCCESS;
+
+    FUNC_EXIT:
+    free( tmp_name_p );
+    return result;
+}
+
+/// @brief Reads a snapshot written by save_snapshot; one from another
+/// version, or damaged, is refused
+/// @param out_snapshot_p the snapshot
+/// @param file_name_p the file
+/// @return 1 if SUCCESS, otherwise ERROR
+int load_snapshot(snapshot_t * out_snapshot_p, const char * file_name_p)
+{
+    FILE * file_p = fopen( file_name_p, "rb" );
+    int result = SUCCESS;
+
+    if (file_p == NULL)
+    {
+        printf( "\t# [ERROR: file '%s' could NOT be opened!] #\n",
+            file_name_p );
+        return ERROR;
+    }
+    if (fread( out_snapshot_p, sizeof( snapshot_t ), 1, file_p ) != 1
+        || memcmp( out_snapshot_p->magic, SNAPSHOT_MAGIC,
+            SNAPSHOT_MAGIC_LEN ) != 0
+        || out_snapshot_p->checksum != snapshot_checksum( out_snapshot_p )
+        || out_snapshot_p->loaded_mem_slots > MEM_BYTE_SIZE)
+    {
+        printf( "\t# [ERROR: '%s' is not a valid snapshot] #\n",
+            file_name_p );
+        result = ERROR;
+    }
+    fclose( file_p );
+    return result;
+}
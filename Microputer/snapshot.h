@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for snapshots of running jobs, to move them between threads
+/// or processes without starting them over
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+#include "devices.h"
+
+/**************************** Constants ***************************************/
+
+/* First bytes of a snapshot file; the last one is the format version */
+#define SNAPSHOT_MAGIC "MPSNAP\0\1"
+#define SNAPSHOT_MAGIC_LEN 8
+
+/********************** Snapshot Structs & Types ******************************/
+
+/* Everything a suspended job needs to carry on: the small state of the
+   microputer, where its devices are in their streams, and how much of its
+   budget is left. Output it printed is not part of it; that is already out */
+struct snapshot_s {
+    char magic[ SNAPSHOT_MAGIC_LEN ];
+    byte_t reg[ NUM_REGISTERS ];
+    byte_t mem[ MEM_BYTE_SIZE ];
+    byte_t loaded_mem_slots;
+    byte_t halted;
+    uint16_t pc;
+    uint16_t ir;
+    uint64_t cycles;
+    uint64_t io_count;
+
+    /* Timer interrupt state */
+    uint64_t next_event;
+    uint64_t timer_period;
+    uint16_t irq_vector;
+    uint16_t saved_pc;
+    byte_t in_interrupt;
+
+    /* Idle loop detection state */
+    uint16_t idle_pc;
+    uint64_t idle_io_count;
+    byte_t idle_reg[ NUM_REGISTERS ];
+    uint64_t skipped_cycles;
+
+    device_cursors_t cursors;
+    /* Instructions the job may still run, or RUN_UNBOUNDED */
+    uint64_t budget_left;
+    /* FNV-1a of every byte before it, so damaged files are refused */
+    uint64_t checksum;
+} typedef snapshot_t;
+
+/*********************** Public Snapshot Functions ****************************/
+
+int capture_snapshot(const microputer_t * mp_p, uint64_t budget_left,
+    snapshot_t * out_snapshot_p);
+void restore_snapshot(microputer_t * mp_p, const snapshot_t * snapshot_p);
+int save_snapshot(const snapshot_t * snapshot_p, const char * file_name_p);
+int load_snapshot(snapshot_t * out_snapshot_p, const char * file_name_p);
+
+#endif
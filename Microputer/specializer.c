@@ -0,0 +1,706 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Partial evaluation: specializes a program to fixed values of its first
+/// console reads. Instructions whose results follow from those values are
+/// evaluated ahead of time (RDDs become constants, constants are folded and
+/// branches they decide are resolved); what remains is emitted as a smaller
+/// residual program that prints the same, reads the rest of the input the
+/// same and ends with the same registers
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+/***************************** Imports ****************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "specializer.h"
+#include "devices.h"
+#include "input.h"
+
+/***************************** Macros *****************************************/
+
+#define OP_LDI 0b000
+#define OP_PRT 0b101
+#define OP_RDD 0b110
+#define OP_BLT 0b111
+
+#define RI(instr) (((instr) >> 9) & 0xF)
+#define RJ(instr) (((instr) >> 5) & 0xF)
+#define RK(instr) (((instr) >> 1) & 0xF)
+#define PORT(instr) (((instr) >> 1) & 0xFF)
+#define BLT_ADDR(instr) ((instr) & 0b11111)
+#define ALL_REGISTERS ((uint16_t) ((1u << NUM_REGISTERS) - 1))
+
+/* How a BLT of the residual part goes, given what stays constant there */
+#define BRANCH_DYNAMIC 0
+#define BRANCH_ALWAYS 1
+#define BRANCH_NEVER 2
+
+/************************** Private Types *************************************/
+
+/* An attempt at specializing: what is known of the registers when the
+   original gets this far, and the residual program emitted so far */
+struct spec_state_s {
+    uint16_t code[ MEM_WORD_COUNT ];
+    byte_t end;
+    /* 1 = the register's value follows from the fixed values alone */
+    byte_t known[ NUM_REGISTERS ];
+    byte_t value[ NUM_REGISTERS ];
+    /* 1 = the residual's own register holds phys_value; a known register
+       is only loaded (with LDI) when something reads it at run time */
+    byte_t phys_known[ NUM_REGISTERS ];
+    byte_t phys_value[ NUM_REGISTERS ];
+    uint16_t out[ MEM_WORD_COUNT ];
+    byte_t num_out;
+    uint64_t values_used;
+    uint64_t steps;
+} typedef spec_state_t;
+
+/*******************************************************************************
+ *                          Residual Code Functions
+ ******************************************************************************/
+
+/// @brief Appends an instruction to the residual program
+/// @param s_p the attempt
+/// @param instr the instruction
+/// @return 1 if SUCCESS, otherwise ERROR (no room left)
+static int emit(spec_state_t * s_p, uint16_t instr)
+{
+    if (s_p->num_out == MEM_WORD_COUNT)
+    {
+        return ERROR;
+    }
+    s_p->out[ s_p->num_out++ ] = instr;
+    return SUCCESS;
+}
+
+/// @brief Makes the residual's register hold a known value, if it does not
+/// @param s_p the attempt
+/// @param reg the register
+/// @return 1 if SUCCESS, otherwise ERROR (no room left)
+static int materialize(spec_state_t * s_p, byte_t reg)
+{
+    if (!s_p->known[ reg ] || (s_p->phys_known[ reg ] 
+        && s_p->phys_value[ reg ] == s_p->value[ reg ]))
+    {
+        return SUCCESS;
+    }
+    s_p->phys_known[ reg ] = 1;
+    s_p->phys_value[ reg ] = s_p->value[ reg ];
+    return emit( s_p, (uint16_t) ((OP_LDI << 13) | (reg << 9)
+        | (s_p->value[ reg ] << 1)) );
+}
+
+/// @brief Makes known registers hold their values, as they must wherever
+/// the residual leaves off to the original's code (or halts)
+/// @param s_p the attempt
+/// @param regs the registers, bit per register
+/// @return 1 if SUCCESS, otherwise ERROR (no room left)
+static int materialize_all(spec_state_t * s_p, uint16_t regs)
+{
+    for (byte_t reg = 0; reg < NUM_REGISTERS; reg++)
+    {
+        if (((regs >> reg) & 1) && materialize( s_p, reg ) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+    return SUCCESS;
+}
+
+/// @brief Marks a register as written at run time by the residual
+/// @param s_p the attempt
+/// @param reg the register
+static void set_dynamic(spec_state_t * s_p, byte_t reg)
+{
+    s_p->known[ reg ] = 0;
+    s_p->phys_known[ reg ] = 0;
+}
+
+/*******************************************************************************
+ *                          Evaluation Functions
+ ******************************************************************************/
+
+/// @brief Evaluates one instruction of the original ahead of time, emitting
+/// what can not be; stops at a branch the fixed values do not decide
+/// @param s_p the attempt
+/// @param pc_p the instruction's address; updated to the next one
+/// @param values_p the fixed values
+/// @param num_values how many there are
+/// @return 1 if SUCCESS, otherwise ERROR (the branch is left to run time,
+/// or the program fails here)
+static int evaluate_step(spec_state_t * s_p, byte_t * pc_p,
+    const byte_t * values_p, uint64_t num_values)
+{
+    uint16_t instr = s_p->code[ *pc_p / WORD_SIZE ];
+    byte_t op_code = (byte_t) (instr >> 13);
+    byte_t ri = RI( instr );
+    byte_t rj = RJ( instr );
+    byte_t rk = RK( instr );
+
+    switch (op_code)
+    {
+        case OP_LDI:
+            s_p->known[ ri ] = 1;
+            s_p->value[ ri ] = (byte_t) PORT( instr );
+            break;
+        case OP_PRT:
+            if (materialize( s_p, ri ) != SUCCESS || emit( s_p, instr ) 
+                != SUCCESS)
+            {
+                return ERROR;
+            }
+            break;
+        case OP_RDD:
+            if (PORT( instr ) == CONSOLE_PORT 
+                && s_p->values_used < num_values)
+            {
+                s_p->known[ ri ] = 1;
+                s_p->value[ ri ] = values_p[ s_p->values_used++ ];
+                break;
+            }
+            if (emit( s_p, instr ) != SUCCESS)
+            {
+                return ERROR;
+            }
+            set_dynamic( s_p, ri );
+            break;
+        case OP_BLT:
+            if (!s_p->known[ ri ] || !s_p->known[ rj ])
+            {
+                return ERROR;
+            }
+            if (s_p->value[ ri ] < s_p->value[ rj ])
+            {
+                /* An odd address stops the original with an error */
+                if (BLT_ADDR( instr ) % WORD_SIZE != 0)
+                {
+                    return ERROR;
+                }
+                *pc_p = (byte_t) BLT_ADDR( instr );
+                return SUCCESS;
+            }
+            break;
+        default:
+            if (s_p->known[ ri ] && s_p->known[ rj ])
+            {
+                switch (op_code)
+                {
+                    case 0b001: s_p->value[ rk ] = s_p->value[ ri ] 
+                        + s_p->value[ rj ]; break;
+                    case 0b010: s_p->value[ rk ] = s_p->value[ ri ] 
+                        & s_p->value[ rj ]; break;
+                    case 0b011: s_p->value[ rk ] = s_p->value[ ri ] 
+                        | s_p->value[ rj ]; break;
+                    default: s_p->value[ rk ] = s_p->value[ ri ] 
+                        ^ s_p->value[ rj ]; break;
+                }
+                s_p->known[ rk ] = 1;
+                break;
+            }
+            if (materialize( s_p, ri ) != SUCCESS 
+                || materialize( s_p, rj ) != SUCCESS
+                || emit( s_p, instr ) != SUCCESS)
+            {
+                return ERROR;
+            }
+            set_dynamic( s_p, rk );
+            break;
+    }
+    *pc_p += WORD_SIZE;
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Residual Tail Functions
+ ******************************************************************************/
+
+/// @brief Registers the given instructions write
+/// @param s_p the attempt
+/// @param words_p 1 for each word to count
+/// @return a bit per register
+static uint16_t written_registers(const spec_state_t * s_p,
+    const byte_t * words_p)
+{
+    uint16_t written = 0;
+    uint16_t instr;
+
+    for (byte_t w = 0; w < MEM_WORD_COUNT; w++)
+    {
+        instr = s_p->code[ w ];
+        if (!words_p[ w ] || (instr >> 13) == OP_PRT 
+            || (instr >> 13) == OP_BLT)
+        {
+            continue;
+        }
+        written |= (uint16_t) (1u << ((instr >> 13) == OP_LDI 
+            || (instr >> 13) == OP_RDD ? RI( instr ) : RK( instr )));
+    }
+    return written;
+}
+
+/// @brief Finds the words the original can run from entry on, deciding
+/// branches on registers that are known and never written from there
+/// @param s_p the attempt
+/// @param entry the address the original is left to run from
+/// @param written registers written from there on, bit per register
+/// @param out_reachable_p 1 for each word that can run
+/// @param out_branches_p how each reachable BLT goes (BRANCH_*)
+/// @return 1 if SUCCESS, otherwise ERROR (a branch may go to an odd address)
+static int find_reachable(const spec_state_t * s_p, byte_t entry,
+    uint16_t written, byte_t * out_reachable_p, byte_t * out_branches_p)
+{
+    byte_t stack[ MEM_WORD_COUNT ];
+    int num_stacked = 0;
+    uint16_t instr;
+    byte_t w;
+    byte_t ri;
+    byte_t rj;
+    byte_t branch;
+
+    memset( out_reachable_p, 0, MEM_WORD_COUNT );
+    memset( out_branches_p, BRANCH_DYNAMIC, MEM_WORD_COUNT );
+    out_reachable_p[ entry / WORD_SIZE ] = 1;
+    stack[ num_stacked++ ] = entry / WORD_SIZE;
+    while (num_stacked > 0)
+    {
+        w = stack[ --num_stacked ];
+        instr = s_p->code[ w ];
+        branch = BRANCH_NEVER;
+        if ((instr >> 13) == OP_BLT)
+        {
+            ri = RI( instr );
+            rj = RJ( instr );
+            branch = BRANCH_DYNAMIC;
+            if (s_p->known[ ri ] && s_p->known[ rj ] 
+                && !((written >> ri) & 1) && !((written >> rj) & 1))
+            {
+                branch = s_p->value[ ri ] < s_p->value[ rj ] 
+                    ? BRANCH_ALWAYS : BRANCH_NEVER;
+            }
+            out_branches_p[ w ] = branch;
+        }
+        if (branch != BRANCH_NEVER)
+        {
+            if (BLT_ADDR( instr ) % WORD_SIZE != 0)
+            {
+                return ERROR;
+            }
+            if (BLT_ADDR( instr ) < s_p->end 
+                && !out_reachable_p[ BLT_ADDR( instr ) / WORD_SIZE ])
+            {
+                out_reachable_p[ BLT_ADDR( instr ) / WORD_SIZE ] = 1;
+                stack[ num_stacked++ ] = BLT_ADDR( instr ) / WORD_SIZE;
+            }
+        }
+        if (branch != BRANCH_ALWAYS && (w + 1) * WORD_SIZE < s_p->end
+            && !out_reachable_p[ w + 1 ])
+        {
+            out_reachable_p[ w + 1 ] = 1;
+            stack[ num_stacked++ ] = w + 1;
+        }
+    }
+    return SUCCESS;
+}
+
+/// @brief Finds the registers live where the tail is entered: read by what
+/// it runs before they are written, or left as they are on a way to halting,
+/// since the residual ends with the same registers
+/// @param s_p the attempt
+/// @param entry the address the original is left to run from
+/// @param reachable_p 1 for each word that can run
+/// @param branches_p how each reachable BLT goes (BRANCH_*)
+/// @return a bit per register
+static uint16_t live_registers(const spec_state_t * s_p, byte_t entry,
+    const byte_t * reachable_p, const byte_t * branches_p)
+{
+    uint16_t live_in[ MEM_WORD_COUNT ] = { 0 };
+    uint16_t live_out;
+    uint16_t used;
+    uint16_t defined;
+    uint16_t instr;
+    byte_t next;
+    byte_t falls_through;
+    byte_t changed = 1;
+
+    while (changed)
+    {
+        changed = 0;
+        for (int w = MEM_WORD_COUNT - 1; w >= 0; w--)
+        {
+            if (!reachable_p[ w ])
+            {
+                continue;
+            }
+            instr = s_p->code[ w ];
+            used = 0;
+            defined = 0;
+            live_out = 0;
+            falls_through = 1;
+            switch (instr >> 13)
+            {
+                case OP_LDI:
+                case OP_RDD:
+                    defined = (uint16_t) (1u << RI( instr ));
+                    break;
+                case OP_PRT:
+                    used = (uint16_t) (1u << RI( instr ));
+                    break;
+                case OP_BLT:
+                    /* One that is never taken is left out of the residual */
+                    if (branches_p[ w ] != BRANCH_NEVER)
+                    {
+                        used = (uint16_t) ((1u << RI( instr ))
+                            | (1u << RJ( instr )));
+                        live_out = BLT_ADDR( instr ) >= s_p->end 
+                            ? ALL_REGISTERS 
+                            : live_in[ BLT_ADDR( instr ) / WORD_SIZE ];
+                    }
+                    falls_through = branches_p[ w ] != BRANCH_ALWAYS;
+                    break;
+                default:
+                    used = (uint16_t) ((1u << RI( instr )) 
+                        | (1u << RJ( instr )));
+                    defined = (uint16_t) (1u << RK( instr ));
+                    break;
+            }
+            next = (byte_t) ((w + 1) * WORD_SIZE);
+            if (falls_through)
+            {
+                /* Halting there leaves every register as it is */
+                live_out |= next < s_p->end 
+                    ? live_in[ next / WORD_SIZE ] : ALL_REGISTERS;
+            }
+            live_out = (uint16_t) (used | (live_out & ~defined));
+            if (live_out != live_in[ w ])
+            {
+                live_in[ w ] = live_out;
+                changed = 1;
+            }
+        }
+    }
+    return live_in[ entry / WORD_SIZE ];
+}
+
+/// @brief Emits what the original runs from entry on: the words it can
+/// reach there, in order, less BLTs that are never taken, with branch
+/// targets moved to where their words land
+/// @param s_p the attempt, at entry
+/// @param entry the address the original is left to run from
+/// @return 1 if SUCCESS, otherwise ERROR
+static int emit_tail(spec_state_t * s_p, byte_t entry)
+{
+    byte_t reachable[ MEM_WORD_COUNT ];
+    byte_t branches[ MEM_WORD_COUNT ];
+    byte_t all[ MEM_WORD_COUNT ];
+    /* Index in the residual of the first word kept at or after each word */
+    byte_t new_index[ MEM_WORD_COUNT + 1 ];
+    uint16_t written;
+    uint16_t last_written;
+    byte_t kept[ MEM_WORD_COUNT ];
+    byte_t num_kept = 0;
+    byte_t base;
+    byte_t new_end;
+    byte_t jump_from = NUM_REGISTERS;
+    byte_t jump_to = NUM_REGISTERS;
+    uint16_t instr;
+    byte_t target;
+
+    /* What is written decides what stays constant, which decides what can
+       run, which decides what is written; shrink both until they settle */
+    memset( all, 1, sizeof( all ) );
+    written = written_registers( s_p, all );
+    do
+    {
+        last_written = written;
+        if (find_reachable( s_p, entry, written, reachable, branches ) 
+            != SUCCESS)
+        {
+            return ERROR;
+        }
+        written = written_registers( s_p, reachable );
+    } while (written != last_written);
+
+    for (byte_t w = 0; w < MEM_WORD_COUNT; w++)
+    {
+        kept[ w ] = reachable[ w ] && branches[ w ] != BRANCH_NEVER;
+    }
+    /* Known registers the tail overwrites before it looks at them need not
+       be loaded */
+    if (materialize_all( s_p, live_registers( s_p, entry, reachable, 
+        branches ) ) != SUCCESS)
+    {
+        return ERROR;
+    }
+
+    /* The residual enters the tail at its first word unless it jumps in,
+       which takes two known registers to compare */
+    for (byte_t w = 0; w < entry / WORD_SIZE; w++)
+    {
+        if (!kept[ w ])
+        {
+            continue;
+        }
+        for (byte_t a = 0; a < NUM_REGISTERS && jump_from == NUM_REGISTERS; 
+            a++)
+        {
+            for (byte_t b = 0; b < NUM_REGISTERS; b++)
+            {
+                if (s_p->known[ a ] && s_p->known[ b ] 
+                    && s_p->value[ a ] < s_p->value[ b ])
+                {
+                    jump_from = a;
+                    jump_to = b;
+                    break;
+                }
+            }
+        }
+        if (jump_from == NUM_REGISTERS 
+            || materialize( s_p, jump_from ) != SUCCESS
+            || materialize( s_p, jump_to ) != SUCCESS)
+        {
+            return ERROR;
+        }
+        break;
+    }
+    base = (byte_t) (s_p->num_out + (jump_from != NUM_REGISTERS));
+
+    for (byte_t w = 0; w < MEM_WORD_COUNT; w++)
+    {
+        num_kept += kept[ w ];
+    }
+    if (base + num_kept > MEM_WORD_COUNT)
+    {
+        return ERROR;
+    }
+    new_end = (byte_t) ((base + num_kept) * WORD_SIZE);
+    new_index[ MEM_WORD_COUNT ] = (byte_t) (base + num_kept);
+    for (int w = MEM_WORD_COUNT - 1; w >= 0; w--)
+    {
+        new_index[ w ] = (byte_t) (new_index[ w + 1 ] - kept[ w ]);
+    }
+    if (new_index[ entry / WORD_SIZE ] * WORD_SIZE > BLT_ADDR( 0xFFFF ))
+    {
+        return ERROR;
+    }
+
+    if (jump_from != NUM_REGISTERS && emit( s_p, (uint16_t) ((OP_BLT << 13)
+        | (jump_from << 9) | (jump_to << 5) 
+        | (new_index[ entry / WORD_SIZE ] * WORD_SIZE) )) != SUCCESS)
+    {
+        return ERROR;
+    }
+    for (byte_t w = 0; w < MEM_WORD_COUNT; w++)
+    {
+        if (!kept[ w ])
+        {
+            continue;
+        }
+        instr = s_p->code[ w ];
+        if ((instr >> 13) == OP_BLT)
+        {
+            /* Past the end halts, in the residual too, if it can say so */
+            target = BLT_ADDR( instr ) >= s_p->end ? new_end
+                : (byte_t) (new_index[ BLT_ADDR( instr ) / WORD_SIZE ]
+                    * WORD_SIZE);
+            if (target > BLT_ADDR( 0xFFFF ))
+            {
+                return ERROR;
+            }
+            instr = (uint16_t) ((instr & ~0b11111u) | target);
+        }
+        if (emit( s_p, instr ) != SUCCESS)
+        {
+            return ERROR;
+        }
+    }
+    return SUCCESS;
+}
+
+/*******************************************************************************
+ *                          Specializer Functions
+ ******************************************************************************/
+
+/// @brief One attempt at specializing, with room for max_words of
+/// evaluated code before the rest is left to run
+/// @param s_p the attempt, set up with the program
+/// @param values_p the fixed values
+/// @param num_values how many there are
+/// @param max_words most words the evaluated part may emit
+/// @return 1 if SUCCESS, otherwise ERROR
+static int try_specialize(spec_state_t * s_p, const byte_t * values_p,
+    uint64_t num_values, byte_t max_words)
+{
+    spec_state_t before;
+    byte_t before_pc;
+    byte_t pc = 0;
+
+    for (uint64_t i = 0; pc < s_p->end && i < SPEC_MAX_STEPS; i++)
+    {
+        before = *s_p;
+        before_pc = pc;
+        if (evaluate_step( s_p, &pc, values_p, num_values ) != SUCCESS
+            || s_p->num_out > max_words)
+        {
+            *s_p = before;
+            pc = before_pc;
+            break;
+        }
+        /* Counted if it left nothing to run */
+        s_p->steps += s_p->num_out == before.num_out;
+    }
+    if (pc >= s_p->end)
+    {
+        /* It halts; all that is left is to end with the same registers */
+        return materialize_all( s_p, ALL_REGISTERS );
+    }
+    return emit_tail( s_p, pc );
+}
+
+/// @brief Specializes a program to fixed values of its first console reads
+/// (RDD from CONSOLE_PORT); programs that use the timer are not, since
+/// their behaviour depends on cycle counts. The residual program fits in
+/// memory like the original, and is made as far evaluated as it allows; at
+/// worst it is the original, with no values used
+/// @param mem_p the program
+/// @param loaded_mem_slots its length in bytes
+/// @param values_p the fixed values, in the order they are read
+/// @param num_values how many there are
+/// @param out_result_p the residual program
+/// @return 1 if SUCCESS, otherwise ERROR
+int specialize_program(const byte_t * mem_p, byte_t loaded_mem_slots,
+    const byte_t * values_p, uint64_t num_values,
+    spec_result_t * out_result_p)
+{
+    spec_state_t start;
+    spec_state_t attempt;
+    uint16_t instr;
+
+    memset( &start, 0, sizeof( start ) );
+    start.end = loaded_mem_slots;
+    for (byte_t w = 0; w < MEM_WORD_COUNT; w++)
+    {
+        start.code[ w ] = (uint16_t) ((mem_p[ w * WORD_SIZE ] << 8) 
+            | mem_p[ w * WORD_SIZE + 1 ]);
+        if (w * WORD_SIZE + 1 >= loaded_mem_slots)
+        {
+            /* Memory past what was loaded reads as 0 */
+            start.code[ w ] &= w * WORD_SIZE < loaded_mem_slots ? 0xFF00 : 0;
+        }
+        instr = start.code[ w ];
+        if (w * WORD_SIZE < loaded_mem_slots
+            && ((instr >> 13) == OP_PRT || (instr >> 13) == OP_RDD)
+            && PORT( instr ) >= TIMER_PORT 
+            && PORT( instr ) < TIMER_PORT + TIMER_NUM_PORTS)
+        {
+            printf( "\t# [ERROR: programs that use the timer can not be "
+                "specialized] #\n" );
+            return ERROR;
+        }
+    }
+    /* Registers start at 0, in the residual too */
+    memset( start.known, 1, sizeof( start.known ) );
+    memset( start.phys_known, 1, sizeof( start.phys_known ) );
+
+    /* Evaluating further can leave too little room for the rest */
+    for (int max_words = MEM_WORD_COUNT; max_words >= 0; max_words--)
+    {
+        attempt = start;
+        if (try_specialize( &attempt, values_p, num_values, 
+            (byte_t) max_words ) == SUCCESS)
+        {
+            memset( out_result_p, 0, sizeof( *out_result_p ) );
+            for (byte_t w = 0; w < attempt.num_out; w++)
+            {
+                out_result_p->mem[ w * WORD_SIZE ] = 
+                    (byte_t) (attempt.out[ w ] >> 8);
+                out_result_p->mem[ w * WORD_SIZE + 1 ] = 
+                    (byte_t) attempt.out[ w ];
+            }
+            out_result_p->loaded_mem_slots = 
+                (byte_t) (attempt.num_out * WORD_SIZE);
+            out_result_p->values_used = attempt.values_used;
+            out_result_p->steps = attempt.steps;
+            return SUCCESS;
+        }
+    }
+    /* Left to run as it is, the original reads every value itself */
+    memset( out_result_p, 0, sizeof( *out_result_p ) );
+    memcpy( out_result_p->mem, mem_p, loaded_mem_slots );
+    out_result_p->loaded_mem_slots = loaded_mem_slots;
+    return SUCCESS;
+}
+
+/// @brief Specializes a machine code file to fixed console input and writes
+/// the residual program, with its listing, to another
+/// @param in_bin_file_name_p the program
+/// @param values_text_p the fixed values, decimal, separated by anything
+/// @param out_bin_file_name_p the residual program's file
+/// @return 1 if SUCCESS, otherwise ERROR
+int specialize_program_file(const char * in_bin_file_name_p,
+    const char * values_text_p, const char * out_bin_file_name_p)
+{
+    microputer_t * mp_p = NULL;
+    spec_result_t result;
+    size_t len = strlen( values_text_p );
+    byte_t * values_p = (byte_t *) malloc( len / 2 + 1 );
+    uint64_t num_values;
+    char line[ MAX_ASM_LINE_LEN + 1 ];
+    uint16_t instr;
+    FILE * file_p = NULL;
+    int status = ERROR;
+
+    if (values_p == NULL || create_microputer( &mp_p ) != SUCCESS)
+    {
+        goto FUNC_EXIT;
+    }
+    create_instruction_set( mp_p );
+    num_values = parse_decimal_values( values_text_p, len, values_p );
+    if (load_micro_program( mp_p, in_bin_file_name_p ) != SUCCESS
+        || specialize_program( mp_p->mem, mp_p->loaded_mem_slots, values_p,
+            num_values, &result ) != SUCCESS)
+    {
+        goto FUNC_EXIT;
+    }
+
+    file_p = fopen( out_bin_file_name_p, "wb" );
+    if (file_p == NULL || fwrite( result.mem, 1, result.loaded_mem_slots,
+        file_p ) != result.loaded_mem_slots)
+    {
+        printf( "\t# [ERROR: Can not write '%s'!] #\n", out_bin_file_name_p );
+        goto FUNC_EXIT;
+    }
+
+    printf( "Specialized '%s' into '%s': %llu of %llu values used, %llu "
+        "instructions\nevaluated ahead, %hu -> %hu words\n", 
+        in_bin_file_name_p, out_bin_file_name_p, 
+        (unsigned long long) result.values_used,
+        (unsigned long long) num_values, (unsigned long long) result.steps,
+        (uint16_t) ((mp_p->loaded_mem_slots + 1) / WORD_SIZE),
+        (uint16_t) (result.loaded_mem_slots / WORD_SIZE) );
+    if (result.values_used < num_values)
+    {
+        printf( "The residual program reads the %llu values left first\n",
+            (unsigned long long) (num_values - result.values_used) );
+    }
+    for (byte_t i = 0; i < result.loaded_mem_slots; i += WORD_SIZE)
+    {
+        instr = (uint16_t) ((result.mem[ i ] << 8) | result.mem[ i + 1 ]);
+        mp_p->instr_set[ instr >> 13 ].disassembler( instr, line );
+        printf( "\t%2hu: %s\n", (uint16_t) i, line );
+    }
+    status = SUCCESS;
+
+    FUNC_EXIT:
+    if (file_p != NULL && fclose( file_p ) != 0)
+    {
+        status = ERROR;
+    }
+    if (mp_p != NULL)
+    {
+        delete_microputer( &mp_p );
+    }
+    free( values_p );
+    return status;
+}
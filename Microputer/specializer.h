@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////////////
+/// Header file for specializing programs to fixed console input
+/// @author Thomas Pelegrin
+/// @date 09.19.2023
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPECIALIZER_H
+#define SPECIALIZER_H
+
+/***************************** Imports ****************************************/
+
+#include "microputer.h"
+
+/**************************** Constants ***************************************/
+
+/* Instructions evaluated ahead of time before the rest is left to run */
+#define SPEC_MAX_STEPS 1000000
+
+/********************* Specializer Structs & Types ****************************/
+
+/* A residual program and how much of the input it took in */
+struct spec_result_s {
+    byte_t mem[ MEM_BYTE_SIZE ];
+    byte_t loaded_mem_slots;
+    /* Fixed values substituted; the residual program must read the rest
+       first, as the original would have */
+    uint64_t values_used;
+    /* Instructions the original runs that were evaluated away */
+    uint64_t steps;
+} typedef spec_result_t;
+
+/*********************** Public Specializer Functions *************************/
+
+int specialize_program(const byte_t * mem_p, byte_t loaded_mem_slots,
+    const byte_t * values_p, uint64_t num_values,
+    spec_result_t * out_result_p);
+int specialize_program_file(const char * in_bin_file_name_p,
+    const char * values_text_p, const char * out_bin_file_name_p);
+
+#endif